@@ -0,0 +1,125 @@
+//
+// counts of the blocks of a world by block id and height
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+
+#include "BlockHistogram.h"
+#include "TaskPool.h"
+
+BlockHistogram::BlockHistogram()
+    : m_counts(BLOCK_IDS * CHUNK_HEIGHT, 0),
+      m_chunks(0)
+{
+}
+
+void
+BlockHistogram::clear()
+{
+    m_counts.assign(m_counts.size(), 0);
+    m_chunks = 0;
+}
+
+void
+BlockHistogram::addChunk(const ChunkData *chunk)
+{
+    // the blocks of a column run up the heights, so each lands on the
+    // counter of its id at the height of the index within the column
+    unsigned long long *counts = &m_counts[0];
+    for(int column = 0; column < CHUNK_SIZE * CHUNK_SIZE; column++)
+    {
+        const unsigned char *blocks = chunk->blocks + column * CHUNK_HEIGHT;
+        for(int y = 0; y < CHUNK_HEIGHT; y++)
+            counts[blocks[y] * CHUNK_HEIGHT + y]++;
+    }
+    m_chunks++;
+}
+
+void
+BlockHistogram::add(const BlockHistogram &other)
+{
+    for(size_t i = 0; i < m_counts.size(); i++)
+        m_counts[i] += other.m_counts[i];
+    m_chunks += other.m_chunks;
+}
+
+unsigned long long
+BlockHistogram::getTotal(int id) const
+{
+    unsigned long long total = 0;
+    for(int y = 0; y < CHUNK_HEIGHT; y++)
+        total += m_counts[id * CHUNK_HEIGHT + y];
+    return total;
+}
+
+BlockCounter::BlockCounter()
+    : m_threads(0)
+{
+}
+
+BlockCounter::~BlockCounter()
+{
+    for(size_t w = 0; w < m_chunks.size(); w++)
+        delete m_chunks[w];
+}
+
+int
+BlockCounter::countRegion(const char *world, const RegionCoord &region, BlockHistogram *histogram)
+{
+    m_coords.resize(REGION_CHUNKS * REGION_CHUNKS);
+    for(int i = 0; i < REGION_CHUNKS; i++)
+    {
+        for(int j = 0; j < REGION_CHUNKS; j++)
+        {
+            m_coords[i * REGION_CHUNKS + j].x = region.x * REGION_CHUNKS + i;
+            m_coords[i * REGION_CHUNKS + j].z = region.z * REGION_CHUNKS + j;
+        }
+    }
+    return count(world, &m_coords[0], (int)m_coords.size(), ReadRegionChunk, histogram);
+}
+
+int
+BlockCounter::countOldDirectory(const char *world, int xt, int zt, BlockHistogram *histogram)
+{
+    if( !ListOldChunks(world, xt, zt, &m_coords) || m_coords.empty() )
+        return 0;
+    return count(world, &m_coords[0], (int)m_coords.size(), ReadOldChunk, histogram);
+}
+
+int
+BlockCounter::count(const char *world, const ChunkCoord *chunks, int chunkCount, ChunkFunc read,
+                    BlockHistogram *histogram)
+{
+    TaskPool &pool = TaskPool::shared();
+    int workers = m_threads > 0 ? m_threads : pool.getThreadCount();
+    if( (int)m_chunks.size() < workers )
+    {
+        m_chunks.resize(workers, (ChunkData*)NULL);
+        m_histograms.resize(workers);
+    }
+    std::atomic<int> found(0);
+
+    pool.parallelFor(chunkCount, [&](int task, int worker) {
+        if( m_chunks[worker] == NULL )
+            m_chunks[worker] = new ChunkData;
+        ChunkData *chunk = m_chunks[worker];
+
+        if( read(world, chunks[task].x, chunks[task].z, chunk) )
+        {
+            m_histograms[worker].addChunk(chunk);
+            found++;
+        }
+    }, m_threads);
+
+    for(int w = 0; w < workers; w++)
+    {
+        if( m_histograms[w].getChunks() > 0 )
+        {
+            histogram->add(m_histograms[w]);
+            m_histograms[w].clear();
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,73 @@
+//
+// counts of the blocks of a world by block id and height
+//
+// A histogram holds one count for every block id at every height, 256 x
+// 128 counters, whatever the number of chunks counted into it. The
+// BlockCounter decodes the chunks of one region file, or of one directory
+// of the old per-chunk format, on the shared TaskPool, each worker counting
+// into a histogram of its own which are added together at the end. A world
+// is counted one region at a time, so memory stays the same however large
+// the world is and each region's counts can be written out before the next.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BLOCK_HISTOGRAM_H
+#define _BLOCK_HISTOGRAM_H
+
+#include <vector>
+#include "ChunkReader.h"
+
+class BlockHistogram {
+public:
+    BlockHistogram();
+
+    void clear();
+
+    // counts every block of a chunk
+    void addChunk(const ChunkData *chunk);
+    // adds the counts of another histogram
+    void add(const BlockHistogram &other);
+
+    // blocks of an id at a height
+    unsigned long long get(int id, int y) const { return m_counts[id * CHUNK_HEIGHT + y]; }
+    // blocks of an id at every height
+    unsigned long long getTotal(int id) const;
+    // chunks counted
+    long long getChunks() const { return m_chunks; }
+
+private:
+    // count of id at height y is m_counts[id * CHUNK_HEIGHT + y]
+    std::vector<unsigned long long> m_counts;
+    long long m_chunks;
+};
+
+class BlockCounter {
+public:
+    BlockCounter();
+    ~BlockCounter();
+
+    // workers decoding chunks, 0 for all of the shared pool
+    void setThreads(int n) { m_threads = n > 0 ? n : 0; }
+
+    // adds the chunks of a region file to histogram. Returns the number
+    // of chunks found.
+    int countRegion(const char *world, const RegionCoord &region, BlockHistogram *histogram);
+
+    // adds the chunks in directory xt/zt of the old per-chunk format to
+    // histogram. Returns the number of chunks found.
+    int countOldDirectory(const char *world, int xt, int zt, BlockHistogram *histogram);
+
+private:
+    typedef int (*ChunkFunc)(const char *world, int cx, int cz, ChunkData *chunk);
+
+    int count(const char *world, const ChunkCoord *chunks, int chunkCount, ChunkFunc read,
+              BlockHistogram *histogram);
+
+    int m_threads;
+    // scratch per worker, kept from one call to the next
+    std::vector<ChunkData*> m_chunks;
+    std::vector<BlockHistogram> m_histograms;
+    std::vector<ChunkCoord> m_coords;
+};
+
+#endif
@@ -0,0 +1,269 @@
+//
+// which block ids every chunk of a world holds, kept beside the world
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#include "BlockIndex.h"
+#include "TaskPool.h"
+
+int
+ChunkBlocks::count(int id) const
+{
+    if( !present.has(id) )
+        return 0;
+    for(size_t c = 0; c < counts.size(); c++)
+        if( counts[c].id == id )
+            return counts[c].count;
+    return 0;
+}
+
+void
+BlockIndex::summarize(const ChunkData *chunk, unsigned int timestamp, ChunkBlocks *blocks)
+{
+    int counts[BLOCK_IDS];
+    memset(counts, 0, sizeof(counts));
+    for(int bpos = 0; bpos < CHUNK_BLOCKS; bpos++)
+        counts[chunk->blocks[bpos]]++;
+
+    blocks->timestamp = timestamp;
+    blocks->present.clear();
+    blocks->counts.clear();
+    for(int id = 0; id < BLOCK_IDS; id++)
+    {
+        if( counts[id] == 0 )
+            continue;
+        BlockCount c = { (unsigned char)id, (unsigned short)counts[id] };
+        blocks->present.add(id);
+        blocks->counts.push_back(c);
+    }
+}
+
+int
+BlockIndex::update(const char *world, int threads)
+{
+    std::vector<RegionCoord> regions;
+    if( !ListRegions(world, &regions) )
+        return -1;
+
+    // a chunk stored since its summary was made
+    struct Stale {
+        int cx, cz;
+        unsigned int timestamp;
+        ChunkBlocks *blocks;
+    };
+    std::vector<Stale> stale;
+
+    std::map< std::pair<int, int>, std::vector<ChunkBlocks> > kept;
+    std::vector<unsigned int> stamps(REGION_CHUNK_COUNT);
+    for(size_t r = 0; r < regions.size(); r++)
+    {
+        if( !ReadRegionTimestamps(world, regions[r], &stamps[0]) )
+            continue;
+
+        std::pair<int, int> key(regions[r].x, regions[r].z);
+        std::vector<ChunkBlocks> &chunks = kept[key];
+        std::map< std::pair<int, int>, std::vector<ChunkBlocks> >::iterator old = m_regions.find(key);
+        if( old != m_regions.end() )
+            chunks.swap(old->second);
+        else
+            chunks.resize(REGION_CHUNK_COUNT);
+
+        for(int c = 0; c < REGION_CHUNK_COUNT; c++)
+        {
+            if( stamps[c] == 0 )
+                chunks[c] = ChunkBlocks();
+            else if( stamps[c] != chunks[c].timestamp )
+            {
+                Stale s = { regions[r].x * REGION_CHUNKS + c % REGION_CHUNKS,
+                            regions[r].z * REGION_CHUNKS + c / REGION_CHUNKS, stamps[c], &chunks[c] };
+                stale.push_back(s);
+            }
+        }
+    }
+    // the summaries do not move when the maps are swapped
+    m_regions.swap(kept);
+
+    TaskPool &pool = TaskPool::shared();
+    int workers = threads > 0 ? threads : pool.getThreadCount();
+    std::vector<ChunkData*> chunks(workers, (ChunkData*)NULL);
+
+    pool.parallelFor((int)stale.size(), [&](int task, int worker) {
+        if( chunks[worker] == NULL )
+            chunks[worker] = new ChunkData;
+        ChunkData *chunk = chunks[worker];
+
+        // a chunk which cannot be read keeps its timestamp, so is not
+        // tried again until it changes
+        const Stale &s = stale[task];
+        if( ReadRegionChunk(world, s.cx, s.cz, chunk) )
+            summarize(chunk, s.timestamp, s.blocks);
+        else {
+            *s.blocks = ChunkBlocks();
+            s.blocks->timestamp = s.timestamp;
+        }
+    }, threads);
+
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    return (int)stale.size();
+}
+
+const ChunkBlocks *
+BlockIndex::find(int cx, int cz) const
+{
+    // regions and chunks within them round toward negative infinity
+    int rx = cx >= 0 ? cx / REGION_CHUNKS : -((-cx - 1) / REGION_CHUNKS) - 1;
+    int rz = cz >= 0 ? cz / REGION_CHUNKS : -((-cz - 1) / REGION_CHUNKS) - 1;
+    std::map< std::pair<int, int>, std::vector<ChunkBlocks> >::const_iterator r;
+    r = m_regions.find(std::make_pair(rx, rz));
+    if( r == m_regions.end() )
+        return NULL;
+
+    const ChunkBlocks &blocks = r->second[(cx - rx * REGION_CHUNKS) + (cz - rz * REGION_CHUNKS) * REGION_CHUNKS];
+    return blocks.timestamp != 0 ? &blocks : NULL;
+}
+
+void
+BlockIndex::query(const BlockSet &ids, std::vector<ChunkCoord> *chunks) const
+{
+    chunks->clear();
+
+    std::map< std::pair<int, int>, std::vector<ChunkBlocks> >::const_iterator r;
+    for(r = m_regions.begin(); r != m_regions.end(); ++r)
+    {
+        for(int c = 0; c < REGION_CHUNK_COUNT; c++)
+        {
+            const ChunkBlocks &blocks = r->second[c];
+            if( blocks.timestamp == 0 || !blocks.present.intersects(ids) )
+                continue;
+            ChunkCoord chunk = { r->first.first * REGION_CHUNKS + c % REGION_CHUNKS,
+                                 r->first.second * REGION_CHUNKS + c / REGION_CHUNKS };
+            chunks->push_back(chunk);
+        }
+    }
+}
+
+int
+BlockIndex::getChunkCount() const
+{
+    int count = 0;
+    std::map< std::pair<int, int>, std::vector<ChunkBlocks> >::const_iterator r;
+    for(r = m_regions.begin(); r != m_regions.end(); ++r)
+        for(int c = 0; c < REGION_CHUNK_COUNT; c++)
+            if( r->second[c].timestamp != 0 )
+                count++;
+    return count;
+}
+
+bool
+BlockIndex::getExtent(ChunkCoord *lo, ChunkCoord *hi) const
+{
+    if( m_regions.empty() )
+        return false;
+
+    std::map< std::pair<int, int>, std::vector<ChunkBlocks> >::const_iterator r = m_regions.begin();
+    lo->x = hi->x = r->first.first;
+    lo->z = hi->z = r->first.second;
+    for( ; r != m_regions.end(); ++r)
+    {
+        if( r->first.first < lo->x ) lo->x = r->first.first;
+        if( r->first.first > hi->x ) hi->x = r->first.first;
+        if( r->first.second < lo->z ) lo->z = r->first.second;
+        if( r->first.second > hi->z ) hi->z = r->first.second;
+    }
+
+    lo->x *= REGION_CHUNKS;
+    lo->z *= REGION_CHUNKS;
+    hi->x = hi->x * REGION_CHUNKS + REGION_CHUNKS - 1;
+    hi->z = hi->z * REGION_CHUNKS + REGION_CHUNKS - 1;
+    return true;
+}
+
+int
+BlockIndex::load(const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if( f == NULL )
+        return 0;
+
+    m_regions.clear();
+
+    char word[16];
+    bool ok = fscanf(f, " %15s", word) == 1 && strcmp(word, "blockindex") == 0;
+
+    std::vector<ChunkBlocks> *region = NULL;
+    while( ok && fscanf(f, " %15s", word) == 1 )
+    {
+        if( strcmp(word, "region") == 0 )
+        {
+            int x, z;
+            ok = fscanf(f, "%d %d", &x, &z) == 2;
+            if( ok ) {
+                region = &m_regions[std::make_pair(x, z)];
+                region->assign(REGION_CHUNK_COUNT, ChunkBlocks());
+            }
+            continue;
+        }
+
+        int c, ids;
+        unsigned int timestamp;
+        ok = strcmp(word, "chunk") == 0 && region != NULL &&
+             fscanf(f, "%d %u %d", &c, &timestamp, &ids) == 3 &&
+             c >= 0 && c < REGION_CHUNK_COUNT && ids >= 0 && ids <= BLOCK_IDS;
+
+        ChunkBlocks blocks;
+        blocks.timestamp = timestamp;
+        for(int i = 0; ok && i < ids; i++)
+        {
+            int id, count;
+            ok = fscanf(f, "%d %d", &id, &count) == 2 && id >= 0 && id < BLOCK_IDS &&
+                 count > 0 && count <= CHUNK_BLOCKS;
+            if( ok ) {
+                BlockCount b = { (unsigned char)id, (unsigned short)count };
+                blocks.present.add(id);
+                blocks.counts.push_back(b);
+            }
+        }
+
+        if( ok )
+            (*region)[c] = blocks;
+    }
+    fclose(f);
+
+    if( !ok )
+        m_regions.clear();
+    return ok ? 1 : 0;
+}
+
+int
+BlockIndex::save(const char *filename) const
+{
+    FILE *f = fopen(filename, "w");
+    if( f == NULL )
+        return 0;
+
+    fprintf(f, "blockindex\n");
+
+    std::map< std::pair<int, int>, std::vector<ChunkBlocks> >::const_iterator r;
+    for(r = m_regions.begin(); r != m_regions.end(); ++r)
+    {
+        fprintf(f, "region %d %d\n", r->first.first, r->first.second);
+        for(int c = 0; c < REGION_CHUNK_COUNT; c++)
+        {
+            const ChunkBlocks &blocks = r->second[c];
+            if( blocks.timestamp == 0 )
+                continue;
+            fprintf(f, "chunk %d %u %d", c, blocks.timestamp, (int)blocks.counts.size());
+            for(size_t i = 0; i < blocks.counts.size(); i++)
+                fprintf(f, " %d %d", blocks.counts[i].id, blocks.counts[i].count);
+            fprintf(f, "\n");
+        }
+    }
+
+    bool ok = ferror(f) == 0;
+    return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,100 @@
+//
+// which block ids every chunk of a world holds, kept beside the world
+//
+// Each chunk is summarized once, when it is decoded, as the set of block
+// ids it contains, 256 bits, and the count of each. Questions such as which
+// chunks hold diamond or lapis ore are then answered from the summaries
+// without decompressing anything, and loaders skip chunks holding none of
+// the ids they want. Summaries are kept with the chunk's timestamp from the
+// region file header, so bringing the index up to date only decodes the
+// chunks which changed since. It is saved as text:
+//
+//     blockindex
+//     region <x> <z>
+//     chunk <x + z * 32> <timestamp> <ids> <id> <count> <id> <count> ...
+//
+// with a chunk line for every chunk stored in the region file.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BLOCK_INDEX_H
+#define _BLOCK_INDEX_H
+
+#include <string.h>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "ChunkReader.h"
+#include "RegionManifest.h"
+
+// a set of block ids
+struct BlockSet {
+    unsigned int bits[BLOCK_IDS / 32];
+
+    BlockSet() { clear(); }
+    void clear() { memset(bits, 0, sizeof(bits)); }
+
+    void add(int id) { bits[id >> 5] |= 1u << (id & 31); }
+    bool has(int id) const { return (bits[id >> 5] >> (id & 31)) & 1; }
+    bool intersects(const BlockSet &other) const
+    {
+        unsigned int common = 0;
+        for(int w = 0; w < BLOCK_IDS / 32; w++)
+            common |= bits[w] & other.bits[w];
+        return common != 0;
+    }
+};
+
+struct BlockCount {
+    unsigned char id;
+    unsigned short count;
+};
+
+// summary of one chunk
+struct ChunkBlocks {
+    unsigned int timestamp;         // 0 for a chunk not stored
+    BlockSet present;
+    std::vector<BlockCount> counts; // ids present, by increasing id
+
+    ChunkBlocks() : timestamp(0) {}
+
+    // blocks of an id in the chunk
+    int count(int id) const;
+};
+
+class BlockIndex {
+public:
+    // summarizes a decoded chunk
+    static void summarize(const ChunkData *chunk, unsigned int timestamp, ChunkBlocks *blocks);
+
+    // brings the index up to date with the region files of a world,
+    // decoding the chunks whose timestamps changed on up to threads workers
+    // of the shared pool, 0 for all. Regions and chunks no longer stored
+    // are dropped. Returns the number of chunks decoded, -1 if the region
+    // directory cannot be read.
+    int update(const char *world, int threads = 0);
+
+    // summary of chunk (cx,cz), NULL if the index has no such chunk
+    const ChunkBlocks *find(int cx, int cz) const;
+
+    // lists the chunks holding any of ids
+    void query(const BlockSet &ids, std::vector<ChunkCoord> *chunks) const;
+
+    // chunks with a summary
+    int getChunkCount() const;
+    // smallest and largest chunk positions of the regions indexed, false
+    // for an empty index
+    bool getExtent(ChunkCoord *lo, ChunkCoord *hi) const;
+
+    // Return 0 if the file cannot be read or written, or is malformed.
+    int load(const char *filename);
+    int save(const char *filename) const;
+
+private:
+    // summaries of each region, by region (x,z), chunk (x,z) of a region
+    // at x + z * 32
+    std::map< std::pair<int, int>, std::vector<ChunkBlocks> > m_regions;
+};
+
+#endif
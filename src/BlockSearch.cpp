@@ -0,0 +1,144 @@
+//
+// finds the blocks of given ids nearest to a point of a world
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "BlockSearch.h"
+#include "TaskPool.h"
+
+// nearer first, ties broken by position so the answer does not depend on
+// the order the workers finish in
+static bool nearer(const BlockHit &a, const BlockHit &b)
+{
+    if( a.distance != b.distance ) return a.distance < b.distance;
+    if( a.x != b.x ) return a.x < b.x;
+    if( a.z != b.z ) return a.z < b.z;
+    return a.y < b.y;
+}
+
+// distance from (x,y,z) to the nearest point of chunk (cx,cz), which spans
+// every height
+static float chunkDistance(int cx, int cz, double x, double y, double z)
+{
+    double dx = x < cx * CHUNK_SIZE ? cx * CHUNK_SIZE - x : (x > (cx + 1) * CHUNK_SIZE ? x - (cx + 1) * CHUNK_SIZE : 0.0);
+    double dz = z < cz * CHUNK_SIZE ? cz * CHUNK_SIZE - z : (z > (cz + 1) * CHUNK_SIZE ? z - (cz + 1) * CHUNK_SIZE : 0.0);
+    double dy = y < 0.0 ? -y : (y > CHUNK_HEIGHT ? y - CHUNK_HEIGHT : 0.0);
+    return (float)sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+int FindNearestBlocks(const char *world, const BlockIndex &index, const BlockSet &ids,
+                      double x, double y, double z, int k, std::vector<BlockHit> *hits,
+                      int threads, BlockSearchStats *stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    hits->clear();
+    if( stats != NULL ) {
+        stats->rings = 0;
+        stats->decoded = 0;
+        stats->ms = 0.0;
+    }
+
+    ChunkCoord lo, hi;
+    if( k <= 0 || !index.getExtent(&lo, &hi) )
+        return 0;
+
+    // rings reach out until they cover every indexed region
+    int ox = (int)floor(x / CHUNK_SIZE);
+    int oz = (int)floor(z / CHUNK_SIZE);
+    int lastRing = std::max(std::max(abs(ox - lo.x), abs(ox - hi.x)), std::max(abs(oz - lo.z), abs(oz - hi.z)));
+
+    TaskPool &pool = TaskPool::shared();
+    int workers = threads > 0 ? threads : pool.getThreadCount();
+    std::vector<ChunkData*> chunks(workers, (ChunkData*)NULL);
+    std::vector< std::vector<BlockHit> > found(workers);
+    std::vector<ChunkCoord> ring, candidates;
+    float kth = std::numeric_limits<float>::max();
+
+    int r = 0;
+    for( ; r <= lastRing; r++)
+    {
+        ring.clear();
+        if( r == 0 ) {
+            ChunkCoord c = { ox, oz };
+            ring.push_back(c);
+        }
+        for(int d = -r; d < r; d++)
+        {
+            ChunkCoord c[4] = { { ox + d, oz - r }, { ox + r, oz + d }, { ox - d, oz + r }, { ox - r, oz - d } };
+            ring.insert(ring.end(), c, c + 4);
+        }
+
+        // no block of the ring can beat the k-th found so far
+        float nearest = std::numeric_limits<float>::max();
+        candidates.clear();
+        for(size_t c = 0; c < ring.size(); c++)
+        {
+            float d = chunkDistance(ring[c].x, ring[c].z, x, y, z);
+            nearest = std::min(nearest, d);
+            const ChunkBlocks *blocks = index.find(ring[c].x, ring[c].z);
+            if( d < kth && blocks != NULL && blocks->present.intersects(ids) )
+                candidates.push_back(ring[c]);
+        }
+        if( (int)hits->size() == k && nearest >= kth )
+            break;
+
+        pool.parallelFor((int)candidates.size(), [&](int task, int worker) {
+            if( chunks[worker] == NULL )
+                chunks[worker] = new ChunkData;
+            ChunkData *chunk = chunks[worker];
+
+            const ChunkCoord &c = candidates[task];
+            if( !ReadRegionChunk(world, c.x, c.z, chunk) )
+                return;
+
+            for(int bx = 0; bx < CHUNK_SIZE; bx++)
+            {
+                for(int bz = 0; bz < CHUNK_SIZE; bz++)
+                {
+                    const unsigned char *column = chunk->blocks + ChunkIndex(bx, 0, bz);
+                    for(int by = 0; by < CHUNK_HEIGHT; by++)
+                    {
+                        if( !ids.has(column[by]) )
+                            continue;
+                        BlockHit hit = { c.x * CHUNK_SIZE + bx, by, c.z * CHUNK_SIZE + bz, column[by], 0.0f };
+                        double dx = hit.x + 0.5 - x, dy = hit.y + 0.5 - y, dz = hit.z + 0.5 - z;
+                        hit.distance = (float)sqrt(dx * dx + dy * dy + dz * dz);
+                        found[worker].push_back(hit);
+                    }
+                }
+            }
+        }, threads);
+
+        for(int w = 0; w < workers; w++)
+        {
+            hits->insert(hits->end(), found[w].begin(), found[w].end());
+            found[w].clear();
+        }
+        if( (int)hits->size() > k )
+        {
+            std::partial_sort(hits->begin(), hits->begin() + k, hits->end(), nearer);
+            hits->resize(k);
+        }
+        if( (int)hits->size() == k )
+            kth = std::max_element(hits->begin(), hits->end(), nearer)->distance;
+
+        if( stats != NULL )
+            stats->decoded += (int)candidates.size();
+    }
+
+    std::sort(hits->begin(), hits->end(), nearer);
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    if( stats != NULL ) {
+        stats->rings = std::min(r + 1, lastRing + 1);
+        stats->ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return (int)hits->size();
+}
@@ -0,0 +1,40 @@
+//
+// finds the blocks of given ids nearest to a point of a world
+//
+// The search walks outward from the chunk holding the point, one ring of
+// chunks at a time, and uses a BlockIndex to decode only the chunks of a
+// ring which hold one of the ids, on the shared TaskPool. It stops once the
+// nearest a ring could come to the point is no nearer than the k-th block
+// found so far, so a query near the ores it asks for decodes a handful of
+// chunks rather than the world.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BLOCK_SEARCH_H
+#define _BLOCK_SEARCH_H
+
+#include <vector>
+
+#include "BlockIndex.h"
+
+struct BlockHit {
+    int x, y, z;        // block position in the world, y the height
+    int id;
+    float distance;     // from the point to the center of the block
+};
+
+struct BlockSearchStats {
+    int rings;          // rings of chunks looked at
+    int decoded;        // chunks decoded
+    double ms;          // milliseconds the search took
+};
+
+// finds the k blocks of ids nearest to block position (x,y,z), nearest
+// first, in the chunks of index, which must be up to date with the world.
+// Decodes on up to threads workers of the shared pool, 0 for all. Returns
+// the number found, fewer than k if the world holds fewer.
+int FindNearestBlocks(const char *world, const BlockIndex &index, const BlockSet &ids,
+                      double x, double y, double z, int k, std::vector<BlockHit> *hits,
+                      int threads = 0, BlockSearchStats *stats = NULL);
+
+#endif
@@ -0,0 +1,126 @@
+//
+// keyframed camera paths for rendering flythroughs
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+
+#include "CameraPath.h"
+
+int LoadCameraPath(const char *filename, std::vector<CameraKey> *keys)
+{
+    FILE *f = fopen(filename, "r");
+    if( f == NULL )
+    {
+        printf("Cannot open camera path %s\n", filename);
+        return 0;
+    }
+
+    keys->clear();
+    char line[512];
+    int number = 0;
+    while( fgets(line, sizeof(line), f) != NULL )
+    {
+        number++;
+
+        const char *p = line;
+        while( *p == ' ' || *p == '\t' )
+            p++;
+        if( *p == '#' || *p == '\r' || *p == '\n' || *p == '\0' )
+            continue;
+
+        CameraKey key;
+        if( sscanf(p, "%f %f %f %f %f %f %f %f %f", &key.frame,
+                   &key.rotation[0], &key.rotation[1], &key.rotation[2], &key.rotation[3],
+                   &key.dolly, &key.pan[0], &key.pan[1], &key.pan[2]) != 9 )
+        {
+            printf("%s:%d: expected <frame> <rotation x y z w> <dolly> <pan x y z>\n", filename, number);
+            fclose(f);
+            return 0;
+        }
+        if( !keys->empty() && key.frame <= keys->back().frame )
+        {
+            printf("%s:%d: keys must be in increasing frame order\n", filename, number);
+            fclose(f);
+            return 0;
+        }
+
+        keys->push_back(key);
+    }
+    fclose(f);
+
+    if( keys->empty() )
+    {
+        printf("%s: no keys\n", filename);
+        return 0;
+    }
+    return 1;
+}
+
+// spherical interpolation from quaternion a to b along the shorter arc
+static void slerp(const float a[4], const float b[4], float t, float out[4])
+{
+    float d = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+    float sign = d < 0.0f ? -1.0f : 1.0f;
+    d *= sign;
+
+    float wa = 1.0f - t, wb = t;
+    if( d < 0.9995f )
+    {
+        float theta = acosf(d);
+        float s = sinf(theta);
+        wa = sinf((1.0f - t) * theta) / s;
+        wb = sinf(t * theta) / s;
+    }
+
+    float norm = 0.0f;
+    for(int k = 0; k < 4; k++)
+    {
+        out[k] = a[k] * wa + b[k] * sign * wb;
+        norm += out[k] * out[k];
+    }
+
+    norm = norm > 0.0f ? 1.0f / sqrtf(norm) : 0.0f;
+    for(int k = 0; k < 4; k++)
+        out[k] *= norm;
+}
+
+// Catmull-Rom spline through p1 and p2, at t between them
+static float catmullRom(float p0, float p1, float p2, float p3, float t)
+{
+    return 0.5f * (2.0f * p1 + (p2 - p0) * t +
+                   (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t * t +
+                   (3.0f * (p1 - p2) + p3 - p0) * t * t * t);
+}
+
+void SampleCameraPath(const std::vector<CameraKey> &keys, float frame, CameraKey *camera)
+{
+    int last = (int)keys.size() - 1;
+    if( last == 0 || frame <= keys[0].frame ) {
+        *camera = keys[0];
+        camera->frame = frame;
+        return;
+    }
+    if( frame >= keys[last].frame ) {
+        *camera = keys[last];
+        camera->frame = frame;
+        return;
+    }
+
+    // keys i and i + 1 around the frame, and their neighbours for the spline
+    int i = 0;
+    while( keys[i + 1].frame < frame )
+        i++;
+    const CameraKey &k0 = keys[i > 0 ? i - 1 : i];
+    const CameraKey &k1 = keys[i];
+    const CameraKey &k2 = keys[i + 1];
+    const CameraKey &k3 = keys[i + 2 <= last ? i + 2 : i + 1];
+    float t = (frame - k1.frame) / (k2.frame - k1.frame);
+
+    camera->frame = frame;
+    slerp(k1.rotation, k2.rotation, t, camera->rotation);
+    camera->dolly = catmullRom(k0.dolly, k1.dolly, k2.dolly, k3.dolly, t);
+    for(int k = 0; k < 3; k++)
+        camera->pan[k] = catmullRom(k0.pan[k], k1.pan[k], k2.pan[k], k3.pan[k], t);
+}
@@ -0,0 +1,35 @@
+//
+// keyframed camera paths for rendering flythroughs
+//
+// A path is a text file with one key per line:
+//
+//     <frame>  <rotation x y z w>  <dolly>  <pan x y z>
+//
+// giving the state of the viewer's trackball (nv::GlutExamine) at that
+// frame. Keys must be in increasing frame order; blank lines and lines
+// starting with # are skipped. Between keys the rotation is interpolated
+// along the shorter great arc and the dolly and pan along Catmull-Rom
+// splines, so the camera does not jerk as it passes a key.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CAMERA_PATH_H
+#define _CAMERA_PATH_H
+
+#include <vector>
+
+struct CameraKey {
+    float frame;
+    float rotation[4];  // quaternion (x, y, z, w)
+    float dolly;
+    float pan[3];
+};
+
+// reads the keys of a path file. Returns 0 and prints the line at fault if
+// it cannot be read, has no keys or has keys out of order.
+int LoadCameraPath(const char *filename, std::vector<CameraKey> *keys);
+
+// camera of the path at a frame, which is clamped to the first and last key
+void SampleCameraPath(const std::vector<CameraKey> &keys, float frame, CameraKey *camera);
+
+#endif
@@ -0,0 +1,214 @@
+//
+// the caves and enclosed air pockets of a grid of chunks
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+
+#include "CaveVolume.h"
+#include "TaskPool.h"
+
+CaveVolume::CaveVolume(int chunksX, int chunksZ)
+    : m_chunksX(chunksX),
+      m_chunksZ(chunksZ),
+      m_cells((size_t)chunksX * chunksZ * CHUNK_BLOCKS, CAVE_NONE),
+      m_caveBlocks(0),
+      m_rounds(0),
+      m_updateTime(0.0)
+{
+}
+
+void
+CaveVolume::classify(const ChunkData *chunk, int i, int j, std::vector<int> &seeds)
+{
+    for(int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for(int z = 0; z < CHUNK_SIZE; z++)
+        {
+            unsigned char *column = &m_cells[cellIndex(i * CHUNK_SIZE + x, 0, j * CHUNK_SIZE + z)];
+            for(int y = 0; y < CHUNK_HEIGHT; y++)
+            {
+                int bpos = ChunkIndex(x, y, z);
+                int sky = ChunkNibble(chunk->skyLight, bpos);
+                if( chunk->blocks[bpos] != 0 || sky >= OPEN_SKY )
+                    column[y] = CAVE_NONE;
+                else
+                {
+                    column[y] = CAVE_ENCLOSED;
+                    if( sky == 0 )
+                        seeds.push_back(cellIndex(i * CHUNK_SIZE + x, y, j * CHUNK_SIZE + z));
+                }
+            }
+        }
+    }
+}
+
+void
+CaveVolume::clearChunk(int i, int j)
+{
+    for(int x = 0; x < CHUNK_SIZE; x++)
+        memset(&m_cells[cellIndex(i * CHUNK_SIZE + x, 0, j * CHUNK_SIZE)], CAVE_NONE, CHUNK_SIZE * CHUNK_HEIGHT);
+}
+
+void
+CaveVolume::findSeeds(int i, int j, const std::vector<char> &changed, std::vector<int> &seeds) const
+{
+    seeds.clear();
+
+    // the four sides as the neighbour, the first block of this chunk
+    // along the side, the step along it and the step across into the
+    // neighbour
+    const int depth = m_chunksZ * CHUNK_SIZE * CHUNK_HEIGHT;
+    const int x0 = i * CHUNK_SIZE, z0 = j * CHUNK_SIZE;
+    struct Side { int i, j, first, along, across; } sides[4] = {
+        { i - 1, j, cellIndex(x0, 0, z0), CHUNK_HEIGHT, -depth },
+        { i + 1, j, cellIndex(x0 + CHUNK_SIZE - 1, 0, z0), CHUNK_HEIGHT, depth },
+        { i, j - 1, cellIndex(x0, 0, z0), depth, -CHUNK_HEIGHT },
+        { i, j + 1, cellIndex(x0, 0, z0 + CHUNK_SIZE - 1), depth, CHUNK_HEIGHT },
+    };
+
+    for(int s = 0; s < 4; s++)
+    {
+        const Side &side = sides[s];
+        if( side.i < 0 || side.i >= m_chunksX || side.j < 0 || side.j >= m_chunksZ ||
+            !changed[side.i * m_chunksZ + side.j] )
+            continue;
+
+        for(int a = 0; a < CHUNK_SIZE; a++)
+        {
+            int c = side.first + a * side.along;
+            for(int y = 0; y < CHUNK_HEIGHT; y++, c++)
+                if( m_cells[c] == CAVE_ENCLOSED && m_cells[c + side.across] == CAVE_AIR )
+                    seeds.push_back(c);
+        }
+    }
+}
+
+int
+CaveVolume::flood(int i, int j, std::vector<int> &stack)
+{
+    // the fill stays within chunk (i,j); what reaches its sides is picked
+    // up by the neighbours in the next round
+    const int depth = m_chunksZ * CHUNK_SIZE * CHUNK_HEIGHT;
+    int filled = 0;
+
+    for(size_t s = 0; s < stack.size(); s++)
+    {
+        if( m_cells[stack[s]] == CAVE_ENCLOSED ) {
+            m_cells[stack[s]] = CAVE_AIR;
+            filled++;
+        }
+    }
+
+    while( !stack.empty() )
+    {
+        int c = stack.back();
+        stack.pop_back();
+
+        int y = c % CHUNK_HEIGHT;
+        int z = c / CHUNK_HEIGHT % (m_chunksZ * CHUNK_SIZE) - j * CHUNK_SIZE;
+        int x = c / depth - i * CHUNK_SIZE;
+
+        int next[6];
+        int n = 0;
+        if( y > 0 ) next[n++] = c - 1;
+        if( y < CHUNK_HEIGHT - 1 ) next[n++] = c + 1;
+        if( z > 0 ) next[n++] = c - CHUNK_HEIGHT;
+        if( z < CHUNK_SIZE - 1 ) next[n++] = c + CHUNK_HEIGHT;
+        if( x > 0 ) next[n++] = c - depth;
+        if( x < CHUNK_SIZE - 1 ) next[n++] = c + depth;
+
+        for(int k = 0; k < n; k++)
+        {
+            if( m_cells[next[k]] == CAVE_ENCLOSED ) {
+                m_cells[next[k]] = CAVE_AIR;
+                stack.push_back(next[k]);
+                filled++;
+            }
+        }
+    }
+    return filled;
+}
+
+int
+CaveVolume::extract(const char *world, int cx, int cz)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int count = m_chunksX * m_chunksZ;
+    TaskPool &pool = TaskPool::shared();
+    std::vector<ChunkData*> chunks(pool.getThreadCount(), (ChunkData*)NULL);
+    std::vector< std::vector<int> > seeds(count);
+    std::vector<char> changed(count, 0);
+    std::atomic<int> found(0);
+
+    // first round: every chunk floods from its own dark air
+    pool.parallelFor(count, [&](int task, int worker) {
+        int i = task / m_chunksZ;
+        int j = task % m_chunksZ;
+        if( chunks[worker] == NULL )
+            chunks[worker] = new ChunkData;
+        ChunkData *chunk = chunks[worker];
+
+        if( !ReadRegionChunk(world, cx + i, cz + j, chunk) ) {
+            clearChunk(i, j);
+            return;
+        }
+        classify(chunk, i, j, seeds[task]);
+        changed[task] = flood(i, j, seeds[task]) > 0;
+        found++;
+    });
+
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    // then the cave that reached the sides of a chunk crosses into its
+    // neighbours, one chunk further each round
+    m_rounds = 1;
+    for(;;)
+    {
+        pool.parallelFor(count, [&](int task, int /*worker*/) {
+            findSeeds(task / m_chunksZ, task % m_chunksZ, changed, seeds[task]);
+        });
+
+        bool more = false;
+        for(int c = 0; c < count; c++)
+            more = more || !seeds[c].empty();
+        if( !more )
+            break;
+
+        pool.parallelFor(count, [&](int task, int /*worker*/) {
+            changed[task] = !seeds[task].empty() && flood(task / m_chunksZ, task % m_chunksZ, seeds[task]) > 0;
+        });
+        m_rounds++;
+    }
+
+    m_caveBlocks = 0;
+    for(size_t c = 0; c < m_cells.size(); c++)
+        m_caveBlocks += m_cells[c] == CAVE_AIR;
+
+    m_updateTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return found;
+}
+
+void
+CaveVolume::colorize(unsigned char *volume) const
+{
+    // deep caves dark blue, shallow ones pale, all of them opaque
+    for(size_t c = 0; c < m_cells.size(); c++)
+    {
+        unsigned char *texel = volume + c * 4;
+        if( m_cells[c] != CAVE_AIR ) {
+            texel[0] = texel[1] = texel[2] = texel[3] = 0;
+            continue;
+        }
+
+        int y = (int)(c % CHUNK_HEIGHT);
+        texel[0] = (unsigned char)(40 + y * 160 / CHUNK_HEIGHT);
+        texel[1] = (unsigned char)(70 + y * 170 / CHUNK_HEIGHT);
+        texel[2] = (unsigned char)(150 + y * 105 / CHUNK_HEIGHT);
+        texel[3] = 255;
+    }
+}
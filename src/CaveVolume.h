@@ -0,0 +1,71 @@
+//
+// the caves and enclosed air pockets of a grid of chunks
+//
+// Air is told apart by its sky light: air at the open sky level is outside,
+// and any other air is enclosed, under an overhang, in a cave or in a cave
+// mouth. Caves are the enclosed air reached by a flood fill from the dark
+// air with no sky light at all, so the shade under a tree, which no dark
+// air reaches, stays out while the dim mouth of a cave is kept.
+//
+// The fill runs per chunk as tasks of the shared TaskPool. Each chunk is
+// classified and flooded from its own dark air; then every chunk takes as
+// new seeds its enclosed air facing cave across the side of a neighbour
+// that changed, and floods again, until a round changes nothing. A chunk
+// only ever writes its own cells, so the tasks of a round never race.
+//
+// The cells are laid out as the volume, height fastest, then z and x, so
+// colorize writes a mask volume that the renderers draw instead of the
+// terrain.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CAVE_VOLUME_H
+#define _CAVE_VOLUME_H
+
+#include <vector>
+#include "ChunkReader.h"
+
+// cells of a CaveVolume
+enum CaveCell { CAVE_NONE = 0, CAVE_ENCLOSED, CAVE_AIR };
+
+class CaveVolume {
+public:
+    // air at this sky light or more is under the open sky
+    static const int OPEN_SKY = 15;
+
+    // grid of chunksX by chunksZ chunks, with no caves
+    CaveVolume(int chunksX, int chunksZ);
+
+    // reads the grid with chunk (cx,cz) at its NW corner and finds its
+    // caves. Returns the number of chunks found; missing ones are solid.
+    int extract(const char *world, int cx, int cz);
+
+    // writes the RGBA volume of the grid with the cave air colored by
+    // height and every other texel clear
+    void colorize(unsigned char *volume) const;
+
+    // cell of block (x,y,z) of the grid is cells[y + (z + x * depth) * 128]
+    // for depth the grid's extent in z in blocks
+    const unsigned char *getCells() const { return &m_cells[0]; }
+    unsigned char getCell(int x, int y, int z) const { return m_cells[cellIndex(x, y, z)]; }
+
+    // cave blocks, flood rounds and milliseconds of the last extract
+    long long getCaveBlocks() const { return m_caveBlocks; }
+    int getRounds() const { return m_rounds; }
+    double getUpdateTime() const { return m_updateTime; }
+
+private:
+    int cellIndex(int x, int y, int z) const { return y + (z + x * m_chunksZ * CHUNK_SIZE) * CHUNK_HEIGHT; }
+    void classify(const ChunkData *chunk, int i, int j, std::vector<int> &seeds);
+    void clearChunk(int i, int j);
+    void findSeeds(int i, int j, const std::vector<char> &changed, std::vector<int> &seeds) const;
+    int flood(int i, int j, std::vector<int> &stack);
+
+    int m_chunksX, m_chunksZ;
+    std::vector<unsigned char> m_cells;
+    long long m_caveBlocks;
+    int m_rounds;
+    double m_updateTime;
+};
+
+#endif
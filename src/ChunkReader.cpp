@@ -0,0 +1,370 @@
+//
+// reads the block and light arrays of single chunks from a Minecraft world
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+extern "C"
+{
+    #include "nbt.h"
+}
+
+#include "ChunkReader.h"
+#include "WorldCache.h"
+
+const int CHUNK_DEFLATE_MAX = 1024 * 64;  // 64KB limit for compressed chunks
+const int CHUNK_INFLATE_MAX = 1024 * 128; // 128KB limit for inflated chunks
+
+static const char base36digits[37] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static std::string base36(int M)
+{
+    std::string str;
+    do {
+        str.insert(str.begin(), base36digits[M % 36]);
+        M /= 36;
+    } while(M > 0);
+    return str;
+}
+
+// copies one of the Level byte arrays into dest, checking its size
+static bool copyByteArray(nbt_tag *level, const char *name, unsigned char *dest, unsigned int size)
+{
+    nbt_tag *tag = nbt_find_tag_by_name(name, level);
+    if( tag == NULL )
+        return false;
+
+    nbt_byte_array *arr = nbt_cast_byte_array(tag);
+    if( arr == NULL || arr->length < size )
+        return false;
+
+    memcpy(dest, arr->content, size);
+    return true;
+}
+
+// pulls Blocks, SkyLight, BlockLight and, if present, HeightMap out of a
+// parsed chunk
+static int extractChunk(nbt_file *nbt, ChunkData *chunk)
+{
+    nbt_tag *level = nbt_find_tag_by_name("Level", nbt->root);
+    if( level == NULL )
+        return 0;
+
+    if( !copyByteArray(level, "Blocks", chunk->blocks, CHUNK_BLOCKS) ||
+        !copyByteArray(level, "SkyLight", chunk->skyLight, CHUNK_BLOCKS / 2) ||
+        !copyByteArray(level, "BlockLight", chunk->blockLight, CHUNK_BLOCKS / 2) )
+        return 0;
+    chunk->hasHeightMap = copyByteArray(level, "HeightMap", chunk->heightMap, CHUNK_SIZE * CHUNK_SIZE);
+
+    return 1;
+}
+
+int DecodeChunk(unsigned char *nbtData, unsigned int length, ChunkData *chunk)
+{
+    nbt_file *nbt = NULL;
+    if (nbt_init(&nbt) != NBT_OK)
+        return 0;
+
+    int ok = 0;
+    if( nbt_parse_buffer(nbt, nbtData, length) == NBT_OK )
+        ok = extractChunk(nbt, chunk);
+
+    nbt_free(nbt);
+
+    return ok;
+}
+
+int ReadRegionPayload(const char *world, int cx, int cz, std::vector<unsigned char> *payload)
+{
+    char path[512];
+    sprintf(path, "%s/region/r.%d.%d.mcr", world, cx>>5, cz>>5);
+
+    FILE *ptr = fopen(path, "rb");
+    if( ptr == NULL )
+        return 0;
+
+    unsigned char buf[5];
+    bool readOk = false;
+
+    // the chunk offset for (x,z) begins at byte 4*(x+z*32)
+    if( fseek(ptr, 4 * ((cx & 31) + (cz & 31) * 32), SEEK_SET) == 0 &&
+        fread(buf, 4, 1, ptr) == 1 )
+    {
+        int sectorNumber = buf[3];
+        int chunkOffset = buf[0]<<16 | buf[1]<<8 | buf[2];
+
+        if( chunkOffset != 0 &&
+            fseek(ptr, 4096 * chunkOffset, SEEK_SET) == 0 &&
+            fread(buf, 5, 1, ptr) == 1 )
+        {
+            int chunkLength = buf[0]<<24 | buf[1]<<16 | buf[2]<<8 | buf[3];
+
+            // only handle zlib-compressed chunks (v2)
+            if( chunkLength > 1 && chunkLength <= sectorNumber * 4096 &&
+                chunkLength <= CHUNK_DEFLATE_MAX && buf[4] == 2 )
+            {
+                payload->resize(chunkLength - 1);
+                readOk = fread(&(*payload)[0], chunkLength - 1, 1, ptr) == 1;
+            }
+        }
+    }
+    fclose(ptr);
+
+    return readOk ? 1 : 0;
+}
+
+int InflateChunk(const unsigned char *payload, unsigned int length, ChunkData *chunk)
+{
+    std::vector<unsigned char> out(CHUNK_INFLATE_MAX);
+    z_stream strm;
+    strm.zalloc = (alloc_func)NULL;
+    strm.zfree = (free_func)NULL;
+    strm.opaque = NULL;
+
+    strm.next_out = &out[0];
+    strm.avail_out = CHUNK_INFLATE_MAX;
+    strm.avail_in = length;
+    strm.next_in = (unsigned char *)payload;
+
+    inflateInit(&strm);
+    int status = inflate(&strm, Z_FINISH); // decompress in one step
+    inflateEnd(&strm);
+
+    if (status != Z_STREAM_END)
+        return 0;
+
+    return DecodeChunk(&out[0], CHUNK_INFLATE_MAX - strm.avail_out, chunk);
+}
+
+int ReadRegionChunk(const char *world, int cx, int cz, ChunkData *chunk)
+{
+    const WorldCache *cache = GetChunkCache();
+    if( cache != NULL && cache->readChunk(world, cx, cz, chunk) )
+        return 1;
+
+    std::vector<unsigned char> in;
+    if( !ReadRegionPayload(world, cx, cz, &in) )
+        return 0;
+
+    return InflateChunk(&in[0], (unsigned int)in.size(), chunk);
+}
+
+int ReadRegionTimestamps(const char *world, const RegionCoord &region, unsigned int *stamps)
+{
+    char path[512];
+    sprintf(path, "%s/region/r.%d.%d.mcr", world, region.x, region.z);
+
+    FILE *ptr = fopen(path, "rb");
+    if( ptr == NULL )
+        return 0;
+
+    // 4KB of chunk offsets followed by 4KB of timestamps
+    const int entries = REGION_CHUNKS * REGION_CHUNKS;
+    std::vector<unsigned char> header(entries * 8);
+    bool ok = fread(&header[0], header.size(), 1, ptr) == 1;
+    fclose(ptr);
+
+    if( !ok )
+        return 0;
+
+    for(int c = 0; c < entries; c++)
+    {
+        const unsigned char *offset = &header[c * 4];
+        const unsigned char *stamp = &header[(entries + c) * 4];
+        bool stored = (offset[0] | offset[1] | offset[2]) != 0;
+        stamps[c] = stored ? (unsigned int)stamp[0]<<24 | stamp[1]<<16 | stamp[2]<<8 | stamp[3] : 0;
+    }
+    return 1;
+}
+
+// names of the entries of a directory, false if it cannot be read
+static bool listDirectory(const char *path, std::vector<std::string> *names)
+{
+    names->clear();
+
+#ifdef _WIN32
+    char pattern[512];
+    snprintf(pattern, sizeof(pattern), "%s/*", path);
+
+    WIN32_FIND_DATA ffd;
+    HANDLE hFind = FindFirstFile(pattern, &ffd);
+    if( hFind == INVALID_HANDLE_VALUE )
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+
+    do {
+        names->push_back(ffd.cFileName);
+    } while( FindNextFile(hFind, &ffd) );
+    FindClose(hFind);
+#else
+    DIR *dir = opendir(path);
+    if( dir == NULL )
+        return false;
+
+    struct dirent *entry;
+    while( (entry = readdir(dir)) != NULL )
+        names->push_back(entry->d_name);
+    closedir(dir);
+#endif
+
+    return true;
+}
+
+// region position from a file name of the form r.x.z.mcr
+static bool parseRegionName(const char *name, RegionCoord *region)
+{
+    int length = 0;
+    if( sscanf(name, "r.%d.%d.mcr%n", &region->x, &region->z, &length) != 2 )
+        return false;
+    return length > 0 && name[length] == '\0';
+}
+
+int ListRegions(const char *world, std::vector<RegionCoord> *regions)
+{
+    regions->clear();
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/region", world);
+    std::vector<std::string> names;
+    if( !listDirectory(path, &names) )
+        return 0;
+
+    RegionCoord region;
+    for(size_t i = 0; i < names.size(); i++)
+        if( parseRegionName(names[i].c_str(), &region) )
+            regions->push_back(region);
+
+    return 1;
+}
+
+// a signed base 36 number running up to a '.', advancing name past it
+static bool parseBase36(const char **name, int *value)
+{
+    const char *c = *name;
+    bool negative = *c == '-';
+    if( negative )
+        c++;
+
+    int v = 0, digits = 0;
+    for( ; *c != '.'; c++, digits++)
+    {
+        const char *d = *c != '\0' ? strchr(base36digits, *c) : NULL;
+        if( d == NULL || digits > 6 )
+            return false;
+        v = v * 36 + (int)(d - base36digits);
+    }
+    if( digits == 0 )
+        return false;
+
+    *value = negative ? -v : v;
+    *name = c + 1;
+    return true;
+}
+
+// chunk position from a file name of the form c.x.z.dat, in base 36
+static bool parseOldChunkName(const char *name, ChunkCoord *chunk)
+{
+    if( strncmp(name, "c.", 2) != 0 )
+        return false;
+    name += 2;
+    return parseBase36(&name, &chunk->x) && parseBase36(&name, &chunk->z) && strcmp(name, "dat") == 0;
+}
+
+int ListOldChunks(const char *world, int xt, int zt, std::vector<ChunkCoord> *chunks)
+{
+    chunks->clear();
+
+    std::string path = std::string(world) + "/" + base36(xt) + "/" + base36(zt);
+    std::vector<std::string> names;
+    if( !listDirectory(path.c_str(), &names) )
+        return 0;
+
+    ChunkCoord chunk;
+    for(size_t i = 0; i < names.size(); i++)
+        if( parseOldChunkName(names[i].c_str(), &chunk) )
+            chunks->push_back(chunk);
+
+    return 1;
+}
+
+int ReadOldChunk(const char *world, int cx, int cz, ChunkData *chunk)
+{
+    // directories are named after the chunk position modulo 64 in base 36
+    int xt = cx % 64;
+    int zt = cz % 64;
+    if( xt < 0 ) xt += 64;
+    if( zt < 0 ) zt += 64;
+
+    std::string x36 = base36(abs(cx));
+    std::string z36 = base36(abs(cz));
+    if( cx < 0 ) x36 = "-" + x36;
+    if( cz < 0 ) z36 = "-" + z36;
+
+    std::string path = std::string(world) + "/" + base36(xt) + "/" + base36(zt) +
+                       "/c." + x36 + "." + z36 + ".dat";
+
+    nbt_file *nbt = NULL;
+    if (nbt_init(&nbt) != NBT_OK)
+        return 0;
+
+    int ok = 0;
+    if( nbt_parse(nbt, path.c_str(), 0) == NBT_OK )
+        ok = extractChunk(nbt, chunk);
+
+    nbt_free(nbt);
+
+    return ok;
+}
+
+int ReadPlayerPosition(const char *world, double *x, double *y, double *z)
+{
+    char path[512];
+    sprintf(path, "%s/level.dat", world);
+
+    nbt_file *nbt = NULL;
+    if (nbt_init(&nbt) != NBT_OK)
+        return 0;
+
+    int ok = 0;
+    if (nbt_parse(nbt, path, 0) == NBT_OK)
+    {
+        nbt_tag *data = nbt_find_tag_by_name("Data", nbt->root);
+        nbt_tag *player = data ? nbt_find_tag_by_name("Player", data) : NULL;
+        nbt_tag *pos = player ? nbt_find_tag_by_name("Pos", player) : NULL;
+        nbt_list *posList = pos ? nbt_cast_list(pos) : NULL;
+
+        if( posList != NULL && posList->length >= 3 )
+        {
+            double **posArr = (double**)posList->content;
+            *x = *posArr[0];
+            *y = *posArr[1];
+            *z = *posArr[2];
+            ok = 1;
+        }
+    }
+
+    nbt_free(nbt);
+
+    return ok;
+}
+
+int ReadPlayerChunk(const char *world, int *cx, int *cz)
+{
+    double x, y, z;
+    if( !ReadPlayerPosition(world, &x, &y, &z) )
+        return 0;
+
+    *cx = (int)x / 16;
+    *cz = (int)z / 16;
+    return 1;
+}
@@ -0,0 +1,101 @@
+//
+// reads the block and light arrays of single chunks from a Minecraft world
+//
+// Plain C++ with no windowing or GL dependencies, so the same decoding is
+// shared by the viewer and the headless tools. Every call uses its own
+// buffers and nbt_file, so chunks may be read from several threads at once.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CHUNK_READER_H
+#define _CHUNK_READER_H
+
+#include <vector>
+
+// dimensions of a chunk in blocks
+const int CHUNK_SIZE = 16;
+const int CHUNK_HEIGHT = 128;
+const int CHUNK_BLOCKS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT;
+// block ids a chunk can hold
+const int BLOCK_IDS = 256;
+
+// edge length of a region file in chunks
+const int REGION_CHUNKS = 32;
+
+// position of a region file, region (x,z) holding chunks
+// [x * 32, x * 32 + 32) by [z * 32, z * 32 + 32)
+struct RegionCoord {
+    int x, z;
+};
+
+// position of a chunk, in chunks
+struct ChunkCoord {
+    int x, z;
+};
+
+// decoded contents of one chunk, in the on-disk layout:
+// block index = y + z * 128 + x * 128 * 16, light stored as two nibbles per
+// byte with the even index in the low nibble
+struct ChunkData {
+    unsigned char blocks[CHUNK_BLOCKS];
+    unsigned char skyLight[CHUNK_BLOCKS / 2];
+    unsigned char blockLight[CHUNK_BLOCKS / 2];
+    // HeightMap tag, the lowest height sky light reaches unblocked in
+    // column [x + z * 16], if the chunk has one
+    unsigned char heightMap[CHUNK_SIZE * CHUNK_SIZE];
+    bool hasHeightMap;
+};
+
+// index of block (x,y,z) within a chunk
+inline unsigned int ChunkIndex(unsigned int x, unsigned int y, unsigned int z)
+{
+    return y + z * CHUNK_HEIGHT + x * CHUNK_HEIGHT * CHUNK_SIZE;
+}
+
+// extracts the light nibble of block index bpos from a packed light array
+inline unsigned char ChunkNibble(const unsigned char *light, unsigned int bpos)
+{
+    unsigned char c = light[bpos / 2];
+    return (bpos % 2 == 0) ? (c & 0xf) : ((c >> 4) & 0xf);
+}
+
+// reads chunk (cx,cz) from the region files (region/r.x.z.mcr) of the world
+// directory, or from the WorldCache set by SetChunkCache if it holds the
+// chunk as it is now. Returns 1 on success, 0 if the chunk is missing or
+// unreadable.
+int ReadRegionChunk(const char *world, int cx, int cz, ChunkData *chunk);
+
+// reads the zlib stream of chunk (cx,cz) as stored in its region file,
+// without decompressing it. Returns 0 if the chunk is missing or unreadable.
+int ReadRegionPayload(const char *world, int cx, int cz, std::vector<unsigned char> *payload);
+
+// reads chunk (cx,cz) from the old per-chunk format (a/b/c.x.z.dat)
+int ReadOldChunk(const char *world, int cx, int cz, ChunkData *chunk);
+
+// reads the modification times of the chunks of a region file into
+// stamps[x + z * 32], from the table after the chunk offsets. Chunks which
+// are not stored get 0. Returns 0 if the region file cannot be read.
+int ReadRegionTimestamps(const char *world, const RegionCoord &region, unsigned int *stamps);
+
+// lists the region files (region/r.x.z.mcr) of the world directory.
+// Returns 0 if the directory cannot be read.
+int ListRegions(const char *world, std::vector<RegionCoord> *regions);
+
+// lists the chunks stored in the old per-chunk format in directory
+// xt/zt (0 to 63 each) of the world, those with x and z equal to xt and zt
+// modulo 64. Returns 0 if the directory cannot be read.
+int ListOldChunks(const char *world, int xt, int zt, std::vector<ChunkCoord> *chunks);
+
+// reads the chunk containing the player from level.dat (Data/Player/Pos)
+int ReadPlayerChunk(const char *world, int *cx, int *cz);
+
+// reads the block position of the player from level.dat, y being the height
+int ReadPlayerPosition(const char *world, double *x, double *y, double *z);
+
+// extracts the block and light arrays from an uncompressed chunk NBT buffer
+int DecodeChunk(unsigned char *nbtData, unsigned int length, ChunkData *chunk);
+
+// decompresses and decodes the zlib stream of a chunk as read by ReadRegionPayload
+int InflateChunk(const unsigned char *payload, unsigned int length, ChunkData *chunk);
+
+#endif
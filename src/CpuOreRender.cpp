@@ -0,0 +1,143 @@
+//
+// class to draw the ores of an OreCloud on the CPU
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+
+#include "CpuOreRender.h"
+#include "TaskPool.h"
+
+// rows of pixels per task
+const int BAND_ROWS = 16;
+
+CpuOreRender::CpuOreRender(const OreCloud *ores, const VolumePalette *palette)
+    : m_ores(ores),
+      m_palette(palette),
+      m_brightness(1.0f),
+      m_threads(0),
+      m_renderTime(0.0)
+{
+}
+
+void
+CpuOreRender::render(const CpuCamera &camera, unsigned char *rgb, int imageWidth, int imageHeight)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const float *m = camera.modelView;
+    float f = 1.0f / tanf(camera.fovy * 0.5f * 3.14159265f / 180.0f);
+    float aspect = (float)imageWidth / imageHeight;
+
+    // the volume spans -0.5 to 0.5 on each axis, texel x being the block
+    // height and y and z the grid rows and columns, as in the loader
+    float dims[3] = { (float)CHUNK_HEIGHT,
+                      (float)(m_ores->getChunksZ() * CHUNK_SIZE),
+                      (float)(m_ores->getChunksX() * CHUNK_SIZE) };
+    // pixels per unit at unit depth, and the radius of the sphere around a block
+    float scale = 0.5f * imageHeight * f;
+    float radius = 0.5f * sqrtf(3.0f) / dims[0];
+
+    m_splats.clear();
+    for(int j = 0; j < m_ores->getChunksZ(); j++)
+    {
+        for(int i = 0; i < m_ores->getChunksX(); i++)
+        {
+            const std::vector<OrePoint> &list = m_ores->getChunk(i, j);
+            for(size_t o = 0; o < list.size(); o++)
+            {
+                const OrePoint &p = list[o];
+                float P[3] = { (p.y + 0.5f) / dims[0] - 0.5f,
+                               (j * CHUNK_SIZE + p.z + 0.5f) / dims[1] - 0.5f,
+                               (i * CHUNK_SIZE + p.x + 0.5f) / dims[2] - 0.5f };
+
+                float ex = m[0] * P[0] + m[4] * P[1] + m[8] * P[2] + m[12];
+                float ey = m[1] * P[0] + m[5] * P[1] + m[9] * P[2] + m[13];
+                float depth = -(m[2] * P[0] + m[6] * P[1] + m[10] * P[2] + m[14]);
+                if( depth <= radius )
+                    continue;
+
+                float px = (ex / depth * f / aspect + 1.0f) * 0.5f * imageWidth;
+                float py = (1.0f - ey / depth * f) * 0.5f * imageHeight;
+                float s = radius * scale / depth;
+
+                // pixels whose centres fall inside the splat, at least the
+                // one under its centre
+                Splat splat;
+                splat.x0 = (int)ceilf(px - s - 0.5f);
+                splat.x1 = (int)floorf(px + s - 0.5f);
+                splat.y0 = (int)ceilf(py - s - 0.5f);
+                splat.y1 = (int)floorf(py + s - 0.5f);
+                if( splat.x1 < splat.x0 )
+                    splat.x0 = splat.x1 = (int)floorf(px);
+                if( splat.y1 < splat.y0 )
+                    splat.y0 = splat.y1 = (int)floorf(py);
+
+                if( splat.x0 < 0 ) splat.x0 = 0;
+                if( splat.y0 < 0 ) splat.y0 = 0;
+                if( splat.x1 >= imageWidth ) splat.x1 = imageWidth - 1;
+                if( splat.y1 >= imageHeight ) splat.y1 = imageHeight - 1;
+                if( splat.x0 > splat.x1 || splat.y0 > splat.y1 )
+                    continue;
+
+                // lit as the loader lights the volume texel
+                float d = (p.light >> 4) / 15.0f + (p.light & 15) / 15.0f + 0.5f;
+                if( d > 1 ) d = 1;
+                d *= m_brightness;
+                for(int k = 0; k < 3; k++)
+                {
+                    float v = m_palette->colors[p.id][k] / 255.0f * d;
+                    splat.rgb[k] = (unsigned char)((v < 1.0f ? v : 1.0f) * 255.0f + 0.5f);
+                }
+                splat.depth = depth;
+                m_splats.push_back(splat);
+            }
+        }
+    }
+
+    // each band of rows draws the splats which reach into it
+    int bands = (imageHeight + BAND_ROWS - 1) / BAND_ROWS;
+    m_bands.resize(bands);
+    for(int b = 0; b < bands; b++)
+        m_bands[b].clear();
+    for(size_t s = 0; s < m_splats.size(); s++)
+    {
+        for(int b = m_splats[s].y0 / BAND_ROWS; b <= m_splats[s].y1 / BAND_ROWS; b++)
+            m_bands[b].push_back((int)s);
+    }
+
+    m_depth.resize((size_t)imageWidth * imageHeight);
+
+    TaskPool::shared().parallelFor(bands, [&](int b, int /*worker*/) {
+        int y0 = b * BAND_ROWS;
+        int y1 = y0 + BAND_ROWS < imageHeight ? y0 + BAND_ROWS : imageHeight;
+
+        size_t first = (size_t)y0 * imageWidth, count = (size_t)(y1 - y0) * imageWidth;
+        memset(rgb + first * 3, 0, count * 3);
+        for(size_t p = first; p < first + count; p++)
+            m_depth[p] = 1e30f;
+
+        const std::vector<int> &bin = m_bands[b];
+        for(size_t s = 0; s < bin.size(); s++)
+        {
+            const Splat &splat = m_splats[bin[s]];
+            int sy0 = splat.y0 > y0 ? splat.y0 : y0;
+            int sy1 = splat.y1 < y1 - 1 ? splat.y1 : y1 - 1;
+            for(int y = sy0; y <= sy1; y++)
+            {
+                size_t p = (size_t)y * imageWidth + splat.x0;
+                for(int x = splat.x0; x <= splat.x1; x++, p++)
+                {
+                    if( splat.depth >= m_depth[p] )
+                        continue;
+                    m_depth[p] = splat.depth;
+                    memcpy(rgb + p * 3, splat.rgb, 3);
+                }
+            }
+        }
+    }, m_threads);
+
+    m_renderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
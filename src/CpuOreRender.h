@@ -0,0 +1,56 @@
+//
+// class to draw the ores of an OreCloud on the CPU
+//
+// The CPU counterpart of OreRender for ore views: every ore is projected
+// with the same camera as CpuVolumeRender and drawn as a square splat the
+// size of its block, nearest first by a depth buffer, in the palette color
+// lit as in the volume. The time taken follows the number of ores rather
+// than the size of the volume. Splats are binned into bands of rows which
+// are drawn on the shared TaskPool.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CPU_ORE_RENDER_H
+#define _CPU_ORE_RENDER_H
+
+#include <vector>
+
+#include "CpuVolumeRender.h"
+#include "OreCloud.h"
+#include "VolumeLoader.h"
+
+class CpuOreRender {
+public:
+    CpuOreRender(const OreCloud *ores, const VolumePalette *palette);
+
+    // renders into rgb, imageWidth*imageHeight pixels of three bytes, top row first
+    void render(const CpuCamera &camera, unsigned char *rgb, int imageWidth, int imageHeight);
+
+    void setBrightness(float x) { m_brightness = x; }
+    // number of worker threads of the shared TaskPool, 0 to use every core
+    void setThreads(int n) { m_threads = n; }
+
+    // wall clock time of the last render in milliseconds
+    double getRenderTime() { return m_renderTime; }
+    // ores drawn by the last render, leaving out those behind the eye
+    int getSplatCount() { return (int)m_splats.size(); }
+
+private:
+    struct Splat {
+        int x0, y0, x1, y1;     // pixels covered, inclusive
+        float depth;
+        unsigned char rgb[3];
+    };
+
+    const OreCloud *m_ores;
+    const VolumePalette *m_palette;
+    float m_brightness;
+    int m_threads;
+    double m_renderTime;
+
+    std::vector<Splat> m_splats;
+    std::vector< std::vector<int> > m_bands;
+    std::vector<float> m_depth;
+};
+
+#endif
@@ -0,0 +1,91 @@
+//
+// SIMD ray packet traversal for the CPU volume renderer
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "CpuRayPacket.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+
+static int detectWidth()
+{
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if( !sse41 )
+        return 1;
+    if( !osxsave || maxLeaf < 7 )
+        return 4;
+
+    // the OS must save the ymm (and for AVX-512 the zmm and mask) state
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+    bool avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+
+#if defined(_M_X64)
+    if( avx512 )
+        return 16;
+#endif
+    return avx2 ? 8 : 4;
+}
+
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+static int detectWidth()
+{
+    __builtin_cpu_init();
+#if defined(__x86_64__)
+    if( __builtin_cpu_supports("avx512f") )
+        return 16;
+#endif
+    if( __builtin_cpu_supports("avx2") )
+        return 8;
+    if( __builtin_cpu_supports("sse4.1") )
+        return 4;
+    return 1;
+}
+
+#else
+
+static int detectWidth()
+{
+    return 1;
+}
+
+#endif
+
+int DetectPacketWidth()
+{
+    static int width = detectWidth();
+    return width;
+}
+
+PacketTileFunc GetPacketTileFunc(int maxWidth, int *width)
+{
+    int supported = DetectPacketWidth();
+    if( maxWidth > supported )
+        maxWidth = supported;
+
+    if( maxWidth >= 16 ) {
+        *width = 16;
+        return RenderPacketTileAVX512;
+    }
+    if( maxWidth >= 8 ) {
+        *width = 8;
+        return RenderPacketTileAVX2;
+    }
+    if( maxWidth >= 4 ) {
+        *width = 4;
+        return RenderPacketTileSSE;
+    }
+
+    *width = 1;
+    return NULL;
+}
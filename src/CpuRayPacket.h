@@ -0,0 +1,432 @@
+//
+// SIMD ray packet traversal for the CPU volume renderer
+//
+// A packet holds 4, 8 or 16 horizontally adjacent primary rays, one per SIMD
+// lane. Ray setup, IntersectBox, sampling and front-to-back compositing run
+// on all lanes at once; lanes that miss the box, fall outside the tile or
+// have left the box are masked off. The kernel below is written once against
+// a small lane interface and instantiated by one translation unit per
+// instruction set (CpuRayPacketSSE/AVX2/AVX512.cpp), each of which is
+// compiled for its target. The best one supported by the running CPU is
+// picked at runtime.
+//
+// With an occupancy grid the packet leaps over chunk columns and bricks
+// once every lane still marching is inside an empty one. Samples keep their
+// positions P0 + i * Pstep, so leaping only drops samples that would have
+// added nothing. Lanes whose opacity reaches the threshold stop marching.
+// With a ShadeVolume the colors of samples are scaled by one of its
+// channels, fetched with a second gather.
+//
+// The lane interface L provides:
+//   N               - lane count
+//   F, M, I         - float, mask and int32 vector types
+//   set1, ramp      - broadcast, and the vector (0, 1, ..., N-1)
+//   add sub mul div min max sqrt
+//   lt le ge        - comparisons returning masks
+//   mand, mor       - a & b, a | b of masks
+//   mandnot         - a & ~b
+//   any             - test for any set lane
+//   sel             - per lane a where the mask is set, else b
+//   hmin, hmax      - smallest and largest lane
+//   toInt, toFloat, iset1, addi, muli, shl, shr
+//   asFloat         - the bits of an int vector as floats
+//   gather          - 32-bit texel fetch of masked lanes, zero elsewhere
+//   channel         - byte of each int lane as float
+//   store           - write F to an array of N floats
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CPU_RAY_PACKET_H
+#define _CPU_RAY_PACKET_H
+
+#include <stddef.h>
+#include "OccupancyGrid.h"
+
+// per-frame state shared by all tiles of the CPU renderer
+struct RayFrame {
+    float invModelView[16];
+    float tanHalfFovy, aspect;
+    int width, height;
+    int tilesX, tilesY;
+    unsigned char *rgb;
+
+    const unsigned char *volume;
+    int volWidth, volHeight, volDepth;
+    float density, brightness;
+    int steps;
+    // rays stop once their opacity reaches this, 1 only stops opaque rays
+    float threshold;
+    // offset of the first sample, in steps
+    float jitter;
+    // steps are this many times the shader's, and opacity[a] the opacity
+    // of such a step through alpha byte a. NULL for steps of 1, where it
+    // is the alpha times the density.
+    float stepScale;
+    const float *opacity;
+
+    // levels of an OccupancyGrid of the volume, NULL to march every sample
+    const OccupancyLevel *occupancy;
+    int skipAlpha;
+
+    // ShadeVolume cells, one per texel, whose byte at shadeShift scales the
+    // color of the texel. NULL leaves colors unshaded.
+    const unsigned int *shade;
+    int shadeShift;
+
+    // no texel at or above this height holds anything, volWidth if unknown
+    int ceiling;
+};
+
+// renders the pixels [x0,x1) x [y0,y1) of a frame with ray packets
+typedef void (*PacketTileFunc)(const RayFrame &frame, int x0, int y0, int x1, int y1);
+
+void RenderPacketTileSSE(const RayFrame &frame, int x0, int y0, int x1, int y1);
+void RenderPacketTileAVX2(const RayFrame &frame, int x0, int y0, int x1, int y1);
+void RenderPacketTileAVX512(const RayFrame &frame, int x0, int y0, int x1, int y1);
+
+// widest packet (16, 8 or 4 lanes) the CPU and compiler support, 1 if none
+int DetectPacketWidth();
+
+// kernel for lanes no wider than maxWidth, NULL if no packet width fits
+PacketTileFunc GetPacketTileFunc(int maxWidth, int *width);
+
+// narrows the samples [*first, *remaining) of a ray to those below height
+// h of texture space, P0 being the ray's height at sample 0 and Pstep its
+// change per sample. A sample of margin is kept at either end for rounding.
+// Static, as each instruction set's translation unit compiles its own copy
+// for its target, which the linker must not pick for the others.
+static inline void CeilingSamples(float P0, float Pstep, float h, int *first, float *remaining)
+{
+    if( Pstep < 0.0f )
+    {
+        // coming down, samples up to this one are above h
+        float above = (h - P0) / Pstep - 1.0f;
+        if( above > *remaining )
+            above = *remaining;
+        if( above > *first )
+            *first = (int)above;
+    }
+    else if( Pstep > 0.0f )
+    {
+        // going up, samples from this one on are above h
+        float below = (h - P0) / Pstep + 1.0f;
+        if( below < *remaining )
+            *remaining = below;
+    }
+    else if( P0 >= h )
+        *remaining = 0.0f;
+}
+
+// number of samples the packet can leap over from its current sample, which
+// is at texel coordinates scaled (truncated to texel) in the in lanes. Every
+// lane that may still enter the volume must be inside it, in a cell with max
+// alpha at most skipAlpha. The lanes then walk the cells of the coarsest
+// level that is empty for all of them, as a 3D-DDA, until one reaches an
+// occupied cell. Otherwise returns 0 and sets *wait to the samples that must
+// be taken before another leap can succeed.
+template<class L>
+int PacketLeap(const RayFrame &f, typename L::M entering, typename L::M in,
+               const typename L::F scaled[3], const typename L::I texel[3],
+               const typename L::M forward[3], const typename L::F invStep[3],
+               int limit, int *wait)
+{
+    typedef typename L::F F;
+    typedef typename L::M M;
+    typedef typename L::I I;
+
+    // lanes outside the volume may be about to enter it
+    if( L::any(L::mandnot(entering, in)) )
+    {
+        *wait = 1;
+        return 0;
+    }
+
+    const F zero = L::set1(0.0f);
+    const F end = L::set1((float)limit);
+    const F skipAlpha = L::set1((float)f.skipAlpha);
+
+    // cell of each lane, for the coarsest level that is empty in every lane
+    // (a cell can only be empty if the finer cells inside it are)
+    int l = 0;
+    F cell[3];
+    M occupied;
+    for( ; l < OCCUPANCY_LEVELS; l++)
+    {
+        const OccupancyLevel &level = f.occupancy[l];
+
+        F c[3];
+        for(int k = 0; k < 3; k++)
+            c[k] = L::toFloat(L::shr(texel[k], level.shift[k]));
+        I index = L::toInt(L::add(L::mul(L::add(L::mul(c[2], L::set1((float)level.dims[1])), c[1]),
+                                         L::set1((float)level.dims[0])), c[0]));
+        occupied = L::mand(in, L::lt(skipAlpha, L::channel(L::gather((const unsigned char*)level.cells, index, in), 0)));
+        if( L::any(occupied) )
+            break;
+        for(int k = 0; k < 3; k++)
+            cell[k] = c[k];
+    }
+
+    // samples from the current one to the next cell boundary on each axis
+    const OccupancyLevel &level = f.occupancy[l > 0 ? l - 1 : 0];
+    F next[3], delta[3], step[3], dims[3];
+    for(int k = 0; k < 3; k++)
+    {
+        F size = L::set1((float)(1 << level.shift[k]));
+        F c = l > 0 ? cell[k] : L::toFloat(L::shr(texel[k], level.shift[k]));
+        F lo = L::mul(c, size);
+        F dist = L::sel(forward[k], L::sub(L::add(lo, size), scaled[k]), L::sub(scaled[k], lo));
+        next[k] = L::mul(dist, invStep[k]);
+        delta[k] = L::mul(size, invStep[k]);
+        step[k] = L::sel(forward[k], L::set1(1.0f), L::set1(-1.0f));
+        dims[k] = L::set1((float)level.dims[k]);
+    }
+
+    if( l == 0 )
+    {
+        // no leap until every occupied lane has left its brick
+        F exit = L::min(L::min(next[0], next[1]), L::min(next[2], end));
+        float n = L::hmax(L::sel(occupied, exit, zero));
+        *wait = n >= 1.0f ? (int)n : 1;
+        return 0;
+    }
+
+    // walk each lane through empty cells until it enters an occupied one or
+    // leaves the volume, only as far as the nearest stop of any lane
+    F stop = end;
+    M walking = in;
+    while( L::any(walking) )
+    {
+        F t = L::min(L::min(next[0], next[1]), next[2]);
+        M axis[3];
+        axis[0] = L::mand(walking, L::le(next[0], L::min(next[1], next[2])));
+        axis[1] = L::mandnot(L::mand(walking, L::le(next[1], next[2])), axis[0]);
+        axis[2] = L::mandnot(L::mandnot(walking, axis[0]), axis[1]);
+
+        M outside = L::mand(walking, L::le(end, t));
+        for(int k = 0; k < 3; k++)
+        {
+            cell[k] = L::sel(axis[k], L::add(cell[k], step[k]), cell[k]);
+            next[k] = L::sel(axis[k], L::add(next[k], delta[k]), next[k]);
+            outside = L::mor(outside, L::mand(walking, L::lt(cell[k], zero)));
+            outside = L::mor(outside, L::mand(walking, L::ge(cell[k], dims[k])));
+        }
+
+        // past the volume or the march nothing is left to sample
+        stop = L::sel(outside, end, stop);
+        walking = L::mandnot(walking, outside);
+
+        I index = L::toInt(L::add(L::mul(L::add(L::mul(cell[2], dims[1]), cell[1]), dims[0]), cell[0]));
+        M hit = L::mand(walking, L::lt(skipAlpha, L::channel(L::gather((const unsigned char*)level.cells, index, walking), 0)));
+        stop = L::sel(hit, t, stop);
+        walking = L::mandnot(walking, hit);
+
+        // lanes beyond the nearest stop cannot shorten the leap
+        walking = L::mand(walking, L::lt(t, L::set1(L::hmin(stop))));
+    }
+
+    float n = L::hmin(L::sel(in, stop, end));
+    return n >= 1.0f ? (int)n : 1;
+}
+
+template<class L>
+void MarchPacketTile(const RayFrame &f, int x0, int y0, int x1, int y1)
+{
+    typedef typename L::F F;
+    typedef typename L::M M;
+    typedef typename L::I I;
+
+    const float *m = f.invModelView;
+    const float stepsize = 1.41f / f.steps * f.stepScale;
+
+    const F zero = L::set1(0.0f);
+    const F one = L::set1(1.0f);
+    const F half = L::set1(0.5f);
+    const F boxMin = L::set1(-0.5f);
+    const F dims[3] = { L::set1((float)f.volWidth), L::set1((float)f.volHeight), L::set1((float)f.volDepth) };
+    const I rowLen = L::toInt(dims[0]);
+    const I sliceLen = L::toInt(dims[1]);
+    const F density = L::set1(f.density);
+    const F colorScale = L::set1(1.0f / 255.0f);
+    const F tileEnd = L::set1((float)x1);
+    const F skipAlpha = L::set1((float)f.skipAlpha);
+    const F threshold = L::set1(f.threshold);
+
+    float out[4][L::N];
+
+    for(int py = y0; py < y1; py++)
+    {
+        float ey = (1.0f - 2.0f * (py + 0.5f) / f.height) * f.tanHalfFovy;
+
+        for(int px = x0; px < x1; px += L::N)
+        {
+            F pxv = L::add(L::set1(px + 0.5f), L::ramp());
+            M active = L::lt(pxv, tileEnd);
+
+            // eye ray through the pixel centers, in object space
+            // (same operation order as CpuVolumeRender::generateRay, so both
+            // paths pick identical texels)
+            F ex = L::mul(L::mul(L::sub(L::div(L::mul(L::set1(2.0f), pxv), L::set1((float)f.width)), one),
+                                 L::set1(f.tanHalfFovy)), L::set1(f.aspect));
+            F d[3];
+            for(int k = 0; k < 3; k++)
+                d[k] = L::add(L::add(L::mul(L::set1(m[k]), ex), L::set1(m[4 + k] * ey)), L::set1(-m[8 + k]));
+            F len = L::sqrt(L::add(L::add(L::mul(d[0], d[0]), L::mul(d[1], d[1])), L::mul(d[2], d[2])));
+            for(int k = 0; k < 3; k++)
+                d[k] = L::div(d[k], len);
+
+            // IntersectBox on every lane
+            F tnear = L::set1(-1e30f), tfar = L::set1(1e30f);
+            for(int k = 0; k < 3; k++)
+            {
+                F invR = L::div(one, d[k]);
+                F o = L::set1(m[12 + k]);
+                F tbot = L::mul(invR, L::sub(boxMin, o));
+                F ttop = L::mul(invR, L::sub(half, o));
+                tnear = L::max(tnear, L::min(ttop, tbot));
+                tfar = L::min(tfar, L::max(ttop, tbot));
+            }
+            M hit = L::mand(L::mand(L::le(tnear, tfar), L::ge(tfar, zero)), active);
+
+            F c[4] = { zero, zero, zero, zero };
+
+            if( L::any(hit) )
+            {
+                tnear = L::max(tnear, zero);
+                if( f.jitter != 0.0f )
+                    tnear = L::add(tnear, L::set1(f.jitter * stepsize));
+
+                // texture space start point and step, and the direction and
+                // inverse step length in texels for leaping over cells
+                F P0[3], Pstep[3], invStep[3];
+                M forward[3];
+                for(int k = 0; k < 3; k++)
+                {
+                    P0[k] = L::add(L::add(L::set1(m[12 + k]), L::mul(d[k], tnear)), half);
+                    Pstep[k] = L::mul(d[k], L::set1(stepsize));
+
+                    F texelStep = L::mul(Pstep[k], dims[k]);
+                    forward[k] = L::ge(texelStep, zero);
+                    invStep[k] = L::div(one, L::max(texelStep, L::sub(zero, texelStep)));
+                }
+
+                // each lane stops a step after leaving the box, the packet
+                // stops once every lane has
+                F remaining = L::min(L::add(L::div(L::sub(tfar, tnear), L::set1(stepsize)), L::set1(2.0f)),
+                                     L::set1((float)f.steps));
+                float lanes[L::N];
+                L::store(lanes, remaining);
+
+                // lanes start where they come down to the ceiling and stop
+                // where they rise past it, the packet at its first lane
+                int start = 0;
+                if( f.ceiling < f.volWidth )
+                {
+                    float height[L::N], step[L::N], hitLanes[L::N];
+                    L::store(height, P0[0]);
+                    L::store(step, Pstep[0]);
+                    L::store(hitLanes, L::sel(hit, one, zero));
+                    start = f.steps;
+                    for(int l = 0; l < L::N; l++)
+                    {
+                        if( hitLanes[l] == 0.0f )
+                            continue;
+                        int first = 0;
+                        CeilingSamples(height[l], step[l], (float)f.ceiling / f.volWidth, &first, &lanes[l]);
+                        if( first < start ) start = first;
+                    }
+                    remaining = L::load(lanes);
+                }
+
+                int count = 0;
+                for(int l = 0; l < L::N; l++)
+                    if( lanes[l] > count ) count = (int)lanes[l];
+
+                // failed tests wait longer each time in a row, as an
+                // occupied brick tends to have occupied neighbours
+                int recheck = 0, misses = 0;
+                for(int i = start; i < count; i++)
+                {
+                    F fi = L::set1((float)i);
+                    M live = L::mand(hit, L::lt(fi, remaining));
+                    M in = live;
+                    F scaled[3];
+                    I texel[3];
+                    for(int k = 0; k < 3; k++)
+                    {
+                        F P = L::add(P0[k], L::mul(Pstep[k], fi));
+                        scaled[k] = L::mul(P, dims[k]);
+                        texel[k] = L::toInt(scaled[k]);
+                        in = L::mand(in, L::mand(L::ge(P, zero), L::lt(scaled[k], dims[k])));
+                    }
+
+                    bool empty = true;
+                    if( L::any(in) )
+                    {
+                        I index = L::addi(L::muli(L::addi(L::muli(texel[2], sliceLen), texel[1]), rowLen), texel[0]);
+                        I t = L::gather(f.volume, index, in);
+
+                        // masked and transparent lanes gather zero and add nothing
+                        F a;
+                        if( f.opacity != NULL )
+                            a = L::asFloat(L::gather((const unsigned char*)f.opacity, L::shr(t, 24), in));
+                        else
+                            a = L::mul(L::mul(L::channel(t, 24), colorScale), density);
+                        F w = L::mul(L::sub(one, c[3]), a);
+                        F rgb[3] = { L::mul(L::channel(t, 0), colorScale),
+                                     L::mul(L::channel(t, 8), colorScale),
+                                     L::mul(L::channel(t, 16), colorScale) };
+                        if( f.shade != NULL )
+                        {
+                            I cell = L::gather((const unsigned char*)f.shade, index, in);
+                            F shade = L::mul(L::channel(cell, f.shadeShift), colorScale);
+                            for(int k = 0; k < 3; k++)
+                                rgb[k] = L::mul(rgb[k], shade);
+                        }
+                        for(int k = 0; k < 3; k++)
+                            c[k] = L::add(c[k], L::mul(w, rgb[k]));
+                        c[3] = L::add(c[3], w);
+                        empty = !L::any(L::lt(skipAlpha, L::channel(t, 24)));
+
+                        // lanes which are opaque enough stop here
+                        hit = L::mandnot(hit, L::ge(c[3], threshold));
+                        if( !L::any(hit) )
+                            break;
+                    }
+
+                    // every sample was empty, see if the space around them
+                    // is too
+                    if( empty && f.occupancy != NULL && i >= recheck )
+                    {
+                        // lanes which have passed tfar cannot come back
+                        M entering = L::mand(hit, L::lt(L::add(fi, L::set1(2.0f)), remaining));
+                        int wait = 1;
+                        int leap = PacketLeap<L>(f, entering, in, scaled, texel, forward, invStep, count - i, &wait);
+                        if( leap > 0 ) {
+                            i += leap - 1;
+                            misses = 0;
+                        }
+                        else
+                            recheck = i + (wait << (misses < 3 ? misses++ : 3));
+                    }
+                }
+            }
+
+            // brightness, then front and back face blended over black
+            F bright = L::set1(f.brightness);
+            for(int k = 0; k < 3; k++)
+            {
+                F v = L::min(L::mul(c[k], bright), one);
+                F once = L::mul(v, c[3]);
+                L::store(out[k], L::add(once, L::mul(once, L::sub(one, c[3]))));
+            }
+
+            int n = x1 - px < L::N ? x1 - px : L::N;
+            unsigned char *dst = f.rgb + ((size_t)py * f.width + px) * 3;
+            for(int l = 0; l < n; l++)
+                for(int k = 0; k < 3; k++)
+                    dst[l * 3 + k] = (unsigned char)(out[k][l] * 255.0f + 0.5f);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,95 @@
+//
+// 8 lane ray packets using AVX2
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2")
+#endif
+
+#include "CpuRayPacket.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include <immintrin.h>
+
+namespace {
+
+struct LanesAVX2 {
+    enum { N = 8 };
+    typedef __m256 F;
+    typedef __m256 M;
+    typedef __m256i I;
+
+    static F set1(float x) { return _mm256_set1_ps(x); }
+    static F ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+    static float hmin(F a)
+    {
+        __m128 h = _mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        h = _mm_min_ps(h, _mm_movehl_ps(h, h));
+        return _mm_cvtss_f32(_mm_min_ss(h, _mm_shuffle_ps(h, h, 1)));
+    }
+    static float hmax(F a)
+    {
+        __m128 h = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+        return _mm_cvtss_f32(_mm_max_ss(h, _mm_shuffle_ps(h, h, 1)));
+    }
+    static M lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static M ge(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static M mand(M a, M b) { return _mm256_and_ps(a, b); }
+    static M mor(M a, M b) { return _mm256_or_ps(a, b); }
+    static M mandnot(M a, M b) { return _mm256_andnot_ps(b, a); }
+    static F sel(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+    static bool any(M a) { return _mm256_movemask_ps(a) != 0; }
+    static I toInt(F a) { return _mm256_cvttps_epi32(a); }
+    static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+    static F asFloat(I a) { return _mm256_castsi256_ps(a); }
+    static I iset1(int x) { return _mm256_set1_epi32(x); }
+    static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I muli(I a, I b) { return _mm256_mullo_epi32(a, b); }
+    static I shl(I a, int n) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+    static I shr(I a, int n) { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+    static F load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, F a) { _mm256_storeu_ps(p, a); }
+
+    static F channel(I t, int shift)
+    {
+        return _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t, _mm_cvtsi32_si128(shift)), _mm256_set1_epi32(0xff)));
+    }
+
+    static I gather(const unsigned char *volume, I index, M mask)
+    {
+        return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)volume, index,
+                                           _mm256_castps_si256(mask), 4);
+    }
+};
+
+}
+
+void RenderPacketTileAVX2(const RayFrame &frame, int x0, int y0, int x1, int y1)
+{
+    MarchPacketTile<LanesAVX2>(frame, x0, y0, x1, y1);
+}
+
+#else
+
+void RenderPacketTileAVX2(const RayFrame & /*frame*/, int /*x0*/, int /*y0*/, int /*x1*/, int /*y1*/)
+{
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
@@ -0,0 +1,107 @@
+//
+// 16 lane ray packets using AVX-512F
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+// AVX-512F brings FMA along, keep mul + add separate so the result matches
+// the scalar path
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#include "CpuRayPacket.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+namespace {
+
+struct LanesAVX512 {
+    enum { N = 16 };
+    typedef __m512 F;
+    typedef __mmask16 M;
+    typedef __m512i I;
+    static const M ALL = 0xffff;
+
+    static F set1(float x) { return _mm512_set1_ps(x); }
+    static F ramp() { return _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                            8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f); }
+    static F add(F a, F b) { return _mm512_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm512_div_ps(a, b); }
+    // GCC's unmasked forms of these (and the 512 to 128 bit cast) start
+    // from an undefined vector, which it then warns is used uninitialized,
+    // so all lanes are written over a defined one
+    static F min(F a, F b) { return _mm512_mask_min_ps(a, ALL, a, b); }
+    static F max(F a, F b) { return _mm512_mask_max_ps(a, ALL, a, b); }
+    static F sqrt(F a) { return _mm512_mask_sqrt_ps(a, ALL, a); }
+    // halves, then quarters, swapped over each other
+    static float hmin(F a)
+    {
+        a = min(a, _mm512_mask_shuffle_f32x4(a, ALL, a, a, 0x4e));
+        a = min(a, _mm512_mask_shuffle_f32x4(a, ALL, a, a, 0xb1));
+        __m128 q = _mm512_mask_extractf32x4_ps(_mm_setzero_ps(), 0xf, a, 0);
+        q = _mm_min_ps(q, _mm_movehl_ps(q, q));
+        return _mm_cvtss_f32(_mm_min_ss(q, _mm_shuffle_ps(q, q, 1)));
+    }
+    static float hmax(F a)
+    {
+        a = max(a, _mm512_mask_shuffle_f32x4(a, ALL, a, a, 0x4e));
+        a = max(a, _mm512_mask_shuffle_f32x4(a, ALL, a, a, 0xb1));
+        __m128 q = _mm512_mask_extractf32x4_ps(_mm_setzero_ps(), 0xf, a, 0);
+        q = _mm_max_ps(q, _mm_movehl_ps(q, q));
+        return _mm_cvtss_f32(_mm_max_ss(q, _mm_shuffle_ps(q, q, 1)));
+    }
+    static M lt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static M le(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static M ge(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static M mand(M a, M b) { return (M)(a & b); }
+    static M mor(M a, M b) { return (M)(a | b); }
+    static M mandnot(M a, M b) { return (M)(a & ~b); }
+    static F sel(M m, F a, F b) { return _mm512_mask_blend_ps(m, b, a); }
+    static bool any(M a) { return a != 0; }
+    static I toInt(F a) { return _mm512_mask_cvttps_epi32(_mm512_castps_si512(a), ALL, a); }
+    static F toFloat(I a) { return _mm512_mask_cvtepi32_ps(_mm512_castsi512_ps(a), ALL, a); }
+    static F asFloat(I a) { return _mm512_castsi512_ps(a); }
+    static I iset1(int x) { return _mm512_set1_epi32(x); }
+    static I addi(I a, I b) { return _mm512_add_epi32(a, b); }
+    static I muli(I a, I b) { return _mm512_mullo_epi32(a, b); }
+    static I shl(I a, int n) { return _mm512_mask_sll_epi32(a, ALL, a, _mm_cvtsi32_si128(n)); }
+    static I shr(I a, int n) { return _mm512_mask_srl_epi32(a, ALL, a, _mm_cvtsi32_si128(n)); }
+    static F load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, F a) { _mm512_storeu_ps(p, a); }
+
+    static F channel(I t, int shift)
+    {
+        return toFloat(_mm512_and_si512(shr(t, shift), _mm512_set1_epi32(0xff)));
+    }
+
+    static I gather(const unsigned char *volume, I index, M mask)
+    {
+        return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), mask, index, (const int*)volume, 4);
+    }
+};
+
+}
+
+void RenderPacketTileAVX512(const RayFrame &frame, int x0, int y0, int x1, int y1)
+{
+    MarchPacketTile<LanesAVX512>(frame, x0, y0, x1, y1);
+}
+
+#else
+
+void RenderPacketTileAVX512(const RayFrame & /*frame*/, int /*x0*/, int /*y0*/, int /*x1*/, int /*y1*/)
+{
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
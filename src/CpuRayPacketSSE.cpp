@@ -0,0 +1,98 @@
+//
+// 4 lane ray packets using SSE4.1
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("sse4.1")
+#endif
+
+#include "CpuRayPacket.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include <smmintrin.h>
+
+namespace {
+
+struct LanesSSE {
+    enum { N = 4 };
+    typedef __m128 F;
+    typedef __m128 M;
+    typedef __m128i I;
+
+    static F set1(float x) { return _mm_set1_ps(x); }
+    static F ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm_div_ps(a, b); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F sqrt(F a) { return _mm_sqrt_ps(a); }
+    static float hmin(F a)
+    {
+        a = _mm_min_ps(a, _mm_movehl_ps(a, a));
+        return _mm_cvtss_f32(_mm_min_ss(a, _mm_shuffle_ps(a, a, 1)));
+    }
+    static float hmax(F a)
+    {
+        a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+        return _mm_cvtss_f32(_mm_max_ss(a, _mm_shuffle_ps(a, a, 1)));
+    }
+    static M lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static M le(F a, F b) { return _mm_cmple_ps(a, b); }
+    static M ge(F a, F b) { return _mm_cmpge_ps(a, b); }
+    static M mand(M a, M b) { return _mm_and_ps(a, b); }
+    static M mor(M a, M b) { return _mm_or_ps(a, b); }
+    static M mandnot(M a, M b) { return _mm_andnot_ps(b, a); }
+    static F sel(M m, F a, F b) { return _mm_blendv_ps(b, a, m); }
+    static bool any(M a) { return _mm_movemask_ps(a) != 0; }
+    static I toInt(F a) { return _mm_cvttps_epi32(a); }
+    static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+    static F asFloat(I a) { return _mm_castsi128_ps(a); }
+    static I iset1(int x) { return _mm_set1_epi32(x); }
+    static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+    static I muli(I a, I b) { return _mm_mullo_epi32(a, b); }
+    static I shl(I a, int n) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+    static I shr(I a, int n) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+    static F load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, F a) { _mm_storeu_ps(p, a); }
+
+    static F channel(I t, int shift)
+    {
+        return _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(t, _mm_cvtsi32_si128(shift)), _mm_set1_epi32(0xff)));
+    }
+
+    // no hardware gather before AVX2, fetch the active lanes one by one
+    static I gather(const unsigned char *volume, I index, M mask)
+    {
+        int bits = _mm_movemask_ps(mask);
+        const int *texels = (const int*)volume;
+        return _mm_setr_epi32((bits & 1) ? texels[_mm_extract_epi32(index, 0)] : 0,
+                              (bits & 2) ? texels[_mm_extract_epi32(index, 1)] : 0,
+                              (bits & 4) ? texels[_mm_extract_epi32(index, 2)] : 0,
+                              (bits & 8) ? texels[_mm_extract_epi32(index, 3)] : 0);
+    }
+};
+
+}
+
+void RenderPacketTileSSE(const RayFrame &frame, int x0, int y0, int x1, int y1)
+{
+    MarchPacketTile<LanesSSE>(frame, x0, y0, x1, y1);
+}
+
+#else
+
+void RenderPacketTileSSE(const RayFrame & /*frame*/, int /*x0*/, int /*y0*/, int /*x1*/, int /*y1*/)
+{
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
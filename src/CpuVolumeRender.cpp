@@ -0,0 +1,804 @@
+//
+// class to render a 3D volume on the CPU
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+
+#include "CpuVolumeRender.h"
+#include "LodVolume.h"
+#include "ShadeVolume.h"
+#include "TaskPool.h"
+
+// inverts a column major 4x4 matrix, returns false if it is singular
+static bool invertMatrix(const float m[16], float inv[16])
+{
+    float t[16];
+
+    t[0] = m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+    t[4] = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+    t[8] = m[4]*m[9]*m[15] - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+    t[12] = -m[4]*m[9]*m[14] + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+    t[1] = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+    t[5] = m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+    t[9] = -m[0]*m[9]*m[15] + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+    t[13] = m[0]*m[9]*m[14] - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+    t[2] = m[1]*m[6]*m[15] - m[1]*m[7]*m[14] - m[5]*m[2]*m[15] + m[5]*m[3]*m[14] + m[13]*m[2]*m[7] - m[13]*m[3]*m[6];
+    t[6] = -m[0]*m[6]*m[15] + m[0]*m[7]*m[14] + m[4]*m[2]*m[15] - m[4]*m[3]*m[14] - m[12]*m[2]*m[7] + m[12]*m[3]*m[6];
+    t[10] = m[0]*m[5]*m[15] - m[0]*m[7]*m[13] - m[4]*m[1]*m[15] + m[4]*m[3]*m[13] + m[12]*m[1]*m[7] - m[12]*m[3]*m[5];
+    t[14] = -m[0]*m[5]*m[14] + m[0]*m[6]*m[13] + m[4]*m[1]*m[14] - m[4]*m[2]*m[13] - m[12]*m[1]*m[6] + m[12]*m[2]*m[5];
+    t[3] = -m[1]*m[6]*m[11] + m[1]*m[7]*m[10] + m[5]*m[2]*m[11] - m[5]*m[3]*m[10] - m[9]*m[2]*m[7] + m[9]*m[3]*m[6];
+    t[7] = m[0]*m[6]*m[11] - m[0]*m[7]*m[10] - m[4]*m[2]*m[11] + m[4]*m[3]*m[10] + m[8]*m[2]*m[7] - m[8]*m[3]*m[6];
+    t[11] = -m[0]*m[5]*m[11] + m[0]*m[7]*m[9] + m[4]*m[1]*m[11] - m[4]*m[3]*m[9] - m[8]*m[1]*m[7] + m[8]*m[3]*m[5];
+    t[15] = m[0]*m[5]*m[10] - m[0]*m[6]*m[9] - m[4]*m[1]*m[10] + m[4]*m[2]*m[9] + m[8]*m[1]*m[6] - m[8]*m[2]*m[5];
+
+    float det = m[0]*t[0] + m[1]*t[4] + m[2]*t[8] + m[3]*t[12];
+    if( det == 0.0f )
+        return false;
+
+    det = 1.0f / det;
+    for(int i = 0; i < 16; i++)
+        inv[i] = t[i] * det;
+    return true;
+}
+
+void SetExamineCamera(CpuCamera *camera, const float rotation[4], float dolly, const float pan[3])
+{
+    // same expansion as nv::quaternion::get_value(matrix4&)
+    float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+    float norm = x*x + y*y + z*z + w*w;
+    float s = norm == 0.0f ? 0.0f : 2.0f / norm;
+
+    float xs = x * s, ys = y * s, zs = z * s;
+    float wx = w * xs, wy = w * ys, wz = w * zs;
+    float xx = x * xs, xy = x * ys, xz = x * zs;
+    float yy = y * ys, yz = y * zs, zz = z * zs;
+
+    float *m = camera->modelView;
+    m[0] = 1.0f - (yy + zz); m[4] = xy - wz;          m[8] = xz + wy;           m[12] = pan[0];
+    m[1] = xy + wz;          m[5] = 1.0f - (xx + zz); m[9] = yz - wx;           m[13] = pan[1];
+    m[2] = xz - wy;          m[6] = yz + wx;          m[10] = 1.0f - (xx + yy); m[14] = pan[2] + dolly;
+    m[3] = 0.0f;             m[7] = 0.0f;             m[11] = 0.0f;             m[15] = 1.0f;
+
+    camera->fovy = 20.0f;
+}
+
+CpuVolumeRender::CpuVolumeRender(const unsigned char *volume, int width, int height, int depth)
+    : m_volume(volume),
+      m_width(width),
+      m_height(height),
+      m_depth(depth),
+      m_density(0.05f),
+      m_brightness(2.0f),
+      m_steps(120),
+      m_traversal(TRAVERSE_STEPS),
+      m_threshold(1.0f),
+      m_stepDistance(0.0f),
+      m_stepScale(1.0f),
+      m_jitter(0.0f),
+      m_occupancy(NULL),
+      m_skipAlpha(0),
+      m_ceiling(width),
+      m_shade(NULL),
+      m_shadeChannel(0),
+      m_lod(NULL),
+      m_lodDistance(4.0f),
+      m_threads(0),
+      m_tileSize(32),
+      m_packetWidth(0),
+      m_usedPacketWidth(1),
+      m_packetTile(NULL),
+      m_renderTime(0.0),
+      m_tilesX(0),
+      m_tilesY(0),
+      m_usedThreads(0),
+      m_steals(0)
+{
+}
+
+CpuVolumeRender::~CpuVolumeRender()
+{
+}
+
+int
+CpuVolumeRender::getThreadCount()
+{
+    return m_threads > 0 ? m_threads : TaskPool::shared().getThreadCount();
+}
+
+void
+CpuVolumeRender::render(const CpuCamera &camera, unsigned char *rgb, int imageWidth, int imageHeight)
+{
+    renderFrames(&camera, &rgb, 1, imageWidth, imageHeight);
+}
+
+void
+CpuVolumeRender::renderFrames(const CpuCamera *cameras, unsigned char *const *rgb, int count,
+                              int imageWidth, int imageHeight)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // frames whose camera cannot be inverted are left black
+    std::vector<RayFrame> frames;
+    for(int i = 0; i < count; i++)
+    {
+        RayFrame frame;
+        if( setupFrame(cameras[i], rgb[i], imageWidth, imageHeight, frame) )
+            frames.push_back(frame);
+        else
+            memset(rgb[i], 0, (size_t)imageWidth * imageHeight * 3);
+    }
+    if( frames.empty() )
+        return;
+
+    for(int a = 0; a < 256; a++)
+    {
+        float opacity = a * (1.0f / 255.0f) * m_density;
+        m_logTransmit[a] = opacity < 1.0f ? logf(1.0f - opacity) : -1e30f;
+        m_opacity[a] = 1.0f - expf(m_logTransmit[a] * m_stepScale);
+    }
+
+    // voxels, levels of detail and growing steps are only done one ray at
+    // a time
+    if( m_traversal == TRAVERSE_VOXELS || m_lod != NULL || m_stepDistance > 0.0f ) {
+        m_packetTile = NULL;
+        m_usedPacketWidth = 1;
+    }
+    else
+        m_packetTile = GetPacketTileFunc(m_packetWidth > 0 ? m_packetWidth : 16, &m_usedPacketWidth);
+
+    // the tiles of every frame are balanced over the workers of the shared
+    // pool by stealing, timing each one
+    int tiles = frames[0].tilesX * frames[0].tilesY;
+    int tileCount = tiles * (int)frames.size();
+    m_tilesX = frames[0].tilesX;
+    m_tilesY = frames[0].tilesY;
+    m_tileCosts.resize(tileCount);
+    // an image without pixels has no tiles
+    if( tileCount == 0 )
+        return;
+
+    TaskPool &pool = TaskPool::shared();
+    pool.parallelFor(tileCount, [this, &frames, tiles](int task, int /*worker*/) {
+        renderTile(frames[task / tiles], task % tiles);
+    }, m_threads, &m_tileCosts[0]);
+    m_usedThreads = pool.getWorkers();
+    m_steals = pool.getSteals();
+
+    m_renderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// per-frame state of a render, false if the camera cannot be inverted
+bool
+CpuVolumeRender::setupFrame(const CpuCamera &camera, unsigned char *rgb, int imageWidth, int imageHeight,
+                            RayFrame &frame) const
+{
+    if( !invertMatrix(camera.modelView, frame.invModelView) )
+        return false;
+
+    frame.tanHalfFovy = tanf(camera.fovy * 0.5f * 3.14159265f / 180.0f);
+    frame.aspect = (float)imageWidth / imageHeight;
+    frame.width = imageWidth;
+    frame.height = imageHeight;
+    frame.tilesX = (imageWidth + m_tileSize - 1) / m_tileSize;
+    frame.tilesY = (imageHeight + m_tileSize - 1) / m_tileSize;
+    frame.rgb = rgb;
+    frame.volume = m_volume;
+    frame.volWidth = m_width;
+    frame.volHeight = m_height;
+    frame.volDepth = m_depth;
+    frame.density = m_density;
+    frame.brightness = m_brightness;
+    frame.steps = m_steps;
+    frame.threshold = m_threshold;
+    frame.jitter = m_jitter;
+    frame.stepScale = m_stepScale;
+    frame.opacity = m_stepScale > 1.0f ? m_opacity : NULL;
+    frame.occupancy = m_occupancy != NULL ? &m_occupancy->getLevel(0) : NULL;
+    frame.skipAlpha = m_skipAlpha;
+    frame.shade = m_shade != NULL ? m_shade->getCells() : NULL;
+    frame.shadeShift = m_shadeChannel * 8;
+    frame.ceiling = m_ceiling;
+    return true;
+}
+
+void
+CpuVolumeRender::renderTile(const RayFrame &frame, int tile) const
+{
+    int x0 = (tile % frame.tilesX) * m_tileSize;
+    int y0 = (tile / frame.tilesX) * m_tileSize;
+    int x1 = x0 + m_tileSize < frame.width ? x0 + m_tileSize : frame.width;
+    int y1 = y0 + m_tileSize < frame.height ? y0 + m_tileSize : frame.height;
+
+    if( m_packetTile != NULL )
+    {
+        m_packetTile(frame, x0, y0, x1, y1);
+        return;
+    }
+
+    for(int py = y0; py < y1; py++)
+    {
+        unsigned char *out = frame.rgb + ((size_t)py * frame.width + x0) * 3;
+        for(int px = x0; px < x1; px++, out += 3)
+        {
+            Ray ray;
+            generateRay(frame, px + 0.5f, py + 0.5f, ray);
+
+            float c[4];
+            if( m_lod != NULL )
+                marchLod(ray, c);
+            else if( m_traversal == TRAVERSE_VOXELS )
+                marchVoxels(ray, c);
+            else if( m_stepDistance > 0.0f )
+                marchGrowing(ray, c);
+            else
+                marchRay(ray, c);
+
+            // the cube is drawn without culling, so front and back faces
+            // both blend the ray color over the black framebuffer
+            for(int k = 0; k < 3; k++)
+            {
+                float f = c[k] < 1.0f ? c[k] : 1.0f;
+                float v = f * c[3];
+                v = f * c[3] + v * (1.0f - c[3]);
+                out[k] = (unsigned char)(v * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+// ray from the eye through pixel (px,py), in object space
+void
+CpuVolumeRender::generateRay(const RayFrame &frame, float px, float py, Ray &ray) const
+{
+    const float *m = frame.invModelView;
+
+    float ex = (2.0f * px / frame.width - 1.0f) * frame.tanHalfFovy * frame.aspect;
+    float ey = (1.0f - 2.0f * py / frame.height) * frame.tanHalfFovy;
+    float ez = -1.0f;
+
+    ray.o[0] = m[12];
+    ray.o[1] = m[13];
+    ray.o[2] = m[14];
+
+    float d[3];
+    for(int k = 0; k < 3; k++)
+        d[k] = m[k] * ex + m[4 + k] * ey + m[8 + k] * ez;
+
+    float len = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    for(int k = 0; k < 3; k++)
+        ray.d[k] = d[k] / len;
+}
+
+// texel containing texture space point P. False outside the volume, where
+// the GL_CLAMP_TO_BORDER texture in VolumeBuffer is transparent black.
+bool
+CpuVolumeRender::toTexel(const float P[3], float scaled[3], int texel[3]) const
+{
+    if( P[0] < 0.0f || P[1] < 0.0f || P[2] < 0.0f )
+        return false;
+
+    scaled[0] = P[0] * m_width;
+    scaled[1] = P[1] * m_height;
+    scaled[2] = P[2] * m_depth;
+    texel[0] = (int)scaled[0];
+    texel[1] = (int)scaled[1];
+    texel[2] = (int)scaled[2];
+    return scaled[0] < m_width && scaled[1] < m_height && scaled[2] < m_depth;
+}
+
+// nearest texel lookup, as the GL_NEAREST texture in VolumeBuffer. Returns
+// the alpha byte of the texel; s is only set if that is not 0.
+int
+CpuVolumeRender::sample(const int texel[3], float s[4]) const
+{
+    const unsigned char *t = m_volume + (((size_t)texel[2] * m_height + texel[1]) * m_width + texel[0]) * 4;
+    if( t[3] == 0 )
+        return 0;
+
+    s[0] = t[0] * (1.0f / 255.0f);
+    s[1] = t[1] * (1.0f / 255.0f);
+    s[2] = t[2] * (1.0f / 255.0f);
+    s[3] = t[3] * (1.0f / 255.0f);
+
+    if( m_shade != NULL )
+    {
+        unsigned int cell = m_shade->getCells()[((size_t)texel[2] * m_height + texel[1]) * m_width + texel[0]];
+        float shade = ShadeValue(cell, m_shadeChannel) * (1.0f / 255.0f);
+        for(int k = 0; k < 3; k++)
+            s[k] *= shade;
+    }
+    return t[3];
+}
+
+// number of levels of the occupancy grid, finest first, whose cells around
+// texel are all at or below the skip alpha
+int
+CpuVolumeRender::emptyLevels(const int texel[3]) const
+{
+    int l = 0;
+    while( l < OCCUPANCY_LEVELS )
+    {
+        const OccupancyLevel &level = m_occupancy->getLevel(l);
+        int x = texel[0] >> level.shift[0], y = texel[1] >> level.shift[1], z = texel[2] >> level.shift[2];
+        if( OccupancyMax(level.cells[(z * level.dims[1] + y) * level.dims[0] + x]) > m_skipAlpha )
+            break;
+        l++;
+    }
+    return l;
+}
+
+// number of samples the ray can leap over from the sample at texel, the
+// scalar PacketLeap. Walks the cells of the coarsest level that is empty
+// around the sample until the ray enters an occupied one. Returns 0 if the
+// brick is occupied, setting *wait to the samples left in it.
+int
+CpuVolumeRender::leap(const float scaled[3], const int texel[3], const bool forward[3],
+                      const float invStep[3], int limit, int *wait) const
+{
+    // coarsest level whose cell around the sample is empty
+    int l = emptyLevels(texel);
+
+    // samples to the next cell boundary on each axis
+    const OccupancyLevel &level = m_occupancy->getLevel(l > 0 ? l - 1 : 0);
+    int cell[3];
+    float next[3], delta[3];
+    for(int k = 0; k < 3; k++)
+    {
+        float size = (float)(1 << level.shift[k]);
+        cell[k] = texel[k] >> level.shift[k];
+        float lo = cell[k] * size;
+        next[k] = (forward[k] ? lo + size - scaled[k] : scaled[k] - lo) * invStep[k];
+        delta[k] = size * invStep[k];
+    }
+
+    if( l == 0 )
+    {
+        float exit = next[0] < next[1] ? next[0] : next[1];
+        if( next[2] < exit ) exit = next[2];
+        *wait = exit >= 1.0f ? (exit < limit ? (int)exit : limit) : 1;
+        return 0;
+    }
+
+    // walk through empty cells until entering an occupied one or leaving
+    // the volume, past which nothing is left to sample
+    float stop = (float)limit;
+    for(;;)
+    {
+        int k = next[0] <= next[1] && next[0] <= next[2] ? 0 : (next[1] <= next[2] ? 1 : 2);
+        float t = next[k];
+        if( t >= stop )
+            break;
+
+        cell[k] += forward[k] ? 1 : -1;
+        if( cell[k] < 0 || cell[k] >= level.dims[k] )
+            break;
+        if( OccupancyMax(level.cells[(cell[2] * level.dims[1] + cell[1]) * level.dims[0] + cell[0]]) > m_skipAlpha )
+        {
+            stop = t;
+            break;
+        }
+        next[k] += delta[k];
+    }
+
+    return stop >= 1.0f ? (int)stop : 1;
+}
+
+// calculate intersection between ray and box, as IntersectBox
+static bool intersectBounds(const float o[3], const float d[3], const float lo[3], const float hi[3],
+                            float &tnear, float &tfar)
+{
+    float largest_tmin = -1e30f, smallest_tmax = 1e30f;
+    for(int k = 0; k < 3; k++)
+    {
+        float invR = 1.0f / d[k];
+        float tbot = invR * (lo[k] - o[k]);
+        float ttop = invR * (hi[k] - o[k]);
+        float tmin = ttop < tbot ? ttop : tbot;
+        float tmax = ttop > tbot ? ttop : tbot;
+        if( tmin > largest_tmin ) largest_tmin = tmin;
+        if( tmax < smallest_tmax ) smallest_tmax = tmax;
+    }
+
+    tnear = largest_tmin;
+    tfar = smallest_tmax;
+    return largest_tmin <= smallest_tmax;
+}
+
+static bool intersectBox(const float o[3], const float d[3], float &tnear, float &tfar)
+{
+    const float lo[3] = { -0.5f, -0.5f, -0.5f };
+    const float hi[3] = { 0.5f, 0.5f, 0.5f };
+    return intersectBounds(o, d, lo, hi, tnear, tfar);
+}
+
+// front-to-back march of RayMarchFP, c receives premultiplied rgba. Steps
+// scaled by m_stepScale take their opacity from m_opacity.
+void
+CpuVolumeRender::marchRay(const Ray &ray, float c[4]) const
+{
+    c[0] = c[1] = c[2] = c[3] = 0.0f;
+
+    float tnear, tfar;
+    if( !intersectBox(ray.o, ray.d, tnear, tfar) || tfar < 0.0f )
+        return;
+    if( tnear < 0.0f ) tnear = 0.0f;
+
+    float stepsize = 1.41f / m_steps * m_stepScale;
+    if( m_jitter != 0.0f )
+        tnear += m_jitter * stepsize;
+
+    // texture space start point and step, and the direction and inverse
+    // step length in texels for leaping over empty cells
+    float P0[3], Pstep[3], invStep[3];
+    bool forward[3];
+    int dims[3] = { m_width, m_height, m_depth };
+    for(int k = 0; k < 3; k++)
+    {
+        P0[k] = ray.o[k] + ray.d[k] * tnear + 0.5f;
+        Pstep[k] = ray.d[k] * stepsize;
+
+        float texelStep = Pstep[k] * dims[k];
+        forward[k] = texelStep >= 0.0f;
+        invStep[k] = 1.0f / fabsf(texelStep);
+    }
+
+    // stop a step after leaving the box, as the packets do
+    float remaining = (tfar - tnear) / stepsize + 2.0f;
+    // and march only the samples below the ceiling
+    int first = 0;
+    if( m_ceiling < m_width )
+        CeilingSamples(P0[0], Pstep[0], (float)m_ceiling / m_width, &first, &remaining);
+    // failed tests back off, as the packets do
+    int recheck = 0, misses = 0;
+
+    for(int i = first; i < m_steps && i < remaining; i++)
+    {
+        float P[3], scaled[3];
+        int texel[3];
+        for(int k = 0; k < 3; k++)
+            P[k] = P0[k] + Pstep[k] * (float)i;
+        if( !toTexel(P, scaled, texel) )
+            continue;
+
+        float s[4];
+        int alpha = sample(texel, s);
+        if( alpha != 0 )
+        {
+            s[3] = m_stepScale > 1.0f ? m_opacity[alpha] : s[3] * m_density;
+
+            // premultiply alpha and composite under what is in front
+            float w = (1.0f - c[3]) * s[3];
+            c[0] += w * s[0];
+            c[1] += w * s[1];
+            c[2] += w * s[2];
+            c[3] += w;
+            if( c[3] >= m_threshold )
+                break;
+        }
+
+        if( alpha <= m_skipAlpha && m_occupancy != NULL && i >= recheck )
+        {
+            // the sample was empty, see if the space around it is too
+            int wait = 1;
+            int n = leap(scaled, texel, forward, invStep, m_steps - i, &wait);
+            if( n > 0 ) {
+                i += n - 1;
+                misses = 0;
+            }
+            else
+                recheck = i + (wait << (misses < 3 ? misses++ : 3));
+        }
+    }
+
+    c[0] *= m_brightness;
+    c[1] *= m_brightness;
+    c[2] *= m_brightness;
+}
+
+// ray parameter where the ray crosses the texel boundary plane b of axis k
+static inline float planeT(const float o[3], const float invD[3], const int dims[3], int k, int b)
+{
+    return ((float)b / dims[k] - 0.5f - o[k]) * invD[k];
+}
+
+// Amanatides-Woo traversal of the texels along the ray. Each texel is
+// visited once and composited by the length len of the ray inside it. The
+// texel alpha is the opacity of one fixed step, so it becomes
+// 1 - (1 - a)^(len / stepsize), which gives the stepped march's result for
+// a ray crossing evenly lit texels. Texels whose brick was found occupied
+// are not tested again.
+void
+CpuVolumeRender::marchVoxels(const Ray &ray, float c[4]) const
+{
+    c[0] = c[1] = c[2] = c[3] = 0.0f;
+
+    float tnear, tfar;
+    if( !intersectBox(ray.o, ray.d, tnear, tfar) || tfar < 0.0f )
+        return;
+    if( tnear < 0.0f ) tnear = 0.0f;
+
+    float invStepsize = m_steps / 1.41f;
+
+    int dims[3] = { m_width, m_height, m_depth };
+    int texel[3], dir[3];
+    float invD[3], tMax[3];
+    for(int k = 0; k < 3; k++)
+    {
+        float P = (ray.o[k] + ray.d[k] * tnear + 0.5f) * dims[k];
+        texel[k] = (int)floorf(P);
+        if( texel[k] < 0 ) texel[k] = 0;
+        if( texel[k] >= dims[k] ) texel[k] = dims[k] - 1;
+
+        dir[k] = ray.d[k] >= 0.0f ? 1 : -1;
+        invD[k] = ray.d[k] != 0.0f ? 1.0f / ray.d[k] : 0.0f;
+        tMax[k] = ray.d[k] != 0.0f ? planeT(ray.o, invD, dims, k, texel[k] + (dir[k] > 0)) : 1e30f;
+    }
+
+    int occupiedBrick = -1;
+    float t = tnear;
+    while( t < tfar )
+    {
+        int k = tMax[0] <= tMax[1] && tMax[0] <= tMax[2] ? 0 : (tMax[1] <= tMax[2] ? 1 : 2);
+        float tExit = tMax[k] < tfar ? tMax[k] : tfar;
+
+        float s[4];
+        int alpha = sample(texel, s);
+        if( alpha != 0 && tExit > t )
+        {
+            float a = 1.0f - expf(m_logTransmit[alpha] * ((tExit - t) * invStepsize));
+
+            float w = (1.0f - c[3]) * a;
+            c[0] += w * s[0];
+            c[1] += w * s[1];
+            c[2] += w * s[2];
+            c[3] += w;
+            if( c[3] >= m_threshold )
+                break;
+        }
+
+        // coarsest level of the grid that is empty around the texel
+        int l = 0;
+        if( alpha <= m_skipAlpha && m_occupancy != NULL )
+        {
+            const int *shift = m_occupancy->getLevel(OCCUPANCY_BRICK).shift;
+            int brick = ((texel[2] >> shift[2]) << 16) | ((texel[1] >> shift[1]) << 8) | (texel[0] >> shift[0]);
+            if( brick != occupiedBrick )
+            {
+                l = emptyLevels(texel);
+                if( l == 0 )
+                    occupiedBrick = brick;
+            }
+        }
+
+        if( l > 0 )
+        {
+            // continue from the first texel past the empty cell
+            const int *shift = m_occupancy->getLevel(l - 1).shift;
+            float tCell[3];
+            for(int j = 0; j < 3; j++)
+            {
+                int cell = texel[j] >> shift[j];
+                tCell[j] = ray.d[j] != 0.0f ? planeT(ray.o, invD, dims, j, (cell + (dir[j] > 0)) << shift[j]) : 1e30f;
+            }
+            k = tCell[0] <= tCell[1] && tCell[0] <= tCell[2] ? 0 : (tCell[1] <= tCell[2] ? 1 : 2);
+            t = tCell[k];
+            if( t >= tfar )
+                break;
+
+            for(int j = 0; j < 3; j++)
+            {
+                int lo = (texel[j] >> shift[j]) << shift[j];
+                if( j == k )
+                    texel[j] = dir[j] > 0 ? lo + (1 << shift[j]) : lo - 1;
+                else
+                {
+                    // stay within the cell on the other axes
+                    int v = (int)floorf((ray.o[j] + ray.d[j] * t + 0.5f) * dims[j]);
+                    texel[j] = v < lo ? lo : (v >= lo + (1 << shift[j]) ? lo + (1 << shift[j]) - 1 : v);
+                }
+            }
+            if( texel[k] < 0 || texel[k] >= dims[k] )
+                break;
+
+            for(int j = 0; j < 3; j++)
+                tMax[j] = ray.d[j] != 0.0f ? planeT(ray.o, invD, dims, j, texel[j] + (dir[j] > 0)) : 1e30f;
+            continue;
+        }
+
+        t = tExit;
+        texel[k] += dir[k];
+        if( texel[k] < 0 || texel[k] >= dims[k] )
+            break;
+        tMax[k] = planeT(ray.o, invD, dims, k, texel[k] + (dir[k] > 0));
+    }
+
+    c[0] *= m_brightness;
+    c[1] *= m_brightness;
+    c[2] *= m_brightness;
+}
+
+// march with steps growing past m_stepDistance from the eye, where a step
+// is stepsize * t / m_stepDistance long, and scaled by m_stepScale. A
+// sample's alpha is the opacity of one fixed step, so over a step of r fixed
+// steps it becomes 1 - (1 - a)^r.
+void
+CpuVolumeRender::marchGrowing(const Ray &ray, float c[4]) const
+{
+    c[0] = c[1] = c[2] = c[3] = 0.0f;
+
+    float tnear, tfar;
+    if( !intersectBox(ray.o, ray.d, tnear, tfar) || tfar < 0.0f )
+        return;
+    if( tnear < 0.0f ) tnear = 0.0f;
+
+    float stepsize = 1.41f / m_steps;
+
+    int dims[3] = { m_width, m_height, m_depth };
+    bool forward[3];
+    for(int k = 0; k < 3; k++)
+        forward[k] = ray.d[k] >= 0.0f;
+
+    int recheck = 0, misses = 0;
+    float t = tnear + m_jitter * stepsize * m_stepScale;
+    int i = 0;
+
+    // march only below the ceiling, from a step before the ray comes down
+    // to it, leaping there as over empty cells, to a step after it rises
+    // past it
+    if( m_ceiling < m_width )
+    {
+        float h = (float)m_ceiling / m_width - 0.5f;
+        float tc = ray.d[0] != 0.0f ? (h - ray.o[0]) / ray.d[0] : 0.0f;
+        float ratio = m_stepDistance > 0.0f && tc > m_stepDistance ? tc / m_stepDistance : 1.0f;
+        float margin = stepsize * ratio * m_stepScale;
+        if( ray.d[0] < 0.0f )
+        {
+            // rays which stay above it see nothing
+            if( tc - margin > tfar )
+                return;
+            float ratio0 = m_stepDistance > 0.0f && t > m_stepDistance ? t / m_stepDistance : 1.0f;
+            float step = stepsize * ratio0 * m_stepScale;
+            int n = (int)((tc - margin - t) / step);
+            if( n > 0 ) {
+                i = n;
+                t += n * step;
+            }
+        }
+        else if( ray.d[0] > 0.0f )
+        {
+            if( tc + margin < tfar )
+                tfar = tc + margin;
+        }
+        else if( ray.o[0] >= h )
+            return;
+    }
+
+    for( ; i < m_steps && t <= tfar; i++)
+    {
+        float ratio = m_stepDistance > 0.0f && t > m_stepDistance ? t / m_stepDistance : 1.0f;
+        ratio *= m_stepScale;
+        float step = stepsize * ratio;
+
+        float P[3], scaled[3];
+        int texel[3];
+        for(int k = 0; k < 3; k++)
+            P[k] = ray.o[k] + ray.d[k] * t + 0.5f;
+        if( !toTexel(P, scaled, texel) )
+        {
+            t += step;
+            continue;
+        }
+
+        float s[4];
+        int alpha = sample(texel, s);
+        if( alpha != 0 )
+        {
+            float a = 1.0f - expf(m_logTransmit[alpha] * ratio);
+
+            float w = (1.0f - c[3]) * a;
+            c[0] += w * s[0];
+            c[1] += w * s[1];
+            c[2] += w * s[2];
+            c[3] += w;
+            if( c[3] >= m_threshold )
+                break;
+        }
+
+        if( alpha <= m_skipAlpha && m_occupancy != NULL && i >= recheck )
+        {
+            // steps only grow, so leaping by the current one stays inside
+            // the empty cells
+            float invStep[3];
+            for(int k = 0; k < 3; k++)
+                invStep[k] = 1.0f / fabsf(ray.d[k] * step * dims[k]);
+
+            int wait = 1;
+            int n = leap(scaled, texel, forward, invStep, m_steps - i, &wait);
+            if( n > 0 ) {
+                i += n - 1;
+                t += (n - 1) * step;
+                misses = 0;
+            }
+            else
+                recheck = i + (wait << (misses < 3 ? misses++ : 3));
+        }
+
+        t += step;
+    }
+
+    c[0] *= m_brightness;
+    c[1] *= m_brightness;
+    c[2] *= m_brightness;
+}
+
+// march through the levels of m_lod, sampling the finest level which
+// covers the point, or at least level l + 1 from m_lodDistance * 2^l from
+// the eye on. Steps are as long as the texels of the level sampled (times
+// m_stepScale), and opacity is corrected as for growing steps.
+void
+CpuVolumeRender::marchLod(const Ray &ray, float c[4]) const
+{
+    c[0] = c[1] = c[2] = c[3] = 0.0f;
+
+    // the view is centred on the usual volume, and as tall
+    int levels = m_lod->getLevelCount();
+    float half = m_lod->getChunks() / (2.0f * VOLUME_CHUNKS);
+    const float lo[3] = { -0.5f, -half, -half };
+    const float hi[3] = { 0.5f, half, half };
+
+    float tnear, tfar;
+    if( !intersectBounds(ray.o, ray.d, lo, hi, tnear, tfar) || tfar < 0.0f )
+        return;
+    if( tnear < 0.0f ) tnear = 0.0f;
+
+    float stepsize = 1.41f / m_steps;
+
+    float t = tnear + m_jitter * stepsize * m_stepScale;
+    while( t <= tfar )
+    {
+        float P[3];
+        for(int k = 0; k < 3; k++)
+            P[k] = ray.o[k] + ray.d[k] * t + 0.5f;
+
+        // level l reaches 2^l / 2 from the middle of the view
+        float across = fabsf(P[1] - 0.5f) > fabsf(P[2] - 0.5f) ? fabsf(P[1] - 0.5f) : fabsf(P[2] - 0.5f);
+        int l = 0;
+        while( l + 1 < levels && (across >= 0.5f * (1 << l) || (m_lodDistance > 0.0f && t >= m_lodDistance * (1 << l))) )
+            l++;
+
+        float ratio = (float)(1 << l) * m_stepScale;
+
+        const LodLevel &level = m_lod->getLevel(l);
+        float corner = 0.5f - 0.5f * (1 << l);
+        float perUnit = (float)(VOLUME_SIZE >> l);
+        float scaled[3] = { P[0] * perUnit, (P[1] - corner) * perUnit, (P[2] - corner) * perUnit };
+        if( scaled[0] >= 0.0f && scaled[1] >= 0.0f && scaled[2] >= 0.0f &&
+            scaled[0] < level.dims[0] && scaled[1] < level.dims[1] && scaled[2] < level.dims[2] )
+        {
+            const unsigned char *texel = level.texels +
+                ((((size_t)scaled[2]) * level.dims[1] + (int)scaled[1]) * level.dims[0] + (int)scaled[0]) * 4;
+            int alpha = texel[3];
+            if( alpha != 0 )
+            {
+                float a = 1.0f - expf(m_logTransmit[alpha] * ratio);
+
+                float w = (1.0f - c[3]) * a;
+                c[0] += w * texel[0] * (1.0f / 255.0f);
+                c[1] += w * texel[1] * (1.0f / 255.0f);
+                c[2] += w * texel[2] * (1.0f / 255.0f);
+                c[3] += w;
+                if( c[3] >= m_threshold )
+                    break;
+            }
+        }
+
+        t += stepsize * ratio;
+    }
+
+    c[0] *= m_brightness;
+    c[1] *= m_brightness;
+    c[2] *= m_brightness;
+}
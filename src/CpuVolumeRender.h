@@ -0,0 +1,188 @@
+//
+// class to render a 3D volume on the CPU
+//
+// Reproduces RayMarchFP from Shaders/raymarch.cg without GL, Cg or GLUT so
+// that frames can be rendered on headless machines and compared against the
+// viewer. The image is split into tiles which are marched on all cores by
+// the shared TaskPool.
+// Given an OccupancyGrid of the volume, rays leap over empty cells of it.
+// Texel colors may be scaled by a channel of a ShadeVolume. Given a
+// LodVolume, rays march its larger view instead, coarser with distance.
+// Rays either take the shader's fixed steps or visit every texel they cross,
+// and may stop early once opaque or take longer steps far from the eye.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CPU_VOLUME_RENDER_H
+#define _CPU_VOLUME_RENDER_H
+
+#include <vector>
+#include "CpuRayPacket.h"
+
+class LodVolume;
+class ShadeVolume;
+
+// camera equivalent to the viewer's modelview and gluPerspective projection
+struct CpuCamera {
+    float modelView[16];    // column major, as returned by glGetFloatv
+    float fovy;             // vertical field of view in degrees
+};
+
+// sets up the camera of an nv::ExamineManipulator: pan * dolly * rotation,
+// with rotation given as the quaternion (x, y, z, w)
+void SetExamineCamera(CpuCamera *camera, const float rotation[4], float dolly, const float pan[3]);
+
+// class to render a 3D volume on the CPU
+class CpuVolumeRender {
+public:
+    // volume is width*height*depth RGBA texels in GL texture order
+    CpuVolumeRender(const unsigned char *volume, int width, int height, int depth);
+    ~CpuVolumeRender();
+
+    // renders into rgb, imageWidth*imageHeight pixels of three bytes, top row first
+    void render(const CpuCamera &camera, unsigned char *rgb, int imageWidth, int imageHeight);
+    // renders count frames at once, frame i from cameras[i] into rgb[i].
+    // The tiles of all of them share the workers, so short frames do not
+    // leave cores idle.
+    void renderFrames(const CpuCamera *cameras, unsigned char *const *rgb, int count,
+                      int imageWidth, int imageHeight);
+
+    void setVolume(const unsigned char *volume) { m_volume = volume; }
+
+    // TRAVERSE_STEPS samples at the shader's fixed steps. TRAVERSE_VOXELS
+    // visits each texel along the ray once and weights it by the length of
+    // the ray inside it, so thin features are never stepped over.
+    enum Traversal { TRAVERSE_STEPS = 0, TRAVERSE_VOXELS };
+    void setTraversal(Traversal mode) { m_traversal = mode; }
+
+    void setDensity(float x) { m_density = x; }
+    void setBrightness(float x) { m_brightness = x; }
+
+    // rays stop once their opacity reaches x. The default of 1 only stops
+    // rays which nothing more can show through, so the image is unchanged.
+    void setOpacityThreshold(float x) { m_threshold = x; }
+
+    // beyond this distance from the eye steps grow in proportion to the
+    // distance, as the footprint of a pixel does, with each sample's opacity
+    // corrected for its step length. 0 keeps the fixed steps. Rays with
+    // growing steps are marched one at a time, not in packets.
+    void setStepDistance(float x) { m_stepDistance = x; }
+
+    // steps x times longer than the shader's, with opacity corrected as for
+    // growing steps, for coarse previews
+    void setStepScale(float x) { m_stepScale = x > 1.0f ? x : 1.0f; }
+    // rays start x (0 to 1) of a step further in, so that passes with
+    // different offsets can be averaged. Ignored when traversing voxels.
+    void setJitter(float x) { m_jitter = x; }
+
+    // grid of the volume used to skip empty space, NULL to march every sample
+    void setOccupancy(const OccupancyGrid *grid) { m_occupancy = grid; }
+    // cells with no alpha above this are skipped. 0 leaves the image
+    // unchanged, small values also skip nearly transparent blocks.
+    void setSkipAlpha(int x) { m_skipAlpha = x; }
+
+    // no texel at or above height x (along the volume's width) holds
+    // anything, such as the max height of a SurfaceMap of the volume, so
+    // rays start where they come down to it and stop where they rise past
+    // it. The width, the default, marches the whole box. Only fixed steps
+    // use it.
+    void setCeiling(int x) { m_ceiling = x < m_width ? x : m_width; }
+
+    // scales the color of each texel by a ShadeChannel of shade, NULL to
+    // leave colors unshaded
+    void setShading(const ShadeVolume *shade, int channel = 0)
+    {
+        m_shade = shade;
+        m_shadeChannel = channel;
+    }
+
+    // marches the levels of lod instead of the volume, NULL for the volume.
+    // The view of lod is centred where the volume would be. Samples beyond
+    // x from the eye take a coarser level each time the distance doubles,
+    // and always the finest level which covers them; 0 picks levels by
+    // position alone. Marched one ray at a time, without empty space
+    // skipping or shading.
+    void setLod(const LodVolume *lod) { m_lod = lod; }
+    void setLodDistance(float x) { m_lodDistance = x; }
+
+    // number of worker threads of the shared TaskPool, 0 to use every core
+    void setThreads(int n) { m_threads = n; }
+    void setTileSize(int n) { m_tileSize = n > 0 ? n : 1; }
+
+    // lanes per ray packet: 0 for the widest the CPU supports (16 with
+    // AVX-512, 8 with AVX2, 4 with SSE4.1), 1 for one ray at a time
+    void setPacketWidth(int n) { m_packetWidth = n; }
+
+    // wall clock time of the last render in milliseconds
+    double getRenderTime() { return m_renderTime; }
+    int getThreadCount();
+    // threads which worked on the last render, and tiles they stole
+    int getUsedThreads() { return m_usedThreads; }
+    int getSteals() { return m_steals; }
+    // milliseconds each tile of the last render took, row by row from the
+    // top left, tilesX by tilesY of them for each frame in turn
+    const float *getTileCosts(int *tilesX, int *tilesY) const
+    {
+        *tilesX = m_tilesX;
+        *tilesY = m_tilesY;
+        return m_tileCosts.empty() ? NULL : &m_tileCosts[0];
+    }
+    // lanes used by the last render, 1 when traversing voxels, marching
+    // levels of detail or growing or scaled steps
+    int getPacketWidth() { return m_usedPacketWidth; }
+
+private:
+    struct Ray {
+        float o[3];     // origin
+        float d[3];     // normalized direction
+    };
+
+    bool setupFrame(const CpuCamera &camera, unsigned char *rgb, int imageWidth, int imageHeight,
+                    RayFrame &frame) const;
+    void renderTile(const RayFrame &frame, int tile) const;
+    void generateRay(const RayFrame &frame, float px, float py, Ray &ray) const;
+    void marchRay(const Ray &ray, float c[4]) const;
+    void marchVoxels(const Ray &ray, float c[4]) const;
+    void marchGrowing(const Ray &ray, float c[4]) const;
+    void marchLod(const Ray &ray, float c[4]) const;
+    bool toTexel(const float P[3], float scaled[3], int texel[3]) const;
+    int sample(const int texel[3], float s[4]) const;
+    int emptyLevels(const int texel[3]) const;
+    int leap(const float scaled[3], const int texel[3], const bool forward[3],
+             const float invStep[3], int limit, int *wait) const;
+
+    const unsigned char *m_volume;
+    int m_width, m_height, m_depth;
+
+    float m_density, m_brightness;
+    int m_steps;
+    Traversal m_traversal;
+    float m_threshold, m_stepDistance;
+    float m_stepScale, m_jitter;
+    // log of the transmittance of one step through each alpha, for rays
+    // not sampled at the fixed steps, and the opacity of a step scaled by
+    // m_stepScale through each alpha
+    float m_logTransmit[256];
+    float m_opacity[256];
+
+    const OccupancyGrid *m_occupancy;
+    int m_skipAlpha;
+    int m_ceiling;
+
+    const ShadeVolume *m_shade;
+    int m_shadeChannel;
+
+    const LodVolume *m_lod;
+    float m_lodDistance;
+
+    int m_threads;
+    int m_tileSize;
+    int m_packetWidth, m_usedPacketWidth;
+    PacketTileFunc m_packetTile;
+    double m_renderTime;
+    std::vector<float> m_tileCosts;
+    int m_tilesX, m_tilesY;
+    int m_usedThreads, m_steals;
+};
+
+#endif
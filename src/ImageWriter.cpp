@@ -0,0 +1,190 @@
+//
+// writes 8-bit RGB images to PPM or PNG files, and reads them back
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <zlib.h>
+
+#include "ImageWriter.h"
+
+int WritePPM(const char *filename, const unsigned char *rgb, int width, int height)
+{
+    FILE *ptr = fopen(filename, "wb");
+    if( ptr == NULL )
+        return 0;
+
+    fprintf(ptr, "P6\n%d %d\n255\n", width, height);
+    size_t size = (size_t)width * height * 3;
+    int ok = fwrite(rgb, 1, size, ptr) == size;
+    fclose(ptr);
+
+    return ok;
+}
+
+int ReadPPM(const char *filename, unsigned char *rgb, int width, int height)
+{
+    FILE *ptr = fopen(filename, "rb");
+    if( ptr == NULL )
+        return 0;
+
+    int w = 0, h = 0, maxval = 0;
+    size_t size = (size_t)width * height * 3;
+    int ok = fscanf(ptr, "P6 %d %d %d", &w, &h, &maxval) == 3 &&
+             w == width && h == height && maxval == 255 &&
+             fgetc(ptr) != EOF &&
+             fread(rgb, 1, size, ptr) == size;
+    fclose(ptr);
+
+    return ok;
+}
+
+static unsigned int getBigEndian(const unsigned char *p)
+{
+    return (unsigned int)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void putBigEndian(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+// writes a PNG chunk: length, type, data and the crc of type and data
+static bool writeChunk(FILE *ptr, const char *type, const unsigned char *data, unsigned int length)
+{
+    unsigned char buf[4];
+    putBigEndian(buf, length);
+    if( fwrite(buf, 4, 1, ptr) != 1 || fwrite(type, 4, 1, ptr) != 1 )
+        return false;
+    if( length > 0 && fwrite(data, length, 1, ptr) != 1 )
+        return false;
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)type, 4);
+    if( length > 0 )
+        crc = crc32(crc, data, length);
+    putBigEndian(buf, (unsigned int)crc);
+    return fwrite(buf, 4, 1, ptr) == 1;
+}
+
+int WritePNG(const char *filename, const unsigned char *rgb, int width, int height)
+{
+    // every scanline is prefixed with filter type 0 (none)
+    size_t stride = (size_t)width * 3;
+    std::vector<unsigned char> raw((stride + 1) * height);
+    for(int y = 0; y < height; y++)
+    {
+        raw[y * (stride + 1)] = 0;
+        memcpy(&raw[y * (stride + 1) + 1], rgb + y * stride, stride);
+    }
+
+    uLongf packedSize = compressBound((uLong)raw.size());
+    std::vector<unsigned char> packed(packedSize);
+    if( compress2(&packed[0], &packedSize, &raw[0], (uLong)raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK )
+        return 0;
+
+    FILE *ptr = fopen(filename, "wb");
+    if( ptr == NULL )
+        return 0;
+
+    static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+    unsigned char header[13];
+    putBigEndian(header, width);
+    putBigEndian(header + 4, height);
+    header[8] = 8;      // bit depth
+    header[9] = 2;      // color type rgb
+    header[10] = 0;     // deflate
+    header[11] = 0;     // adaptive filtering
+    header[12] = 0;     // no interlace
+
+    bool ok = fwrite(signature, 8, 1, ptr) == 1 &&
+              writeChunk(ptr, "IHDR", header, 13) &&
+              writeChunk(ptr, "IDAT", &packed[0], (unsigned int)packedSize) &&
+              writeChunk(ptr, "IEND", NULL, 0);
+    fclose(ptr);
+
+    return ok ? 1 : 0;
+}
+
+int ReadPNG(const char *filename, unsigned char *rgb, int width, int height)
+{
+    FILE *ptr = fopen(filename, "rb");
+    if( ptr == NULL )
+        return 0;
+
+    static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+    // the header has to match and the image data may be split over
+    // several IDAT chunks
+    unsigned char buf[8];
+    bool header = false, end = false;
+    std::vector<unsigned char> packed;
+    if( fread(buf, 8, 1, ptr) == 1 && memcmp(buf, signature, 8) == 0 )
+    {
+        while( !end && fread(buf, 8, 1, ptr) == 1 )
+        {
+            unsigned int length = getBigEndian(buf);
+            if( length > 0x7fffffff )
+                break;
+
+            std::vector<unsigned char> data(length + 4);
+            if( fread(&data[0], length + 4, 1, ptr) != 1 )
+                break;
+
+            if( memcmp(buf + 4, "IHDR", 4) == 0 ) {
+                header = length == 13 &&
+                         getBigEndian(&data[0]) == (unsigned int)width &&
+                         getBigEndian(&data[4]) == (unsigned int)height &&
+                         data[8] == 8 && data[9] == 2 && data[10] == 0 &&
+                         data[11] == 0 && data[12] == 0;
+                if( !header )
+                    break;
+            }
+            else if( memcmp(buf + 4, "IDAT", 4) == 0 )
+                packed.insert(packed.end(), data.begin(), data.begin() + length);
+            else if( memcmp(buf + 4, "IEND", 4) == 0 )
+                end = true;
+        }
+    }
+    fclose(ptr);
+
+    if( !header || !end || packed.empty() )
+        return 0;
+
+    size_t stride = (size_t)width * 3;
+    std::vector<unsigned char> raw((stride + 1) * height);
+    uLongf rawSize = (uLongf)raw.size();
+    if( uncompress(&raw[0], &rawSize, &packed[0], (uLong)packed.size()) != Z_OK ||
+        rawSize != raw.size() )
+        return 0;
+
+    for(int y = 0; y < height; y++)
+    {
+        if( raw[y * (stride + 1)] != 0 )
+            return 0;
+        memcpy(rgb + y * stride, &raw[y * (stride + 1) + 1], stride);
+    }
+    return 1;
+}
+
+int WriteImage(const char *filename, const unsigned char *rgb, int width, int height)
+{
+    size_t len = strlen(filename);
+    if( len > 4 && strcmp(filename + len - 4, ".png") == 0 )
+        return WritePNG(filename, rgb, width, height);
+    return WritePPM(filename, rgb, width, height);
+}
+
+int ReadImage(const char *filename, unsigned char *rgb, int width, int height)
+{
+    size_t len = strlen(filename);
+    if( len > 4 && strcmp(filename + len - 4, ".png") == 0 )
+        return ReadPNG(filename, rgb, width, height);
+    return ReadPPM(filename, rgb, width, height);
+}
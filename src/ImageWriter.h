@@ -0,0 +1,23 @@
+//
+// writes 8-bit RGB images to PPM or PNG files, and reads them back
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _IMAGE_WRITER_H
+#define _IMAGE_WRITER_H
+
+// rgb holds width*height pixels, three bytes each, top row first.
+// All functions return 1 on success, 0 on error.
+int WritePPM(const char *filename, const unsigned char *rgb, int width, int height);
+int WritePNG(const char *filename, const unsigned char *rgb, int width, int height);
+
+// picks PNG or PPM from the extension of filename (PPM unless ".png")
+int WriteImage(const char *filename, const unsigned char *rgb, int width, int height);
+
+// read images as written above into rgb, failing unless they are exactly
+// width x height. PNGs must be 8-bit RGB without interlacing or filters.
+int ReadPPM(const char *filename, unsigned char *rgb, int width, int height);
+int ReadPNG(const char *filename, unsigned char *rgb, int width, int height);
+int ReadImage(const char *filename, unsigned char *rgb, int width, int height);
+
+#endif
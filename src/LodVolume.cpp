@@ -0,0 +1,164 @@
+//
+// coarser copies of a large view of chunks, for marching far chunks cheaply
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <atomic>
+
+#include "LodVolume.h"
+#include "TaskPool.h"
+
+LodVolume::LodVolume(int levels)
+    : m_levelCount(levels < 1 ? 1 : (levels > MAX_LEVELS ? MAX_LEVELS : levels))
+{
+    int view = VOLUME_CHUNKS << (m_levelCount - 1);
+
+    for(int l = 0; l < m_levelCount; l++)
+    {
+        LodLevel &level = m_levels[l];
+        level.shift = l;
+        level.chunks = VOLUME_CHUNKS << l;
+        level.offset = (view - level.chunks) / 2;
+        level.dims[0] = CHUNK_HEIGHT >> l;
+        level.dims[1] = level.chunks * (CHUNK_SIZE >> l);
+        level.dims[2] = level.chunks * (CHUNK_SIZE >> l);
+
+        size_t bytes = (size_t)level.dims[0] * level.dims[1] * level.dims[2] * 4;
+        level.texels = new unsigned char[bytes];
+        memset(level.texels, 0, bytes);
+    }
+}
+
+LodVolume::~LodVolume()
+{
+    for(int l = 0; l < m_levelCount; l++)
+        delete[] m_levels[l].texels;
+}
+
+int
+LodVolume::load(const char *world, int cx, int cz, const VolumePalette *palette)
+{
+    // every chunk is read and written to its levels as one task of the
+    // shared pool, each worker decoding into its own ChunkData
+    int view = getChunks();
+    TaskPool &pool = TaskPool::shared();
+    std::vector<ChunkData*> chunks(pool.getThreadCount(), (ChunkData*)NULL);
+    std::vector<std::vector<float> > scratch(pool.getThreadCount());
+    std::atomic<int> found(0);
+
+    pool.parallelFor(view * view, [&](int task, int worker) {
+        int i = task / view;
+        int j = task % view;
+        if( chunks[worker] == NULL )
+            chunks[worker] = new ChunkData;
+        ChunkData *chunk = chunks[worker];
+
+        if( !ReadRegionChunk(world, cx + i, cz + j, chunk) )
+            clearChunk(i, j);
+        else
+        {
+            writeChunk(chunk, palette, i, j, scratch[worker]);
+            found++;
+        }
+    });
+
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    return found;
+}
+
+void
+LodVolume::writeChunk(const ChunkData *chunk, const VolumePalette *palette, int i, int j,
+                      std::vector<float> &scratch)
+{
+    // the chunk's texels as they are in the volume, kept alpha weighted for
+    // averaging
+    scratch.resize(CHUNK_BLOCKS * 4);
+    float *sums = &scratch[0];
+    for(int bpos = 0; bpos < CHUNK_BLOCKS; bpos++)
+    {
+        unsigned char texel[4];
+        ChunkTexel(chunk, palette, bpos, texel);
+        sums[bpos * 4 + 0] = (float)texel[0] * texel[3];
+        sums[bpos * 4 + 1] = (float)texel[1] * texel[3];
+        sums[bpos * 4 + 2] = (float)texel[2] * texel[3];
+        sums[bpos * 4 + 3] = (float)texel[3];
+    }
+
+    int height = CHUNK_HEIGHT, size = CHUNK_SIZE;
+    for(int l = 0; l < m_levelCount; l++)
+    {
+        // each level sums 2x2x2 texels of the one before, in place as no
+        // texel is written before it is read
+        if( l > 0 )
+        {
+            int h = height / 2, s = size / 2;
+            for(int x = 0; x < s; x++)
+                for(int z = 0; z < s; z++)
+                    for(int y = 0; y < h; y++)
+                    {
+                        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                        for(int d = 0; d < 8; d++)
+                        {
+                            int src = (y * 2 + (d & 1)) + (z * 2 + ((d >> 1) & 1)) * height +
+                                      (x * 2 + (d >> 2)) * height * size;
+                            for(int k = 0; k < 4; k++)
+                                sum[k] += sums[src * 4 + k];
+                        }
+                        int dst = y + z * h + x * h * s;
+                        for(int k = 0; k < 4; k++)
+                            sums[dst * 4 + k] = sum[k];
+                    }
+            height = h;
+            size = s;
+        }
+
+        const LodLevel &level = m_levels[l];
+        int li = i - level.offset, lj = j - level.offset;
+        if( li < 0 || li >= level.chunks || lj < 0 || lj >= level.chunks )
+            continue;
+
+        float blocks = (float)(1 << (3 * l));
+        for(int x = 0; x < size; x++)
+        {
+            for(int z = 0; z < size; z++)
+            {
+                unsigned char *column = level.texels +
+                    (((size_t)(li * size + x) * level.dims[1] + lj * size + z) * level.dims[0]) * 4;
+                const float *src = sums + (z * height + x * height * size) * 4;
+
+                for(int y = 0; y < height; y++, src += 4)
+                {
+                    unsigned char *texel = column + y * 4;
+                    if( src[3] <= 0.0f ) {
+                        memset(texel, 0, 4);
+                        continue;
+                    }
+                    for(int k = 0; k < 3; k++)
+                        texel[k] = (unsigned char)(src[k] / src[3] + 0.5f);
+                    texel[3] = (unsigned char)(src[3] / blocks + 0.5f);
+                }
+            }
+        }
+    }
+}
+
+void
+LodVolume::clearChunk(int i, int j)
+{
+    for(int l = 0; l < m_levelCount; l++)
+    {
+        const LodLevel &level = m_levels[l];
+        int li = i - level.offset, lj = j - level.offset;
+        if( li < 0 || li >= level.chunks || lj < 0 || lj >= level.chunks )
+            continue;
+
+        int size = CHUNK_SIZE >> l;
+        for(int x = 0; x < size; x++)
+            for(int z = 0; z < size; z++)
+                memset(level.texels + (((size_t)(li * size + x) * level.dims[1] + lj * size + z) * level.dims[0]) * 4,
+                       0, level.dims[0] * 4);
+    }
+}
@@ -0,0 +1,64 @@
+//
+// coarser copies of a large view of chunks, for marching far chunks cheaply
+//
+// A view of 8 << (levels - 1) chunks square is kept as nested levels, each
+// centred on the view. Level l covers the middle 8 << l chunks with texels
+// of 2^l blocks on a side, laid out as the volume (height fastest, then z,
+// then x), so every level is (128 >> l) x 128 x 128 texels. Level 0 is the
+// usual 8x8 chunk volume, and with four levels a 64x64 chunk view takes
+// under twice its memory. Coarse texels are filled as each chunk is
+// decoded: alpha is the mean over the blocks they cover and color the mean
+// weighted by alpha, so air does not wash out the blocks next to it.
+//
+// A renderer samples the finest level covering a point, or a coarser one
+// further from the eye, with steps as long as the texels of that level.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _LOD_VOLUME_H
+#define _LOD_VOLUME_H
+
+#include <vector>
+#include "ChunkReader.h"
+#include "VolumeLoader.h"
+
+// one level. Texel (x,y,z) covers blocks [x << shift, (x+1) << shift) of
+// height etc. and is found at texels[((z * dims[1] + y) * dims[0] + x) * 4].
+// The level starts at chunk (offset,offset) of the view.
+struct LodLevel {
+    int shift;
+    int offset, chunks;
+    int dims[3];
+    unsigned char *texels;
+};
+
+class LodVolume {
+public:
+    // 2x, 4x and 8x coarser levels at most
+    static const int MAX_LEVELS = 4;
+
+    explicit LodVolume(int levels);
+    ~LodVolume();
+
+    // reads and converts the chunks of the view with chunk (cx,cz) at its
+    // NW corner, on the shared pool. Returns the number found; missing
+    // chunks are transparent.
+    int load(const char *world, int cx, int cz, const VolumePalette *palette);
+
+    // writes chunk (i,j) of the view into every level covering it, using
+    // scratch for the alpha weighted colors
+    void writeChunk(const ChunkData *chunk, const VolumePalette *palette, int i, int j,
+                    std::vector<float> &scratch);
+    void clearChunk(int i, int j);
+
+    int getLevelCount() const { return m_levelCount; }
+    const LodLevel &getLevel(int l) const { return m_levels[l]; }
+    // chunks along each side of the view
+    int getChunks() const { return m_levels[m_levelCount - 1].chunks; }
+
+private:
+    int m_levelCount;
+    LodLevel m_levels[MAX_LEVELS];
+};
+
+#endif
@@ -0,0 +1,334 @@
+//
+//  Decription: Renders a flythrough of an 8x8 grid of chunks of a Minecraft
+//  World on the CPU, without a window, GPU, Cg or GLUT. The camera follows a
+//  keyframed path of trackball rotations, dollies and pans (see CameraPath.h)
+//  and each frame is written to a numbered image file. The volume is loaded
+//  once and shared by all frames, which render several at a time.
+//
+//  usage: <MineTrace_batch> <world directory> [<NW chunk X> <NW chunk Z>] -path <file> [options]
+//
+//  Options:
+//      -path <file>         - Camera path, one key per line (required)
+//      -o <pattern>         - Output images, with a %d for the frame number (default frame%04d.png)
+//      -frames <n>          - Frames spread evenly along the path (default one per path frame)
+//      -size <w> <h>        - Image size (default 1024 768)
+//      -density <d>         - Density (default 1.0)
+//      -brightness <b>      - Brightness (default 1.0)
+//      -nonore <a>          - Alpha for non-ore (default 1.0)
+//      -alphalight          - Render with opacity lighting
+//      -threads <n>         - Worker threads (default all cores)
+//      -batch <n>           - Frames rendered at once (default one per thread)
+//      -packet <n>          - Rays per SIMD packet, 1 for scalar (default widest)
+//      -voxels              - Visit every texel along the ray instead of fixed steps
+//      -threshold <a>       - Stop rays once their opacity reaches a (default 1)
+//      -stepdist <d>        - Grow steps beyond distance d from the eye (default 0, off)
+//      -noskip              - March every sample, without empty space skipping
+//      -skipalpha <a>       - Also skip bricks with alpha up to a, 0-255 (default 0)
+//      -shade <channel>     - Shade colors by occlusion, shadow or both (default off)
+//      -lod <levels>        - March a view of 8 << (levels - 1) chunks square, coarser away from the middle (1-4)
+//      -loddist <d>         - Coarsen samples each time the distance from the eye doubles past d (default 4)
+//      -cache <file>        - Read chunks from this cache of the world (see MineTrace_cache) where it is current
+//
+//  Without chunk coordinates the grid starts at the player position.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "CameraPath.h"
+#include "CpuVolumeRender.h"
+#include "ImageWriter.h"
+#include "LodVolume.h"
+#include "OccupancyGrid.h"
+#include "ShadeVolume.h"
+#include "TaskPool.h"
+#include "VolumeLoader.h"
+#include "WorldCache.h"
+#include "blocks.hpp"
+
+void usage()
+{
+    printf( "usage : MineTrace_batch <world directory> [<NW chunk X> <NW chunk Z>] -path <file> [options]\n");
+    printf( "   -path <file>         - Camera path, one key per line\n");
+    printf( "   -o <pattern>         - Output images, with a %%d for the frame number\n");
+    printf( "   -frames <n>          - Frames spread evenly along the path\n");
+    printf( "   -size <w> <h>        - Image size\n");
+    printf( "   -density <d>         - Density\n");
+    printf( "   -brightness <b>      - Brightness\n");
+    printf( "   -nonore <a>          - Alpha for non-ore\n");
+    printf( "   -alphalight          - Render with opacity lighting\n");
+    printf( "   -threads <n>         - Worker threads\n");
+    printf( "   -batch <n>           - Frames rendered at once\n");
+    printf( "   -packet <n>          - Rays per SIMD packet, 1 for scalar\n");
+    printf( "   -voxels              - Visit every texel along the ray instead of fixed steps\n");
+    printf( "   -threshold <a>       - Stop rays once their opacity reaches a\n");
+    printf( "   -stepdist <d>        - Grow steps beyond distance d from the eye\n");
+    printf( "   -noskip              - March every sample, without empty space skipping\n");
+    printf( "   -skipalpha <a>       - Also skip bricks with alpha up to a, 0-255\n");
+    printf( "   -shade <channel>     - Shade colors by occlusion, shadow or both\n");
+    printf( "   -lod <levels>        - March a view of 8 << (levels - 1) chunks square, coarser away from the middle (1-4)\n");
+    printf( "   -loddist <d>         - Coarsen samples each time the distance from the eye doubles past d\n");
+    printf( "   -cache <file>        - Read chunks from this cache of the world (see MineTrace_cache) where it is current\n");
+}
+
+// true if pattern has exactly one conversion, an integer one such as %d or
+// %04d, so it is safe to pass to snprintf with the frame number
+bool ValidPattern(const char *pattern)
+{
+    int conversions = 0;
+    for(const char *p = pattern; *p; p++)
+    {
+        if( *p != '%' )
+            continue;
+        if( p[1] == '%' ) {
+            p++;
+            continue;
+        }
+
+        p++;
+        while( *p >= '0' && *p <= '9' )
+            p++;
+        if( *p != 'd' )
+            return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+int main(int argc, char** argv)
+{
+    if( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+
+    const char *world = argv[1];
+    const char *pathFile = NULL;
+    const char *cacheFile = NULL;
+    const char *output = "frame%04d.png";
+    int cx = 0, cz = 0;
+    bool useSpawn = true;
+    int width = 1024, height = 768;
+    int frames = 0, batch = 0;
+    float density = 1.0f, brightness = 1.0f, nonOreAlpha = 1.0f;
+    bool alphaLight = false;
+    int threads = 0, packet = 0;
+    bool skip = true, voxels = false;
+    int skipAlpha = 0;
+    int shadeChannel = -1;
+    int lodLevels = 0;
+    float lodDistance = 4.0f;
+    float threshold = 1.0f, stepDistance = 0.0f;
+
+    int a = 2;
+    if( argc > 3 && argv[2][0] != '-' )
+    {
+        cx = atoi(argv[2]);
+        cz = atoi(argv[3]);
+        useSpawn = false;
+        a = 4;
+    }
+
+    for( ; a < argc; a++)
+    {
+        int left = argc - a - 1;
+        if( strcmp(argv[a], "-path") == 0 && left >= 1 )
+            pathFile = argv[++a];
+        else if( strcmp(argv[a], "-o") == 0 && left >= 1 )
+            output = argv[++a];
+        else if( strcmp(argv[a], "-frames") == 0 && left >= 1 )
+            frames = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-size") == 0 && left >= 2 ) {
+            width = atoi(argv[++a]);
+            height = atoi(argv[++a]);
+        }
+        else if( strcmp(argv[a], "-density") == 0 && left >= 1 )
+            density = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-brightness") == 0 && left >= 1 )
+            brightness = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-nonore") == 0 && left >= 1 )
+            nonOreAlpha = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-alphalight") == 0 )
+            alphaLight = true;
+        else if( strcmp(argv[a], "-threads") == 0 && left >= 1 )
+            threads = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-batch") == 0 && left >= 1 )
+            batch = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-packet") == 0 && left >= 1 )
+            packet = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-voxels") == 0 )
+            voxels = true;
+        else if( strcmp(argv[a], "-threshold") == 0 && left >= 1 )
+            threshold = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-stepdist") == 0 && left >= 1 )
+            stepDistance = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-noskip") == 0 )
+            skip = false;
+        else if( strcmp(argv[a], "-skipalpha") == 0 && left >= 1 )
+            skipAlpha = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-lod") == 0 && left >= 1 )
+            lodLevels = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-loddist") == 0 && left >= 1 )
+            lodDistance = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-cache") == 0 && left >= 1 )
+            cacheFile = argv[++a];
+        else if( strcmp(argv[a], "-shade") == 0 && left >= 1 ) {
+            shadeChannel = FindShadeChannel(argv[++a]);
+            if( shadeChannel < 0 ) {
+                printf("Unknown shade channel %s\n", argv[a]);
+                return 1;
+            }
+        }
+        else {
+            printf("Unknown option %s\n", argv[a]);
+            usage();
+            return 1;
+        }
+    }
+
+    if( pathFile == NULL || width <= 0 || height <= 0 || frames < 0 || batch < 0 ||
+        lodLevels < 0 || lodLevels > LodVolume::MAX_LEVELS || (lodLevels > 0 && shadeChannel >= 0) )
+    {
+        usage();
+        return 1;
+    }
+    if( !ValidPattern(output) )
+    {
+        printf("Output pattern %s needs one %%d for the frame number\n", output);
+        return 1;
+    }
+
+    std::vector<CameraKey> keys;
+    if( !LoadCameraPath(pathFile, &keys) )
+        return 1;
+
+    // by default one image per frame of the path, otherwise frames images
+    // spread evenly from the first key to the last
+    float first = keys.front().frame, last = keys.back().frame;
+    if( frames == 0 )
+        frames = (int)(last - first) + 1;
+    float frameStep = frames > 1 ? (last - first) / (frames - 1) : 0.0f;
+
+    if( useSpawn && !ReadPlayerChunk(world, &cx, &cz) )
+    {
+        printf("Cannot read player position from %s/level.dat\n", world);
+        return 1;
+    }
+
+    // loading, rendering and writing share the pool
+    TaskPool &pool = TaskPool::shared();
+    if( threads > 0 )
+        pool.reserve(threads);
+    if( batch == 0 )
+        batch = threads > 0 ? threads : pool.getThreadCount();
+
+    WorldCache cache;
+    if( cacheFile != NULL )
+    {
+        if( cache.open(cacheFile, world) )
+            SetChunkCache(&cache);
+        else
+            printf("Cannot read %s, reading the region files\n", cacheFile);
+    }
+
+    mc::initialize_constants();
+
+    VolumePalette palette;
+    InitPalette(&palette, nonOreAlpha, alphaLight);
+
+    std::vector<unsigned char> vData;
+    OccupancyGrid occupancy(VOLUME_SIZE, VOLUME_SIZE, VOLUME_SIZE);
+    ShadeVolume shade(VOLUME_SIZE, VOLUME_SIZE, VOLUME_SIZE);
+    LodVolume *lod = NULL;
+    if( lodLevels > 0 )
+    {
+        // the middle 8x8 chunks of the view are the ones the volume holds
+        lod = new LodVolume(lodLevels);
+        int offset = lod->getLevel(0).offset;
+        int found = lod->load(world, cx - offset, cz - offset, &palette);
+        printf("Loaded %d of %dx%d chunks around (%d,%d)\n", found, lod->getChunks(), lod->getChunks(), cx, cz);
+    }
+    else
+    {
+        vData.resize(VOLUME_SIZE * VOLUME_SIZE * VOLUME_SIZE * 4);
+        int found = LoadVolume(&vData[0], world, cx, cz, &palette, VOLUME_CHUNKS, VOLUME_CHUNKS,
+                               0, 0, 0, 0, &occupancy, NULL, shadeChannel >= 0 ? &shade : NULL);
+        printf("Loaded %d chunks at (%d,%d)\n", found, cx, cz);
+    }
+    if( cache.isOpen() )
+        printf("Read %d chunks from the cache, %d not in it or changed\n", cache.getHits(), cache.getMisses());
+
+    CpuVolumeRender renderer(lod != NULL ? lod->getLevel(0).texels : &vData[0], VOLUME_SIZE, VOLUME_SIZE, VOLUME_SIZE);
+    renderer.setDensity(density);
+    renderer.setBrightness(brightness);
+    renderer.setThreads(threads);
+    renderer.setPacketWidth(packet);
+    if( skip )
+        renderer.setOccupancy(&occupancy);
+    renderer.setSkipAlpha(skipAlpha);
+    if( shadeChannel >= 0 )
+        renderer.setShading(&shade, shadeChannel);
+    renderer.setLod(lod);
+    renderer.setLodDistance(lodDistance);
+    renderer.setOpacityThreshold(threshold);
+    renderer.setStepDistance(stepDistance);
+    if( voxels )
+        renderer.setTraversal(CpuVolumeRender::TRAVERSE_VOXELS);
+
+    size_t bytes = (size_t)width * height * 3;
+    std::vector<unsigned char> images(bytes * batch);
+    std::vector<unsigned char*> rgb(batch);
+    std::vector<CpuCamera> cameras(batch);
+    for(int b = 0; b < batch; b++)
+        rgb[b] = &images[bytes * b];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int failed = 0;
+    for(int f0 = 0; f0 < frames; f0 += batch)
+    {
+        int count = frames - f0 < batch ? frames - f0 : batch;
+        for(int b = 0; b < count; b++)
+        {
+            CameraKey key;
+            SampleCameraPath(keys, first + (f0 + b) * frameStep, &key);
+            SetExamineCamera(&cameras[b], key.rotation, key.dolly, key.pan);
+        }
+
+        renderer.renderFrames(&cameras[0], &rgb[0], count, width, height);
+
+        // compressing the images takes a while too, so they are written in
+        // parallel as well
+        std::vector<int> written(count, 0);
+        pool.parallelFor(count, [&](int b, int /*worker*/) {
+            char filename[1024];
+            snprintf(filename, sizeof(filename), output, f0 + b);
+            written[b] = WriteImage(filename, rgb[b], width, height);
+        }, threads);
+
+        for(int b = 0; b < count; b++)
+        {
+            if( !written[b] ) {
+                char filename[1024];
+                snprintf(filename, sizeof(filename), output, f0 + b);
+                printf("Cannot write %s\n", filename);
+                failed++;
+            }
+        }
+
+        printf("Frames %d-%d of %d rendered in %.2f ms\n", f0, f0 + count - 1, frames, renderer.getRenderTime());
+    }
+
+    double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Rendered %d %dx%d frames in %.2f s (%.2f ms per frame, %d threads, %d lane packets)\n",
+           frames, width, height, total / 1000.0, total / frames, renderer.getThreadCount(), renderer.getPacketWidth());
+
+    delete lod;
+    mc::deinitialize_constants();
+
+    return failed == 0 ? 0 : 1;
+}
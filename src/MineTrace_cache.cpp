@@ -0,0 +1,150 @@
+//
+//  Decription: Keeps a cache of the decoded chunks of a Minecraft World beside
+//  it (see WorldCache.h), so the viewer and the headless and batch renderers
+//  load chunks from memory-mapped bricks instead of inflating and parsing
+//  each one from the region files. Each run brings the cache up to date,
+//  decoding only the chunks whose timestamps changed, so it can be run from
+//  a scheduled job after every backup or save.
+//
+//  usage: <MineTrace_cache> <world directory> [options]
+//
+//  Options:
+//      -o <file>            - Cache file (default <world directory>/chunks.cache)
+//      -threads <n>         - Worker threads (default all cores)
+//      -verify              - Read every chunk from both the cache and the region files and compare them
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "TaskPool.h"
+#include "WorldCache.h"
+
+void usage()
+{
+    printf( "usage : MineTrace_cache <world directory> [options]\n");
+    printf( "   -o <file>            - Cache file\n");
+    printf( "   -threads <n>         - Worker threads\n");
+    printf( "   -verify              - Read every chunk from both the cache and the region files and compare them\n");
+}
+
+// reads every chunk of the world both ways, returning the number that differ
+int Verify(const WorldCache &cache, const char *world, int threads, int *compared)
+{
+    std::vector<RegionCoord> regions;
+    ListRegions(world, &regions);
+
+    std::vector<ChunkCoord> coords;
+    std::vector<unsigned int> stamps(REGION_CHUNKS * REGION_CHUNKS);
+    for(size_t r = 0; r < regions.size(); r++)
+    {
+        if( !ReadRegionTimestamps(world, regions[r], &stamps[0]) )
+            continue;
+        for(int c = 0; c < REGION_CHUNKS * REGION_CHUNKS; c++)
+        {
+            if( stamps[c] == 0 )
+                continue;
+            ChunkCoord coord = { regions[r].x * REGION_CHUNKS + c % REGION_CHUNKS,
+                                 regions[r].z * REGION_CHUNKS + c / REGION_CHUNKS };
+            coords.push_back(coord);
+        }
+    }
+
+    TaskPool &pool = TaskPool::shared();
+    int workers = threads > 0 ? threads : pool.getThreadCount();
+    std::vector<ChunkData*> chunks(workers * 2, (ChunkData*)NULL);
+    std::atomic<int> differ(0);
+
+    pool.parallelFor((int)coords.size(), [&](int task, int worker) {
+        if( chunks[worker * 2] == NULL ) {
+            chunks[worker * 2] = new ChunkData;
+            chunks[worker * 2 + 1] = new ChunkData;
+        }
+        ChunkData *a = chunks[worker * 2], *b = chunks[worker * 2 + 1];
+        int cx = coords[task].x, cz = coords[task].z;
+
+        int inCache = cache.readChunk(world, cx, cz, a);
+        int inRegion = ReadRegionChunk(world, cx, cz, b);
+        bool same = inCache == inRegion;
+        if( same && inCache )
+        {
+            same = memcmp(a->blocks, b->blocks, CHUNK_BLOCKS) == 0 &&
+                   memcmp(a->skyLight, b->skyLight, CHUNK_BLOCKS / 2) == 0 &&
+                   memcmp(a->blockLight, b->blockLight, CHUNK_BLOCKS / 2) == 0 &&
+                   a->hasHeightMap == b->hasHeightMap &&
+                   (!a->hasHeightMap || memcmp(a->heightMap, b->heightMap, CHUNK_SIZE * CHUNK_SIZE) == 0);
+        }
+        if( !same ) {
+            printf("Chunk (%d,%d) differs\n", cx, cz);
+            differ++;
+        }
+    }, threads);
+
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    *compared = (int)coords.size();
+    return differ;
+}
+
+int main(int argc, char** argv)
+{
+    if( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+
+    const char *world = argv[1];
+    std::string output = std::string(world) + "/chunks.cache";
+    int threads = 0;
+    bool verify = false;
+
+    for(int a = 2; a < argc; a++)
+    {
+        int left = argc - a - 1;
+        if( strcmp(argv[a], "-o") == 0 && left >= 1 )
+            output = argv[++a];
+        else if( strcmp(argv[a], "-threads") == 0 && left >= 1 )
+            threads = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-verify") == 0 )
+            verify = true;
+        else {
+            printf("Unknown option %s\n", argv[a]);
+            usage();
+            return 1;
+        }
+    }
+
+    if( threads > 0 )
+        TaskPool::shared().reserve(threads);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    WorldCache cache;
+    cache.open(output.c_str(), world);
+    int decoded = cache.update(world, output.c_str(), threads);
+    if( decoded < 0 )
+    {
+        printf("Cannot read the region directory of %s or write %s\n", world, output.c_str());
+        return 1;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Cached %d chunks in %.2f s, %d of them decoded again\n", cache.getChunkCount(), ms / 1000.0, decoded);
+
+    if( verify )
+    {
+        int compared = 0;
+        int differ = Verify(cache, world, threads, &compared);
+        printf("Compared %d chunks, %d differ\n", compared, differ);
+        if( differ > 0 )
+            return 1;
+    }
+
+    return 0;
+}
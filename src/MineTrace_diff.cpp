@@ -0,0 +1,193 @@
+//
+//  Decription: Compares two copies of a Minecraft World, such as last night's
+//  backup and the world now, and lists the blocks and chunks that changed
+//  (see WorldDiff.h). Regions are compared one after another, those whose
+//  chunk timestamps all match skipped from their headers alone, and only
+//  chunks whose compressed data differ are decompressed, on the worker
+//  threads, so even large worlds compare in little time and memory.
+//
+//  usage: <MineTrace_diff> <before world directory> <after world directory> [options]
+//
+//  Options:
+//      -o <file>            - Changed blocks as CSV (default none)
+//      -chunks <file>       - Changed chunks as CSV (default none)
+//      -mask <file>         - Changed chunks as an image, one pixel per chunk, .png or .ppm
+//      -threads <n>         - Worker threads (default all cores)
+//
+//  Blocks are written as rows of x,y,z,before,after with the block ids in
+//  each world, and chunks as rows of x,z,change,blocks, change being one of
+//  changed, added or removed. The mask is black for unchanged chunks, dark
+//  grey for chunks in neither world, yellow for changed ones, green for
+//  added ones and red for removed ones, with north up.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "ImageWriter.h"
+#include "TaskPool.h"
+#include "WorldDiff.h"
+
+const char *ChangeNames[] = { "same", "changed", "added", "removed" };
+
+void usage()
+{
+    printf( "usage : MineTrace_diff <before world directory> <after world directory> [options]\n");
+    printf( "   -o <file>            - Changed blocks as CSV\n");
+    printf( "   -chunks <file>       - Changed chunks as CSV\n");
+    printf( "   -mask <file>         - Changed chunks as an image, one pixel per chunk, .png or .ppm\n");
+    printf( "   -threads <n>         - Worker threads\n");
+}
+
+// draws the chunks of the regions, with the changed ones colored
+int WriteMask(const char *path, const std::vector<RegionCoord> &regions, const std::vector<ChunkDiff> &chunks)
+{
+    int lo[2] = { regions[0].x, regions[0].z }, hi[2] = { regions[0].x, regions[0].z };
+    for(size_t r = 1; r < regions.size(); r++)
+    {
+        lo[0] = std::min(lo[0], regions[r].x);
+        lo[1] = std::min(lo[1], regions[r].z);
+        hi[0] = std::max(hi[0], regions[r].x);
+        hi[1] = std::max(hi[1], regions[r].z);
+    }
+
+    // regions in neither world stay grey
+    int width = (hi[0] - lo[0] + 1) * REGION_CHUNKS;
+    int height = (hi[1] - lo[1] + 1) * REGION_CHUNKS;
+    std::vector<unsigned char> rgb((size_t)width * height * 3, 48);
+    for(size_t r = 0; r < regions.size(); r++)
+    {
+        for(int z = 0; z < REGION_CHUNKS; z++)
+        {
+            int row = (regions[r].z - lo[1]) * REGION_CHUNKS + z;
+            int column = (regions[r].x - lo[0]) * REGION_CHUNKS;
+            memset(&rgb[((size_t)row * width + column) * 3], 0, REGION_CHUNKS * 3);
+        }
+    }
+
+    const unsigned char colors[][3] = { { 0, 0, 0 }, { 255, 220, 0 }, { 0, 220, 0 }, { 220, 0, 0 } };
+    for(size_t c = 0; c < chunks.size(); c++)
+    {
+        int x = chunks[c].x - lo[0] * REGION_CHUNKS;
+        int z = chunks[c].z - lo[1] * REGION_CHUNKS;
+        memcpy(&rgb[((size_t)z * width + x) * 3], colors[chunks[c].change], 3);
+    }
+
+    return WriteImage(path, &rgb[0], width, height);
+}
+
+int main(int argc, char** argv)
+{
+    if( argc < 3 )
+    {
+        usage();
+        return 1;
+    }
+
+    const char *before = argv[1];
+    const char *after = argv[2];
+    const char *blockFile = NULL;
+    const char *chunkFile = NULL;
+    const char *maskFile = NULL;
+    int threads = 0;
+
+    for(int a = 3; a < argc; a++)
+    {
+        int left = argc - a - 1;
+        if( strcmp(argv[a], "-o") == 0 && left >= 1 )
+            blockFile = argv[++a];
+        else if( strcmp(argv[a], "-chunks") == 0 && left >= 1 )
+            chunkFile = argv[++a];
+        else if( strcmp(argv[a], "-mask") == 0 && left >= 1 )
+            maskFile = argv[++a];
+        else if( strcmp(argv[a], "-threads") == 0 && left >= 1 )
+            threads = atoi(argv[++a]);
+        else {
+            printf("Unknown option %s\n", argv[a]);
+            usage();
+            return 1;
+        }
+    }
+
+    if( threads > 0 )
+        TaskPool::shared().reserve(threads);
+
+    WorldDiff diff(before, after);
+    diff.setThreads(threads);
+
+    std::vector<RegionCoord> regions;
+    if( !diff.listRegions(&regions) || regions.empty() )
+    {
+        printf("Cannot read the region directories of %s and %s\n", before, after);
+        return 1;
+    }
+
+    FILE *blocksOut = NULL;
+    if( blockFile != NULL )
+    {
+        blocksOut = fopen(blockFile, "w");
+        if( blocksOut == NULL ) {
+            printf("Cannot write %s\n", blockFile);
+            return 1;
+        }
+        fprintf(blocksOut, "x,y,z,before,after\n");
+    }
+
+    // the blocks of each region are written before the next is compared,
+    // so only the changed chunks are kept for the whole world
+    std::vector<ChunkDiff> chunks;
+    std::vector<BlockChange> blocks;
+    for(size_t r = 0; r < regions.size(); r++)
+    {
+        blocks.clear();
+        diff.diffRegion(regions[r], &chunks, blocksOut != NULL ? &blocks : NULL);
+        for(size_t b = 0; b < blocks.size(); b++)
+            fprintf(blocksOut, "%d,%d,%d,%d,%d\n", blocks[b].x, blocks[b].y, blocks[b].z, blocks[b].before, blocks[b].after);
+    }
+
+    int ok = 1;
+    if( blocksOut != NULL )
+    {
+        ok = ferror(blocksOut) == 0;
+        if( fclose(blocksOut) != 0 || !ok ) {
+            printf("Cannot write %s\n", blockFile);
+            ok = 0;
+        }
+    }
+
+    if( chunkFile != NULL )
+    {
+        FILE *f = fopen(chunkFile, "w");
+        bool written = f != NULL;
+        if( written )
+        {
+            fprintf(f, "x,z,change,blocks\n");
+            for(size_t c = 0; c < chunks.size(); c++)
+                fprintf(f, "%d,%d,%s,%d\n", chunks[c].x, chunks[c].z, ChangeNames[chunks[c].change], chunks[c].blocks);
+            written = ferror(f) == 0;
+            written = fclose(f) == 0 && written;
+        }
+        if( !written ) {
+            printf("Cannot write %s\n", chunkFile);
+            ok = 0;
+        }
+    }
+
+    if( maskFile != NULL && !WriteMask(maskFile, regions, chunks) )
+    {
+        printf("Cannot write %s\n", maskFile);
+        ok = 0;
+    }
+
+    const WorldDiffStats &stats = diff.getStats();
+    printf("Compared %d regions in %.2f s, %d of them skipped by their headers\n", stats.regions,
+           stats.ms / 1000.0, stats.regionsSkipped);
+    printf("%d chunks read, %d decompressed, %d changed with %lld blocks\n", stats.chunksRead,
+           stats.chunksDecoded, stats.chunksChanged, stats.blocks);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,557 @@
+//
+//  Decription: Renders an 8x8 grid of chunks of a Minecraft World to an image
+//  file on the CPU, without a window, GPU, Cg or GLUT. Produces the same image
+//  as the viewer for the same camera, density and brightness, so it can also
+//  be used as the reference for image-diff and performance tests.
+//
+//  usage: <MineTrace_headless> <world directory> [<NW chunk X> <NW chunk Z>] [options]
+//
+//  Options:
+//      -o <file>            - Output image, .png or .ppm (default minetrace.png)
+//      -size <w> <h>        - Image size (default 1024 768)
+//      -density <d>         - Density (default 1.0)
+//      -brightness <b>      - Brightness (default 1.0)
+//      -nonore <a>          - Alpha for non-ore (default 1.0)
+//      -alphalight          - Render with opacity lighting
+//      -rotation <x y z w>  - Trackball rotation quaternion (default 0 1 0 0)
+//      -dolly <d>           - Dolly distance (default -4.0)
+//      -pan <x y z>         - Pan offset (default 0 0 0)
+//      -threads <n>         - Worker threads (default all cores)
+//      -tile <n>            - Tile size in pixels (default 32)
+//      -packet <n>          - Rays per SIMD packet, 1 for scalar (default widest)
+//      -voxels              - Visit every texel along the ray instead of fixed steps
+//      -threshold <a>       - Stop rays once their opacity reaches a (default 1)
+//      -stepdist <d>        - Grow steps beyond distance d from the eye (default 0, off)
+//      -noskip              - March every sample, without empty space skipping
+//      -skipalpha <a>       - Also skip bricks with alpha up to a, 0-255 (default 0)
+//      -shade <channel>     - Shade colors by occlusion, shadow or both (default off)
+//      -lod <levels>        - March a view of 8 << (levels - 1) chunks square, coarser away from the middle (1-4)
+//      -loddist <d>         - Coarsen samples each time the distance from the eye doubles past d (default 4)
+//      -passes <n>          - Average n passes with offset samples (default 1)
+//      -preview <s>         - Render the coarse frame of a moving camera, at 1/s size
+//      -ores                - Draw only the ores, as splats, instead of marching the volume
+//      -index <file>        - With -ores, skip the chunks without ores by a block index, made or updated first
+//      -caves               - Draw only the caves and enclosed air, instead of the terrain
+//      -diff <world>        - Highlight the blocks changed since this copy of the world, such as a backup
+//      -cache <file>        - Read chunks from this cache of the world (see MineTrace_cache) where it is current
+//      -slice <axis> <n>    - Write slice n at a height (y) or along z or x, one pixel per block
+//      -plane <o> <u> <v> <w> <h> - Write the plane through texel o spanned by u and v, 3 floats each
+//      -repeat <n>          - Render n times and report the average time
+//      -tilecost <file>     - Write the milliseconds each tile took as CSV
+//      -target <ms>         - Lower the quality of each frame to hold ms per frame (default 0, off)
+//      -governorlog <file>  - Write each quality change of -target as CSV
+//
+//  Without chunk coordinates the grid starts at the player position.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "BlockIndex.h"
+#include "CaveVolume.h"
+#include "CpuOreRender.h"
+#include "CpuVolumeRender.h"
+#include "ImageWriter.h"
+#include "LodVolume.h"
+#include "OccupancyGrid.h"
+#include "OreCloud.h"
+#include "ProgressiveRender.h"
+#include "QualityGovernor.h"
+#include "ShadeVolume.h"
+#include "SurfaceMap.h"
+#include "TaskPool.h"
+#include "VolumeLoader.h"
+#include "VolumeSlicer.h"
+#include "WorldCache.h"
+#include "WorldDiff.h"
+#include "blocks.hpp"
+
+void usage()
+{
+    printf( "usage : MineTrace_headless <world directory> [<NW chunk X> <NW chunk Z>] [options]\n");
+    printf( "   -o <file>            - Output image, .png or .ppm\n");
+    printf( "   -size <w> <h>        - Image size\n");
+    printf( "   -density <d>         - Density\n");
+    printf( "   -brightness <b>      - Brightness\n");
+    printf( "   -nonore <a>          - Alpha for non-ore\n");
+    printf( "   -alphalight          - Render with opacity lighting\n");
+    printf( "   -rotation <x y z w>  - Trackball rotation quaternion\n");
+    printf( "   -dolly <d>           - Dolly distance\n");
+    printf( "   -pan <x y z>         - Pan offset\n");
+    printf( "   -threads <n>         - Worker threads\n");
+    printf( "   -tile <n>            - Tile size in pixels\n");
+    printf( "   -packet <n>          - Rays per SIMD packet, 1 for scalar\n");
+    printf( "   -voxels              - Visit every texel along the ray instead of fixed steps\n");
+    printf( "   -threshold <a>       - Stop rays once their opacity reaches a\n");
+    printf( "   -stepdist <d>        - Grow steps beyond distance d from the eye\n");
+    printf( "   -noskip              - March every sample, without empty space skipping\n");
+    printf( "   -skipalpha <a>       - Also skip bricks with alpha up to a, 0-255\n");
+    printf( "   -shade <channel>     - Shade colors by occlusion, shadow or both\n");
+    printf( "   -lod <levels>        - March a view of 8 << (levels - 1) chunks square, coarser away from the middle (1-4)\n");
+    printf( "   -loddist <d>         - Coarsen samples each time the distance from the eye doubles past d\n");
+    printf( "   -passes <n>          - Average n passes with offset samples\n");
+    printf( "   -preview <s>         - Render the coarse frame of a moving camera, at 1/s size\n");
+    printf( "   -ores                - Draw only the ores, as splats, instead of marching the volume\n");
+    printf( "   -index <file>        - With -ores, skip the chunks without ores by a block index, made or updated first\n");
+    printf( "   -caves               - Draw only the caves and enclosed air, instead of the terrain\n");
+    printf( "   -diff <world>        - Highlight the blocks changed since this copy of the world, such as a backup\n");
+    printf( "   -cache <file>        - Read chunks from this cache of the world (see MineTrace_cache) where it is current\n");
+    printf( "   -slice <axis> <n>    - Write slice n at a height (y) or along z or x, one pixel per block\n");
+    printf( "   -plane <o> <u> <v> <w> <h> - Write the plane through texel o spanned by u and v, 3 floats each\n");
+    printf( "   -repeat <n>          - Render n times and report the average time\n");
+    printf( "   -tilecost <file>     - Write the milliseconds each tile took as CSV\n");
+    printf( "   -target <ms>         - Lower the quality of each frame to hold ms per frame\n");
+    printf( "   -governorlog <file>  - Write each quality change of -target as CSV\n");
+}
+
+// writes the cost of each tile of the last render as rows of x,y,ms and
+// prints how evenly the threads shared them
+bool WriteTileCosts(const char *path, CpuVolumeRender &renderer)
+{
+    int tilesX, tilesY;
+    const float *cost = renderer.getTileCosts(&tilesX, &tilesY);
+    if( cost == NULL )
+        return false;
+
+    FILE *f = fopen(path, "w");
+    if( f == NULL )
+        return false;
+
+    float sum = 0.0f, most = 0.0f;
+    fprintf(f, "x,y,ms\n");
+    for(int y = 0; y < tilesY; y++)
+    {
+        for(int x = 0; x < tilesX; x++)
+        {
+            float c = cost[y * tilesX + x];
+            fprintf(f, "%d,%d,%.4f\n", x, y, c);
+            sum += c;
+            if( c > most ) most = c;
+        }
+    }
+    fclose(f);
+
+    printf("%d tiles: %.2f ms in total, %.3f ms mean, %.3f ms slowest, %d stolen by %d threads\n",
+           tilesX * tilesY, sum, sum / (tilesX * tilesY), most, renderer.getSteals(), renderer.getUsedThreads());
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+
+    const char *world = argv[1];
+    const char *output = "minetrace.png";
+    int cx = 0, cz = 0;
+    bool useSpawn = true;
+    int width = 1024, height = 768;
+    float density = 1.0f, brightness = 1.0f, nonOreAlpha = 1.0f;
+    bool alphaLight = false;
+    float rotation[4] = { 0.0f, 1.0f, 0.0f, 0.0f };
+    float dolly = -4.0f;
+    float pan[3] = { 0.0f, 0.0f, 0.0f };
+    int threads = 0, tile = 32, repeat = 1, packet = 0;
+    bool skip = true, voxels = false;
+    int skipAlpha = 0;
+    int shadeChannel = -1;
+    int lodLevels = 0;
+    float lodDistance = 4.0f;
+    float threshold = 1.0f, stepDistance = 0.0f;
+    int passes = 1, preview = 0;
+    bool oreSplats = false, caves = false;
+    int sliceAxis = -1, sliceIndex = 0;
+    float plane[9];
+    int planeWidth = 0, planeHeight = 0;
+    const char *tileCostFile = NULL;
+    const char *indexFile = NULL;
+    const char *diffWorld = NULL;
+    const char *cacheFile = NULL;
+    float target = 0.0f;
+    const char *governorLog = NULL;
+
+    int a = 2;
+    if( argc > 3 && argv[2][0] != '-' )
+    {
+        cx = atoi(argv[2]);
+        cz = atoi(argv[3]);
+        useSpawn = false;
+        a = 4;
+    }
+
+    for( ; a < argc; a++)
+    {
+        int left = argc - a - 1;
+        if( strcmp(argv[a], "-o") == 0 && left >= 1 )
+            output = argv[++a];
+        else if( strcmp(argv[a], "-size") == 0 && left >= 2 ) {
+            width = atoi(argv[++a]);
+            height = atoi(argv[++a]);
+        }
+        else if( strcmp(argv[a], "-density") == 0 && left >= 1 )
+            density = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-brightness") == 0 && left >= 1 )
+            brightness = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-nonore") == 0 && left >= 1 )
+            nonOreAlpha = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-alphalight") == 0 )
+            alphaLight = true;
+        else if( strcmp(argv[a], "-rotation") == 0 && left >= 4 ) {
+            for(int k = 0; k < 4; k++)
+                rotation[k] = (float)atof(argv[++a]);
+        }
+        else if( strcmp(argv[a], "-dolly") == 0 && left >= 1 )
+            dolly = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-pan") == 0 && left >= 3 ) {
+            for(int k = 0; k < 3; k++)
+                pan[k] = (float)atof(argv[++a]);
+        }
+        else if( strcmp(argv[a], "-threads") == 0 && left >= 1 )
+            threads = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-tile") == 0 && left >= 1 )
+            tile = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-packet") == 0 && left >= 1 )
+            packet = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-voxels") == 0 )
+            voxels = true;
+        else if( strcmp(argv[a], "-threshold") == 0 && left >= 1 )
+            threshold = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-stepdist") == 0 && left >= 1 )
+            stepDistance = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-noskip") == 0 )
+            skip = false;
+        else if( strcmp(argv[a], "-skipalpha") == 0 && left >= 1 )
+            skipAlpha = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-shade") == 0 && left >= 1 ) {
+            shadeChannel = FindShadeChannel(argv[++a]);
+            if( shadeChannel < 0 ) {
+                printf("Unknown shade channel %s\n", argv[a]);
+                return 1;
+            }
+        }
+        else if( strcmp(argv[a], "-lod") == 0 && left >= 1 )
+            lodLevels = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-loddist") == 0 && left >= 1 )
+            lodDistance = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-passes") == 0 && left >= 1 )
+            passes = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-preview") == 0 && left >= 1 )
+            preview = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-ores") == 0 )
+            oreSplats = true;
+        else if( strcmp(argv[a], "-index") == 0 && left >= 1 )
+            indexFile = argv[++a];
+        else if( strcmp(argv[a], "-caves") == 0 )
+            caves = true;
+        else if( strcmp(argv[a], "-diff") == 0 && left >= 1 )
+            diffWorld = argv[++a];
+        else if( strcmp(argv[a], "-cache") == 0 && left >= 1 )
+            cacheFile = argv[++a];
+        else if( strcmp(argv[a], "-slice") == 0 && left >= 2 ) {
+            const char *axes = "yzx";
+            const char *axis = strchr(axes, argv[++a][0]);
+            sliceAxis = axis != NULL && argv[a][0] != '\0' ? (int)(axis - axes) : -2;
+            sliceIndex = atoi(argv[++a]);
+        }
+        else if( strcmp(argv[a], "-plane") == 0 && left >= 11 ) {
+            for(int k = 0; k < 9; k++)
+                plane[k] = (float)atof(argv[++a]);
+            planeWidth = atoi(argv[++a]);
+            planeHeight = atoi(argv[++a]);
+        }
+        else if( strcmp(argv[a], "-repeat") == 0 && left >= 1 )
+            repeat = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-tilecost") == 0 && left >= 1 )
+            tileCostFile = argv[++a];
+        else if( strcmp(argv[a], "-target") == 0 && left >= 1 )
+            target = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-governorlog") == 0 && left >= 1 )
+            governorLog = argv[++a];
+        else {
+            printf("Unknown option %s\n", argv[a]);
+            usage();
+            return 1;
+        }
+    }
+
+    if( width <= 0 || height <= 0 || repeat <= 0 || passes <= 0 || preview < 0 || target < 0.0f ||
+        sliceAxis == -2 || planeWidth < 0 || planeHeight < 0 || lodLevels < 0 || lodLevels > LodVolume::MAX_LEVELS ||
+        (lodLevels > 0 && (oreSplats || sliceAxis >= 0 || planeWidth > 0 || shadeChannel >= 0)) ||
+        (indexFile != NULL && !oreSplats) || (caves && (oreSplats || lodLevels > 0)) ||
+        (diffWorld != NULL && (caves || oreSplats || lodLevels > 0)) )
+    {
+        usage();
+        return 1;
+    }
+
+    if( useSpawn && !ReadPlayerChunk(world, &cx, &cz) )
+    {
+        printf("Cannot read player position from %s/level.dat\n", world);
+        return 1;
+    }
+
+    // loading and rendering share the pool, which -threads may enlarge
+    if( threads > 0 )
+        TaskPool::shared().reserve(threads);
+
+    // chunks changed since the cache was written are read from the region
+    // files as usual
+    WorldCache cache;
+    if( cacheFile != NULL )
+    {
+        if( cache.open(cacheFile, world) )
+            SetChunkCache(&cache);
+        else
+            printf("Cannot read %s, reading the region files\n", cacheFile);
+    }
+
+    mc::initialize_constants();
+
+    VolumePalette palette;
+    InitPalette(&palette, nonOreAlpha, alphaLight);
+
+    std::vector<unsigned char> vData;
+    OccupancyGrid occupancy(VOLUME_SIZE, VOLUME_SIZE, VOLUME_SIZE);
+    OreCloud ores(VOLUME_CHUNKS, VOLUME_CHUNKS);
+    ShadeVolume shade(VOLUME_SIZE, VOLUME_SIZE, VOLUME_SIZE);
+    SurfaceMap surface(VOLUME_CHUNKS, VOLUME_CHUNKS);
+    bool terrain = false;
+    LodVolume *lod = NULL;
+    if( lodLevels > 0 )
+    {
+        // the middle 8x8 chunks of the view are the ones the volume holds
+        lod = new LodVolume(lodLevels);
+        int offset = lod->getLevel(0).offset;
+        int found = lod->load(world, cx - offset, cz - offset, &palette);
+        printf("Loaded %d of %dx%d chunks around (%d,%d)\n", found, lod->getChunks(), lod->getChunks(), cx, cz);
+    }
+    else if( oreSplats && sliceAxis < 0 && planeWidth == 0 )
+    {
+        // ore views need only the ores, and none of the chunks the index
+        // shows to hold no ore
+        BlockIndex index;
+        if( indexFile != NULL )
+        {
+            index.load(indexFile);
+            int decoded = index.update(world, threads);
+            if( decoded > 0 && !index.save(indexFile) )
+                printf("Cannot write %s\n", indexFile);
+            printf("Indexed %d chunks, %d of them decoded again\n", index.getChunkCount(), decoded);
+        }
+        int skipped = 0;
+        int found = LoadOreCloud(&ores, world, cx, cz, indexFile != NULL ? &index : NULL, &skipped);
+        printf("Loaded %d chunks at (%d,%d), %d without ores skipped\n", found, cx, cz, skipped);
+    }
+    else
+    {
+        vData.resize(VOLUME_SIZE * VOLUME_SIZE * VOLUME_SIZE * 4);
+        int found = LoadVolume(&vData[0], world, cx, cz, &palette, VOLUME_CHUNKS, VOLUME_CHUNKS,
+                               0, 0, 0, 0, &occupancy, NULL, shadeChannel >= 0 ? &shade : NULL, &surface);
+        printf("Loaded %d chunks at (%d,%d)\n", found, cx, cz);
+        terrain = !caves && diffWorld == NULL;
+
+        if( caves )
+        {
+            // the cave mask takes the place of the terrain, so the grids
+            // built from the terrain are built again
+            CaveVolume caveVolume(VOLUME_CHUNKS, VOLUME_CHUNKS);
+            caveVolume.extract(world, cx, cz);
+            caveVolume.colorize(&vData[0]);
+            occupancy.build(&vData[0]);
+            if( shadeChannel >= 0 )
+                shade.build(&vData[0]);
+            printf("Found %lld cave blocks in %d rounds in %.2f ms\n", caveVolume.getCaveBlocks(),
+                   caveVolume.getRounds(), caveVolume.getUpdateTime());
+        }
+        else if( diffWorld != NULL )
+        {
+            // faded terrain leaves the changes to stand out
+            WorldDiff diff(diffWorld, world);
+            diff.setThreads(threads);
+            std::vector<ChunkDiff> chunks;
+            std::vector<BlockChange> blocks;
+            diff.diffGrid(cx, cz, VOLUME_CHUNKS, VOLUME_CHUNKS, &chunks, &blocks);
+            HighlightChanges(&vData[0], cx, cz, blocks);
+            occupancy.build(&vData[0]);
+            if( shadeChannel >= 0 )
+                shade.build(&vData[0]);
+            printf("%d chunks changed with %d blocks in %.2f ms\n", (int)chunks.size(), (int)blocks.size(),
+                   diff.getStats().ms);
+        }
+    }
+    if( shadeChannel >= 0 )
+        printf("Shaded in %.2f ms\n", shade.getUpdateTime());
+    if( cache.isOpen() )
+        printf("Read %d chunks from the cache, %d not in it or changed\n", cache.getHits(), cache.getMisses());
+
+    // slices are cut straight out of the volume, without a camera
+    if( sliceAxis >= 0 || planeWidth > 0 )
+    {
+        VolumeSlicer slicer(&vData[0], VOLUME_SIZE, VOLUME_SIZE, VOLUME_SIZE);
+        std::vector<unsigned char> rgb;
+        int w = planeWidth, h = planeHeight;
+        if( sliceAxis >= 0 )
+        {
+            VolumeSlicer::Axis axis = (VolumeSlicer::Axis)sliceAxis;
+            if( axis == VolumeSlicer::SLICE_Y )
+                slicer.update();
+            slicer.getSliceSize(axis, &w, &h);
+            rgb.resize((size_t)w * h * 3);
+            slicer.extract(axis, sliceIndex, &rgb[0]);
+        }
+        else
+        {
+            rgb.resize((size_t)w * h * 3);
+            slicer.extractPlane(plane, plane + 3, plane + 6, w, h, &rgb[0]);
+        }
+
+        int ok = WriteImage(output, &rgb[0], w, h);
+        if( !ok )
+            printf("Cannot write %s\n", output);
+
+        mc::deinitialize_constants();
+
+        return ok ? 0 : 1;
+    }
+
+    CpuCamera camera;
+    SetExamineCamera(&camera, rotation, dolly, pan);
+
+    if( oreSplats )
+    {
+        CpuOreRender oreRender(&ores, &palette);
+        oreRender.setBrightness(brightness);
+        oreRender.setThreads(threads);
+
+        std::vector<unsigned char> rgb((size_t)width * height * 3);
+        double total = 0.0;
+        for(int r = 0; r < repeat; r++)
+        {
+            oreRender.render(camera, &rgb[0], width, height);
+            total += oreRender.getRenderTime();
+        }
+        printf("Drew %d of %d ores at %dx%d in %.2f ms\n", oreRender.getSplatCount(), (int)ores.size(),
+               width, height, total / repeat);
+
+        int ok = WriteImage(output, &rgb[0], width, height);
+        if( !ok )
+            printf("Cannot write %s\n", output);
+
+        mc::deinitialize_constants();
+
+        return ok ? 0 : 1;
+    }
+
+    CpuVolumeRender renderer(lod != NULL ? lod->getLevel(0).texels : &vData[0], VOLUME_SIZE, VOLUME_SIZE, VOLUME_SIZE);
+    renderer.setDensity(density);
+    renderer.setBrightness(brightness);
+    renderer.setThreads(threads);
+    renderer.setTileSize(tile);
+    renderer.setPacketWidth(packet);
+    if( skip )
+        renderer.setOccupancy(&occupancy);
+    // nothing of the terrain is above its highest column
+    if( skip && terrain )
+        renderer.setCeiling(surface.getMaxHeight());
+    renderer.setSkipAlpha(skipAlpha);
+    if( shadeChannel >= 0 )
+        renderer.setShading(&shade, shadeChannel);
+    renderer.setLod(lod);
+    renderer.setLodDistance(lodDistance);
+    renderer.setOpacityThreshold(threshold);
+    renderer.setStepDistance(stepDistance);
+    if( voxels )
+        renderer.setTraversal(CpuVolumeRender::TRAVERSE_VOXELS);
+
+    ProgressiveRender progressive;
+    progressive.setPasses(passes);
+    if( preview > 0 ) {
+        progressive.setPreviewScale(preview);
+        progressive.moved();
+    }
+
+    // with a target every frame is rendered at the quality the governor
+    // picked from the frames before it, on top of the options above
+    QualityGovernor governor(target);
+    if( governorLog != NULL && !governor.openLog(governorLog) )
+        printf("Cannot write %s\n", governorLog);
+
+    // frames which are upsampled or averaged are rendered into frame first
+    size_t bytes = (size_t)width * height * 3;
+    std::vector<unsigned char> rgb(bytes), frame, full;
+    double total = 0.0;
+    for(int r = 0; r < repeat; r++)
+    {
+        progressive.restart();
+        while( progressive.refining() )
+        {
+            int scale = progressive.getScale();
+            float resolution = 1.0f / scale;
+            float stepScale = progressive.getStepScale();
+            if( target > 0.0f )
+            {
+                resolution *= governor.getResolution();
+                stepScale *= governor.getStepScale();
+                float t = governor.getThreshold();
+                renderer.setOpacityThreshold(t < threshold ? t : threshold);
+                // growing steps leave the packets for single rays, which
+                // costs more than they save, so they only move in when
+                // they were asked for
+                if( stepDistance > 0.0f )
+                    renderer.setStepDistance(governor.getFarDistance(stepDistance, -dolly - 0.5f));
+                renderer.setLodDistance(governor.getFarDistance(lodDistance, 4.0f));
+            }
+            int w = (int)(width * resolution) > 0 ? (int)(width * resolution) : 1;
+            int h = (int)(height * resolution) > 0 ? (int)(height * resolution) : 1;
+            bool upsample = w != width || h != height;
+            float weight = progressive.getWeight();
+
+            renderer.setStepScale(stepScale);
+            renderer.setJitter(progressive.getJitter());
+
+            unsigned char *dst = &rgb[0];
+            if( upsample || weight < 1.0f ) {
+                frame.resize((size_t)w * h * 3);
+                dst = &frame[0];
+            }
+            renderer.render(camera, dst, w, h);
+            total += renderer.getRenderTime();
+            if( target > 0.0f )
+                governor.frame((float)renderer.getRenderTime());
+
+            if( upsample ) {
+                full.resize(bytes);
+                UpsampleImage(&frame[0], w, h, &full[0], width, height);
+                BlendImage(&rgb[0], &full[0], bytes, weight);
+            }
+            else if( weight < 1.0f )
+                BlendImage(&rgb[0], &frame[0], bytes, weight);
+
+            progressive.next();
+        }
+    }
+    printf("Rendered %dx%d in %.2f ms (%d threads, %d lane packets)\n", width, height, total / repeat,
+           renderer.getThreadCount(), renderer.getPacketWidth());
+    if( target > 0.0f )
+        printf("Governor at level %d of %d after %d changes: %.2f ms, resolution %.2f, steps %.2f, threshold %.2f, far bias %d\n",
+               governor.getLevel(), QualityGovernor::LEVELS - 1, governor.getChanges(), governor.getAverage(),
+               governor.getResolution(), governor.getStepScale(), governor.getThreshold(), governor.getLodBias());
+
+    if( tileCostFile != NULL && !WriteTileCosts(tileCostFile, renderer) )
+        printf("Cannot write %s\n", tileCostFile);
+
+    int ok = WriteImage(output, &rgb[0], width, height);
+    if( !ok )
+        printf("Cannot write %s\n", output);
+
+    delete lod;
+    mc::deinitialize_constants();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+//
+//  Decription: Keeps a block index beside a Minecraft World (see BlockIndex.h),
+//  the block ids each chunk holds and how many of each, and answers which
+//  chunks hold given blocks from it, such as where to find diamond or lapis
+//  ore, without decompressing any chunk. Each run first brings the index up
+//  to date, decoding only the chunks whose timestamps changed. It also finds
+//  the blocks of given ids nearest to the player or any position (see
+//  BlockSearch.h), decoding only the chunks near it which hold them.
+//
+//  usage: <MineTrace_index> <world directory> [options]
+//
+//  Options:
+//      -o <file>            - Index file (default <world directory>/blocks.idx)
+//      -find <id>           - List the chunks holding this block id, may be given again for any of several
+//      -nearest <k>         - List the k blocks of the -find ids nearest to the player instead
+//      -at <x> <y> <z>      - Search from this block position instead of the player
+//      -threads <n>         - Worker threads (default all cores)
+//
+//  Chunks found are printed one per line as their x and z followed by the
+//  count of each id asked for, and blocks found as their x, y and z, id,
+//  name and distance.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "BlockIndex.h"
+#include "BlockSearch.h"
+#include "TaskPool.h"
+#include "blocks.hpp"
+
+void usage()
+{
+    printf( "usage : MineTrace_index <world directory> [options]\n");
+    printf( "   -o <file>            - Index file\n");
+    printf( "   -find <id>           - List the chunks holding this block id, may be given again for any of several\n");
+    printf( "   -nearest <k>         - List the k blocks of the -find ids nearest to the player instead\n");
+    printf( "   -at <x> <y> <z>      - Search from this block position instead of the player\n");
+    printf( "   -threads <n>         - Worker threads\n");
+}
+
+int main(int argc, char** argv)
+{
+    if( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+
+    const char *world = argv[1];
+    std::string output = std::string(world) + "/blocks.idx";
+    int threads = 0, nearest = 0;
+    bool atPlayer = true;
+    double at[3] = { 0.0, 0.0, 0.0 };
+    std::vector<int> find;
+
+    for(int a = 2; a < argc; a++)
+    {
+        int left = argc - a - 1;
+        if( strcmp(argv[a], "-o") == 0 && left >= 1 )
+            output = argv[++a];
+        else if( strcmp(argv[a], "-find") == 0 && left >= 1 )
+            find.push_back(atoi(argv[++a]));
+        else if( strcmp(argv[a], "-nearest") == 0 && left >= 1 )
+            nearest = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-at") == 0 && left >= 3 ) {
+            for(int i = 0; i < 3; i++)
+                at[i] = atof(argv[++a]);
+            atPlayer = false;
+        }
+        else if( strcmp(argv[a], "-threads") == 0 && left >= 1 )
+            threads = atoi(argv[++a]);
+        else {
+            printf("Unknown option %s\n", argv[a]);
+            usage();
+            return 1;
+        }
+    }
+
+    BlockSet ids;
+    for(size_t f = 0; f < find.size(); f++)
+    {
+        if( find[f] < 0 || find[f] >= BLOCK_IDS ) {
+            usage();
+            return 1;
+        }
+        ids.add(find[f]);
+    }
+    if( nearest < 0 || (nearest > 0 && find.empty()) )
+    {
+        usage();
+        return 1;
+    }
+
+    if( threads > 0 )
+        TaskPool::shared().reserve(threads);
+
+    // a missing or unreadable index is rebuilt from scratch
+    BlockIndex index;
+    if( !index.load(output.c_str()) )
+        printf("No index in %s, building it\n", output.c_str());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int decoded = index.update(world, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if( decoded < 0 )
+    {
+        printf("Cannot read the region directory of %s\n", world);
+        return 1;
+    }
+
+    int ok = decoded == 0 || index.save(output.c_str());
+    if( !ok )
+        printf("Cannot write %s\n", output.c_str());
+    printf("Indexed %d chunks, %d of them decoded again, in %.2f s\n", index.getChunkCount(), decoded, seconds);
+
+    if( nearest > 0 )
+    {
+        if( atPlayer && !ReadPlayerPosition(world, &at[0], &at[1], &at[2]) )
+        {
+            printf("Cannot read player position from %s/level.dat\n", world);
+            return 1;
+        }
+
+        mc::initialize_constants();
+
+        std::vector<BlockHit> hits;
+        BlockSearchStats stats;
+        FindNearestBlocks(world, index, ids, at[0], at[1], at[2], nearest, &hits, threads, &stats);
+        for(size_t h = 0; h < hits.size(); h++)
+            printf("%d %d %d %d %s %.1f\n", hits[h].x, hits[h].y, hits[h].z, hits[h].id,
+                   hits[h].id < mc::MaterialCount ? mc::MaterialName[hits[h].id] : "None", hits[h].distance);
+        printf("%d blocks found near %.1f %.1f %.1f in %.2f ms, %d chunks decoded over %d rings\n",
+               (int)hits.size(), at[0], at[1], at[2], stats.ms, stats.decoded, stats.rings);
+
+        mc::deinitialize_constants();
+    }
+    else if( !find.empty() )
+    {
+        std::vector<ChunkCoord> chunks;
+        start = std::chrono::steady_clock::now();
+        index.query(ids, &chunks);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        for(size_t c = 0; c < chunks.size(); c++)
+        {
+            const ChunkBlocks *blocks = index.find(chunks[c].x, chunks[c].z);
+            printf("%d %d", chunks[c].x, chunks[c].z);
+            for(size_t f = 0; f < find.size(); f++)
+                printf(" %d", blocks->count(find[f]));
+            printf("\n");
+        }
+        printf("%d chunks found in %.2f ms\n", (int)chunks.size(), ms);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -5,13 +5,26 @@
 //  Modified from NVIDIA sdk example for rendering a volume stored in a 3D texture.
 //  Uses getenv_s to find the APPDATA folder.
 //
-//  usage: <MineTrace> <World Number>
+//  usage: <MineTrace> <World Number> [<NW chunk X> <NW chunk Z> [<backup world directory>]]
 //
 //  Controls:
 //      c       - Toggle drawing the extents of the volume in wireframe\n");
 //      g       - Toggle drawing the extents of chunks in wireframe\n");
 //      l       - Toggle rendering with opacity lighting \n");
 //      p       - shift chunk with player position \n");
+//      v       - Toggle visiting every voxel along the rays \n");
+//      e       - Toggle stopping rays once nearly opaque \n");
+//      f       - Toggle longer steps far from the eye \n");
+//      o       - Toggle drawing only the ores, as cubes \n");
+//      k       - Cycle slices at a height, a z and an x, and the volume \n");
+//   - and =    - Move the slice down or up a layer\n");
+//      j       - Toggle scrolling through the height slices layer by layer\n");
+//      x       - Export the slice as slice_<axis>_<index>.png\n");
+//      h       - Cycle shading by occlusion, shadow, both and none \n");
+//      t       - Toggle holding moving frames to 16 ms, logged to governor.csv \n");
+//      n       - Toggle coloring each vein of ore apart \n");
+//      u       - Toggle drawing only the caves and enclosed air \n");
+//      b       - Toggle highlighting the blocks changed since the backup \n");
 //   [ and ]    - Change density\n");
 //   ; and '    - Change brightness\n");
 //   , and .    - Change alpha for non-ore\n");
@@ -24,11 +37,13 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stack>
 #include <map>
 #include <string>
 #include <windows.h>
 #include <assert.h>
+#include <chrono>
 
 #include <GL/glew.h>
 #include <GL/glut.h>
@@ -43,6 +58,18 @@ extern "C"
 
 #include "nvGlutManipulators.h"
 #include "VolumeRender.h"
+#include "VolumeLoader.h"
+#include "OreCloud.h"
+#include "OreRender.h"
+#include "ShadeVolume.h"
+#include "VolumeSlicer.h"
+#include "ImageWriter.h"
+#include "ProgressiveRender.h"
+#include "QualityGovernor.h"
+#include "VeinLabeler.h"
+#include "CaveVolume.h"
+#include "WorldDiff.h"
+#include "WorldCache.h"
 
 #define LO(w)           ((BYTE)(((DWORD_PTR)(w)) & 0xf))
 #define HI(w)           ((BYTE)((((DWORD_PTR)(w)) >> 4) & 0xf))
@@ -72,8 +99,78 @@ float viewDistance = -4.0f;
 int spawnx;
 int spawnz;
 bool retrievedSpawn = false;
-LARGE_INTEGER start_time;
-LARGE_INTEGER time_freq;
+
+// the volume is only marched when something changed since the last frame,
+// with coarse frames while the camera moves and refining passes once it
+// settles. Other display calls, such as window exposure, present the copy
+// of the last image of the volume kept in frameTex.
+ProgressiveRender progressive;
+GLuint frameTex = 0;
+int frameTexWidth = 0;
+int frameTexHeight = 0;
+// part of frameTex holding the image, smaller than the window for previews
+int frameWidth = 0;
+int frameHeight = 0;
+
+// the camera has settled once it did not move for this long
+const int SETTLE_MS = 150;
+int moveCount = 0;
+// coarse frames are kept under this many pixels
+const int PREVIEW_PIXELS = 640 * 480;
+
+// with the governor on, moving frames are rendered at the quality it picks
+// from the time of the frames before, instead of the fixed preview, and
+// each change is logged. Refining passes stay at full quality.
+const float TARGET_FRAME_MS = 16.0f;
+const char *GOVERNOR_LOG = "governor.csv";
+QualityGovernor governor(TARGET_FRAME_MS);
+bool governed = false;
+
+// with vein colors on, the ores of the grid are labeled into veins each
+// time the chunks change, and each vein is drawn in a color of its own
+// rather than that of its ore
+VeinLabeler veins;
+bool veinColors = false;
+char worldDir[80] = "";
+
+// with the cave view on, the volume holds the cave mask of the grid in
+// place of the terrain, found again each time the chunks change
+CaveVolume * caves = NULL;
+bool caveView = false;
+
+// with the diff view on, the blocks changed since a backup of the world
+// are highlighted over the faded terrain, compared again each time the
+// chunks change
+const char *backupDir = NULL;
+bool diffView = false;
+// chunks of the grid read since they were last faded, [i * 8 + j]
+bool freshChunks[64];
+
+// chunks are read from the cache beside the world, chunks.cache, where
+// MineTrace_cache made one and it is current, and from the region files
+// otherwise
+WorldCache chunkCache;
+
+// slice mode shows a single layer or plane of the volume instead of
+// marching it, as a texture drawn over the window. sliceAxis is -1 while
+// the volume is shown. The slicer's copy of the layers is only rebuilt
+// when a slice is shown after the chunks changed.
+VolumeSlicer * slicer = NULL;
+int sliceAxis = -1;
+int sliceIndex[VolumeSlicer::SLICE_AXES] = { 64, 64, 64 };
+bool sliceStale = true;
+bool sliceScroll = false;
+int scrollCount = 0;
+GLuint sliceTex = 0;
+// layers scroll past at this interval
+const int SLICE_SCROLL_MS = 150;
+
+// trackball inertia turns the view one increment per interval of the
+// monotonic clock while the trackball spins
+const int SPIN_INTERVAL_MS = 20;
+const int SPIN_MAX_CATCHUP = 5;
+std::chrono::steady_clock::time_point lastSpin;
+bool spinScheduled = false;
 //unsigned char blockArr[32768];
 //unsigned char radiArr[16384];
 
@@ -82,10 +179,22 @@ nv::GlutExamine trackball;
 CGcontext cgContext; 
 VolumeRender * volumeRender = NULL;
 VolumeBuffer * vBuff = NULL;
+OccupancyGrid * occupancy = NULL;
+OreCloud * ores = NULL;
+OreRender * oreRender = NULL;
+ShadeVolume * shade = NULL;
+VolumePalette palette;
 ImageBuffer * cBuff = NULL;
 unsigned char* vData = NULL;
 int gWin = -1;
 bool alphaLight = false;
+bool voxelTraversal = false;
+bool earlyExit = false;
+bool farSteps = false;
+bool oreCubes = false;
+// ShadeChannel the volume is shaded by, -1 for none. The shade volume is
+// only kept up to date while shading.
+int shadeChannel = -1;
 
 float density = 1.0f;
 float nonOreAlpha = 1.0f;
@@ -94,6 +203,8 @@ mc::color BlockC[255];
 
 char base32digits[37] = "0123456789abcdefghijklmnopqrstuvwxyz";
 
+void ApplyQueuedMove();
+
 
 std::string base36(int M)
 {	
@@ -123,6 +234,18 @@ void CleanUp()
 		delete volumeRender;
 	if( vData != NULL )
 		delete[] vData;
+	if( occupancy != NULL )
+		delete occupancy;
+	if( ores != NULL )
+		delete ores;
+	if( oreRender != NULL )
+		delete oreRender;
+	if( shade != NULL )
+		delete shade;
+	if( caves != NULL )
+		delete caves;
+	if( slicer != NULL )
+		delete slicer;
 	if( cBuff != NULL )
 		delete cBuff;
 
@@ -138,17 +261,163 @@ void text_output(GLfloat x, GLfloat y, GLfloat z, char *text)
 		glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *p);
 }
 
-void display()
+// the image changed without the camera moving, refine it from a full pass
+void Redraw()
+{
+	progressive.restart();
+	glutPostRedisplay();
+}
+
+// settles the camera unless it moved again after the move which set the timer
+void settle(int move)
+{
+	if( move != moveCount )
+		return;
+	progressive.settle();
+	glutPostRedisplay();
+}
+
+// the camera moved, draw a coarse frame and refine once it stops
+void Moved()
+{
+	progressive.moved();
+	glutTimerFunc(SETTLE_MS, settle, ++moveCount);
+	glutPostRedisplay();
+}
+
+// copies the lower left w by h pixels of the back buffer into frameTex
+void CacheFrame(int w, int h)
+{
+	if( frameTex == 0 || frameTexWidth != width || frameTexHeight != height )
+	{
+		if( frameTex == 0 )
+			glGenTextures(1, &frameTex);
+		glBindTexture(GL_TEXTURE_2D, frameTex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		frameTexWidth = width;
+		frameTexHeight = height;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, frameTex);
+	glReadBuffer(GL_BACK);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, w, h);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	frameWidth = w;
+	frameHeight = h;
+}
+
+// draws the image in frameTex over the whole window, upsampled if it is a
+// coarse frame. Below an opacity of 1 it is blended over the window.
+void DrawCachedFrame(float opacity)
+{
+	glViewport(0, 0, width, height);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	GLint filter = frameWidth != width || frameHeight != height ? GL_LINEAR : GL_NEAREST;
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, frameTex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+	if( opacity < 1.0f ) {
+		glBlendColor(0.0f, 0.0f, 0.0f, opacity);
+		glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+	}
+	else
+		glDisable(GL_BLEND);
+
+	float s = (float)frameWidth / frameTexWidth;
+	float t = (float)frameHeight / frameTexHeight;
+	glBegin(GL_QUADS);
+	glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f, -1.0f);
+	glTexCoord2f(s, 0.0f); glVertex2f( 1.0f, -1.0f);
+	glTexCoord2f(s, t); glVertex2f( 1.0f,  1.0f);
+	glTexCoord2f(0.0f, t); glVertex2f(-1.0f,  1.0f);
+	glEnd();
+
+	// back to the state set up by initGL
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_BLEND);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_BLEND);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDisable(GL_TEXTURE_2D);
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+}
+
+// marches the next frame of the refinement into the window and frameTex.
+// Coarse frames are marched into a corner and upsampled, refining passes
+// are averaged with the passes before them.
+void RenderVolume()
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	bool govern = governed && progressive.isMoving();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	float resolution = govern ? governor.getResolution() : 1.0f / progressive.getScale();
+	int w = (int)(width * resolution) > 0 ? (int)(width * resolution) : 1;
+	int h = (int)(height * resolution) > 0 ? (int)(height * resolution) : 1;
+	float weight = progressive.getWeight();
+	if( frameWidth != width || frameHeight != height || frameTexWidth != width || frameTexHeight != height )
+		weight = 1.0f;
 
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
     trackball.applyTransform();
 
-    // render volume
+	// the governor lowers the settings of the e and f keys further
+	float threshold = earlyExit ? 0.95f : 1.0f;
+	float stepDistance = farSteps ? -viewDistance - 0.5f : 0.0f;
+	if( govern ) {
+		if( governor.getThreshold() < threshold )
+			threshold = governor.getThreshold();
+		stepDistance = governor.getFarDistance(stepDistance, -viewDistance - 0.5f);
+	}
+	volumeRender->setOpacityThreshold(threshold);
+	volumeRender->setStepDistance(stepDistance);
+	volumeRender->setStepScale(govern ? governor.getStepScale() : progressive.getStepScale());
+	volumeRender->setJitter(progressive.getJitter());
+    glViewport(0, 0, w, h);
+	if( oreCubes )
+		oreRender->render();
+	else
+		volumeRender->render();
+
+	// the average of the passes so far goes over the new one
+	if( weight < 1.0f )
+		DrawCachedFrame(1.0f - weight);
+
+	CacheFrame(w, h);
+	if( w != width || h != height )
+		DrawCachedFrame(1.0f);
+
+	// the frame is timed through to the GPU finishing it
+	if( govern ) {
+		glFinish();
+		governor.frame(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	progressive.next();
+}
+
+// axis labels and the chunk grid or cube, over the volume
+void DrawOverlay()
+{
     glViewport(0, 0, width, height);
-    volumeRender->render();
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    trackball.applyTransform();
 
 	glEnable(GL_LINE_SMOOTH);
 
@@ -213,36 +482,209 @@ void display()
 	}
     else if (options[OPTION_DRAW_CUBE])
 		glutWireCube(1.0f);
-	
+}
 
-    glutSwapBuffers();
+// extracts the current slice, into rgb if given, returning its size
+void ExtractSlice(std::vector<unsigned char> &rgb, int *w, int *h)
+{
+	VolumeSlicer::Axis axis = (VolumeSlicer::Axis)sliceAxis;
+	if( sliceStale ) {
+		slicer->update();
+		sliceStale = false;
+	}
+
+	slicer->getSliceSize(axis, w, h);
+	rgb.resize((size_t)*w * *h * 3);
+	slicer->extract(axis, sliceIndex[axis], &rgb[0]);
 }
 
-void mouse( int button, int state, int x, int y)
+// draws the current slice over the window, as large as fits with square
+// blocks, and labels it with its axis and layer
+void DrawSlice()
 {
-    trackball.mouse(button, state, x, y);
+	int w, h;
+	std::vector<unsigned char> rgb;
+	ExtractSlice(rgb, &w, &h);
+
+	if( sliceTex == 0 )
+		glGenTextures(1, &sliceTex);
+	glBindTexture(GL_TEXTURE_2D, sliceTex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, &rgb[0]);
+
+	glViewport(0, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glEnable(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glDisable(GL_BLEND);
+
+	// the top row of the slice comes first, so t runs downwards
+	float sx = (float)w * height / (h * width), sy = 1.0f;
+	if( sx > 1.0f ) {
+		sy = 1.0f / sx;
+		sx = 1.0f;
+	}
+	glBegin(GL_QUADS);
+	glTexCoord2f(0.0f, 1.0f); glVertex2f(-sx, -sy);
+	glTexCoord2f(1.0f, 1.0f); glVertex2f( sx, -sy);
+	glTexCoord2f(1.0f, 0.0f); glVertex2f( sx,  sy);
+	glTexCoord2f(0.0f, 0.0f); glVertex2f(-sx,  sy);
+	glEnd();
+
+	// back to the state set up by initGL
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_BLEND);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_BLEND);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDisable(GL_TEXTURE_2D);
 
-    glutPostRedisplay();
+	static const char *axisNames[VolumeSlicer::SLICE_AXES] = { "y", "z", "x" };
+	char label[64];
+	sprintf(label, "%s = %d", axisNames[sliceAxis], sliceIndex[sliceAxis]);
+	glColor3f(1.0,1.0,1.0);
+	text_output(-0.95f, -0.95f, 0.0f, label);
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
 }
 
-void motion(int x, int y)
+// writes the current slice at one pixel per block
+void ExportSlice()
 {
-    trackball.motion(x, y);
-    glutPostRedisplay();
+	int w, h;
+	std::vector<unsigned char> rgb;
+	ExtractSlice(rgb, &w, &h);
+
+	static const char *axisNames[VolumeSlicer::SLICE_AXES] = { "y", "z", "x" };
+	char filename[64];
+	sprintf(filename, "slice_%s_%d.png", axisNames[sliceAxis], sliceIndex[sliceAxis]);
+	if( WriteImage(filename, &rgb[0], w, h) )
+		printf("Wrote %s\n", filename);
+	else
+		printf("Cannot write %s\n", filename);
 }
 
-void idle()
+// moves the slice of the current axis by n layers, wrapping around
+void StepSlice(int n)
 {
-	LARGE_INTEGER curr_time;
-	QueryPerformanceCounter(&curr_time);
-	int diff = (int)((float)((curr_time.QuadPart - start_time.QuadPart)/(double)time_freq.QuadPart) * 1000);
+	int count = slicer->getSliceCount((VolumeSlicer::Axis)sliceAxis);
+	sliceIndex[sliceAxis] = ((sliceIndex[sliceAxis] + n) % count + count) % count;
+}
 
-	if( diff % 20 == 0 )
+// steps the height slice up a layer at a time while scrolling is on,
+// unless scrolling was turned off and on again since the timer was set
+void scrollSlice(int scroll)
+{
+	if( scroll != scrollCount )
+		return;
+	if( !sliceScroll || sliceAxis != VolumeSlicer::SLICE_Y )
 	{
+		sliceScroll = false;
+		return;
+	}
+
+	StepSlice(1);
+	glutPostRedisplay();
+	glutTimerFunc(SLICE_SCROLL_MS, scrollSlice, scroll);
+}
+
+void display()
+{
+	ApplyQueuedMove();
+
+	if( sliceAxis >= 0 )
+	{
+		DrawSlice();
+		glutSwapBuffers();
+		return;
+	}
+
+	if( progressive.refining() || frameWidth == 0 )
+		RenderVolume();
+	else
+		DrawCachedFrame(1.0f);
+
+	DrawOverlay();
+
+    glutSwapBuffers();
+
+	// refining passes follow each other until the last
+	if( progressive.refining() )
+		glutPostRedisplay();
+}
+
+void ScheduleSpin();
+
+// applies the trackball increments due since the last spin, then runs again
+// after another interval while the trackball still spins. Long stalls only
+// catch up a few increments so the view does not jump.
+void spin(int)
+{
+	spinScheduled = false;
+	if( !trackball.isSpinning() )
+		return;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	const std::chrono::milliseconds interval(SPIN_INTERVAL_MS);
+	int ticks = 0;
+	while( now - lastSpin >= interval )
+	{
+		if( ticks == SPIN_MAX_CATCHUP )
+		{
+			lastSpin = now;
+			break;
+		}
 		trackball.idle();
+		lastSpin += interval;
+		ticks++;
 	}
 
-    glutPostRedisplay();
+	if( ticks > 0 )
+		Moved();
+	ScheduleSpin();
+}
+
+// starts the spin timer if the trackball spins and it is not running yet
+void ScheduleSpin()
+{
+	if( spinScheduled || !trackball.isSpinning() )
+		return;
+
+	if( lastSpin == std::chrono::steady_clock::time_point() ||
+	    std::chrono::steady_clock::now() - lastSpin > std::chrono::milliseconds(SPIN_INTERVAL_MS * SPIN_MAX_CATCHUP) )
+		lastSpin = std::chrono::steady_clock::now();
+
+	spinScheduled = true;
+	glutTimerFunc(SPIN_INTERVAL_MS, spin, 0);
+}
+
+void mouse( int button, int state, int x, int y)
+{
+    trackball.mouse(button, state, x, y);
+    ScheduleSpin();
+
+    Redraw();
+}
+
+void motion(int x, int y)
+{
+    trackball.motion(x, y);
+    ScheduleSpin();
+    Moved();
 }
 
 void reshape(int w, int h)
@@ -257,6 +699,8 @@ void reshape(int w, int h)
     glViewport(0, 0, width, height);
 
     trackball.reshape(w, h);
+    progressive.setPreviewScale(ProgressiveRender::chooseScale(w, h, PREVIEW_PIXELS));
+    progressive.restart();
 }
 
 // we require OpenGL 2.0 or greater
@@ -319,20 +763,6 @@ void regionFile( char* str, int x, int y )
    sprintf(str,"r.%d.%d.mcr", x>>5, y>>5 );
 }
 
-mc::color GetColor(unsigned char c)
-{
-	mc::color temp = mc::MaterialColor[c];
-	if( c != mc::RedstoneOre &&
-		c != mc::GlowingRedstoneOre &&
-		c != mc::DiamondOre &&
-		c != mc::GoldOre &&
-		c != mc::IronOre &&
-		c != mc::CoalOre &&
-		c != mc::LapisLazuliOre )
-		temp.a *= nonOreAlpha;
-	return temp;
-}
-
 void InitColors()
 {
 	BlockC[0] = mc::color(255,255,255,0);
@@ -610,11 +1040,6 @@ int ReadMineCraftOldFormat( unsigned char* data, unsigned int w,
 	return 1;
 }
 
-const int CHUNK_DEFLATE_MAX = 1024 * 64;  // 64KB limit for compressed chunks
-const int CHUNK_INFLATE_MAX = 1024 * 128; // 128KB limit for inflated chunks
-
-unsigned char in[CHUNK_DEFLATE_MAX], out[CHUNK_INFLATE_MAX];
-
 // read in 8x8 grid of chunks, starting from provided top-left position
 int ReadMineCraft( unsigned char* data, unsigned int w,
 				   unsigned int bw, unsigned int bh,
@@ -622,19 +1047,7 @@ int ReadMineCraft( unsigned char* data, unsigned int w,
 				   unsigned int bxe = 0, unsigned int bye = 0,
 				   bool useSpawn = false)
 {
-	nbt_file* nbt = NULL;
 	char base[80];
-	char path[256];
-	char region[256];
-	unsigned int chunkmax = 16 * 16 * 128;
-
-	bool chunkFound = false;
-
-	if (nbt_init(&nbt) != NBT_OK)
-    {
-        fprintf(stderr, "NBT_Init(): Failure initializing\n");
-        return 0;
-    }
 
 	unsigned int len;
     getenv_s(&len, base, 80, "APPDATA");
@@ -649,37 +1062,26 @@ int ReadMineCraft( unsigned char* data, unsigned int w,
     if (hFind == INVALID_HANDLE_VALUE) 
 	{
 		printf("Cannot find World %d directory\n", w);
-		nbt_free(nbt);
 		return 0;
     } 
 	FindClose(hFind);
 	hFind = INVALID_HANDLE_VALUE;
 
-	// get spawn point from level.dat
+	strcpy(worldDir, base);
 
+	// get spawn point from level.dat
 	if( !retrievedSpawn )
 	{
 		retrievedSpawn = true;
-		sprintf(path, "%s\\level.dat", base);
-		if (nbt_parse(nbt, path,0) == NBT_OK)
-		{
-			nbt_tag *data = nbt_find_tag_by_name("Data", nbt->root);
-			//nbt_tag *spawn = nbt_find_tag_by_name("SpawnX", data);
+		ReadPlayerChunk(base, &spawnx, &spawnz);
 
-			//spawnx = *nbt_cast_int(spawn) / 16;
-			//spawn = nbt_find_tag_by_name("SpawnZ", data);
-			//spawnz = *nbt_cast_int(spawn) / 16;
-
-			nbt_tag *player = nbt_find_tag_by_name("Player", data);
-			nbt_tag *pos = nbt_find_tag_by_name( "Pos", player);
-			nbt_list* posList = nbt_cast_list(pos);
-			double** posArr = (double**)posList -> content;
-
-			spawnx = (int)*posArr[0] / 16;
-			spawnz = (int)*posArr[2] / 16;
-
-			nbt_free_tag(nbt->root);
-			nbt->root = NULL;
+		// and map the chunk cache, if the world has one
+		char cachePath[128];
+		sprintf(cachePath, "%s\\chunks.cache", base);
+		if( chunkCache.open(cachePath, base) )
+		{
+			SetChunkCache(&chunkCache);
+			printf("Reading chunks from %s\n", cachePath);
 		}
 	}
 
@@ -689,293 +1091,218 @@ int ReadMineCraft( unsigned char* data, unsigned int w,
 		cz = spawnz;
 	}
 
-	//unsigned char* skyArr = nbt_cast_byte_array(sky);
+	// chunks the game saved since the last load are read from the region
+	// files rather than the cache
+	chunkCache.refresh();
 
 	// load chunks
-	for( unsigned int i = bxs; i < bw - bxe; i++)
-	{
-		for( unsigned int j = bys; j < bh - bye; j++)
-		{
-			regionFile(region,cx + i,cz + j);
-			//chunkFile(chunk,cx + i,cz + j);
-
-			sprintf(path, "%s\\region\\%s", base, region);
-
-			int chunkOffset, chunkLength;
-			//chunkPos(path, cx + i,cz + j, &chunkOffset, &chunkLength);
-
-			unsigned char buf[5];
-			int sectorNumber;
-			bool readOk = false;
-			z_stream strm;
-			int status;
-			int pos = 4 * (((cx + i) & 31) + ((cz + j) & 31) * 32);
-			
-
-			chunkOffset = 0;
-
-			FILE* ptr = fopen(path, "rb");
-			if( ptr != NULL )
-			{
-			   if( fseek(ptr,pos,SEEK_SET) == 0 )
-			   {
-				   if( fread(buf, 4, 1, ptr) == 1 )
-				   {
-					   sectorNumber = buf[3];
-					   chunkOffset = buf[0]<<16 | buf[1]<<8 | buf[2];
-
-					   if( chunkOffset != 0 )
-					   {
-						   fseek(ptr, 4096*chunkOffset, SEEK_SET);
-						   if( fread(buf, 5, 1, ptr) == 1 )
-						   {
-							   chunkLength = buf[0]<<24 | buf[1]<<16 | buf[2]<<8 | buf[3];
-
-							   if( (chunkLength <= sectorNumber * 4096) && (chunkLength <= CHUNK_DEFLATE_MAX) && (buf[4] == 2) )
-							   {
-								   if( fread(in, chunkLength - 1, 1, ptr) == 1 )
-								   {
-									   fclose(ptr);
-
-										// decompress chunk
-										strm.zalloc = (alloc_func)NULL;
-										strm.zfree = (free_func)NULL;
-										strm.opaque = NULL;
-
-										strm.next_out = out;
-										strm.avail_out = CHUNK_INFLATE_MAX;
-										strm.avail_in = chunkLength - 1;
-										strm.next_in = in;
-
-										inflateInit(&strm);
-										status = inflate(&strm, Z_FINISH); // decompress in one step
-										inflateEnd(&strm);
-
-										if (status == Z_STREAM_END) 
-										{
-											if( nbt_parse_buffer(nbt, out, strm.avail_out) == NBT_OK )
-											{
-												readOk = true;
-											}
-										}
-								   }
-								   else fclose(ptr);
-							   }
-							   else fclose(ptr);
-						   }
-						   else fclose(ptr);
-					   }
-					   else fclose(ptr);
-				   }
-				   else fclose(ptr);
-			   }
-			   else fclose(ptr);
-			}
-
-			if( chunkOffset == 0 || !readOk )
-			{
-#ifdef _DEBUG
-				printf("No chunk at (%d,%d)\n",cx+i,cz+j);
-#endif
-				// zero out missing chunk
-				for(unsigned int x = 0; x < 16; x++)
-				{
-					for(unsigned int z = 0; z < 16; z++)
-					{
-						for(unsigned int y = 0; y < 128; y++)
-						{
-							unsigned int texPos = (y + (j * 16 + z) * 128 + (i * 16 + x) * 128 * 128) * 4;
-
-							if( texPos > chunkmax * 4 * 64 )
-								printf("Error: Bad position in target texture\n");
-							else
-							{
-								data[texPos] = 0;
-								data[texPos+1] = 0;
-								data[texPos+2] = 0;
-								data[texPos+3] = 0;
-							}
-						}
-					}
-				}
-
-				continue;
-			}
-#ifdef _DEBUG
-			printf("Reading chunk at (%d,%d)...\n",cx+i,cz+j);
-#endif
-			// write chunk colors to float array
-
-			//nbt_compound* rootNode = nbt_cast_compound(nbt->root);
-			nbt_tag *level = nbt_find_tag_by_name("Level", nbt->root);
-            nbt_tag *blocks = nbt_find_tag_by_name("Blocks", level);
-			nbt_tag *sky = nbt_find_tag_by_name("SkyLight", level);
-			nbt_tag *radi = nbt_find_tag_by_name("BlockLight", level);
-			if( blocks == NULL || sky == NULL || radi == NULL )
-			{
-				nbt_free_tag(nbt->root);
-				nbt->root = NULL;
-				continue;
-			}
-			nbt_byte_array* blockArr = nbt_cast_byte_array(blocks);
-			nbt_byte_array* skyArr = nbt_cast_byte_array(sky);
-			nbt_byte_array* radiArr = nbt_cast_byte_array(radi);
-			if( blockArr == NULL || skyArr == NULL || radiArr == NULL )
-			{
-				nbt_free_tag(nbt->root);
-				nbt->root = NULL;
-				continue;
-			}
-
-			// Write blocks to texture	
-			for(unsigned int x = 0; x < 16; x++)
-			{
-				for(unsigned int z = 0; z < 16; z++)
-				{
-					for(unsigned int y = 0; y < 128; y++)
-					{
-						unsigned int texPos = (y + (j * 16 + z) * 128 + (i * 16 + x) * 128 * 128) * 4;
-
-						if( texPos > chunkmax * 4 * 64 )
-						{
-							printf("Error: Bad position in target texture\n");
-						}
-						else
-						{
-							unsigned int bpos = y + z * 128 + x * 128 * 16;
-							unsigned char c = blockArr->content[ bpos ];
-							mc::color bCol = GetColor(c);
-							unsigned char sc = skyArr->content[ bpos / 2 ];
-							unsigned char rc = radiArr->content[ bpos / 2 ];
-
-							if( bpos % 2 == 0 )
-							{
-								sc = LO(sc);
-								rc = LO(rc);
-							}
-							else
-							{
-								sc = HI(sc);
-								rc = HI(rc);
-							}
-
-							float d = (sc / 15.0f);
-							float r = (rc / 15.0f);
-
-							d += r + 0.50f;
-						    if( d > 1 ) d = 1;
-
-							//float d = 1;
-
-							data[texPos] = (char)(((bCol.r / 255.0f) * d) * 255.0f);
-							data[texPos+1] = (char)(((bCol.g / 255.0f) * d) * 255.0f);
-							data[texPos+2] = (char)(((bCol.b / 255.0f) * d) * 255.0f);
-							data[texPos+3] = (char)((bCol.a / 255.0f) * 255.0f * (alphaLight ? d : 1.0f));
-
-							//data[texPos] = (char)rc;
-							//data[texPos+1] = (char)c;
-							//data[texPos+2] = (char)sc;
-						}
-					}
-				}
-			}
-			nbt_free_tag(nbt->root);
-			nbt->root = NULL;
-		}
-	}
-
-	nbt_free(nbt);
+	InitPalette(&palette, nonOreAlpha, alphaLight);
+	LoadVolume(data, base, cx, cz, &palette, bw, bh, bxs, bys, bxe, bye, occupancy, ores,
+	           shadeChannel >= 0 ? shade : NULL);
+	for( unsigned int i = bxs; i < bw - bxe; i++ )
+		for( unsigned int j = bys; j < bh - bye; j++ )
+			freshChunks[i * 8 + j] = true;
 
 	return 1;
 }
 
+// shifts the texture contents by X chunks in the x dimension and Z chunks
+// in the z dimension. Chunks shifted off the grid are dropped, the chunks
+// left uncovered are stale and must be reloaded by the caller.
 void shiftChunks( unsigned char* data, int X, int Z, unsigned int bw, unsigned int bh )
 {
-	unsigned int s = 128 * 128;
-	if( X < 0 )
+	unsigned int s = 128 * 128 * 4;
+	unsigned int row = 128 * 4;
+
+	if( X != 0 && abs(X) < (int)bw )
 	{
-		for( unsigned int y = 0; y < 128; y++)
-		{
-			for( unsigned int z = 0; z < 128; z++)
-			{
-				for( unsigned int x = 16; x < 128; x++)
-				{
-					unsigned int lp = y + z * 128 + (x-16) * s;
-					unsigned int rp = y + z * 128 + x * s;
-					data[lp*4] = data[rp*4];
-					data[lp*4 + 1] = data[rp*4 + 1];
-					data[lp*4 + 2] = data[rp*4 + 2];
-					data[lp*4 + 3] = data[rp*4 + 3];
-				}
-			}
-		}
+		// the x dimension is the slowest varying, so every remaining
+		// column moves in a single block
+		unsigned int n = abs(X) * 16;
+		if( X < 0 )
+			memmove(data, data + n * s, (128 - n) * s);
+		else
+			memmove(data + n * s, data, (128 - n) * s);
 	}
-	else if( X > 0 )
+
+	if( Z != 0 && abs(Z) < (int)bh )
 	{
-		for( unsigned int y = 0; y < 128; y++)
+		unsigned int n = abs(Z) * 16;
+		for( unsigned int x = 0; x < 128; x++)
 		{
-			for( unsigned int z = 0; z < 128; z++)
-			{
-				for( int x = 111; x >= 0; x--)
-				{
-					unsigned int lp = y + z * 128 + (x+16) * s;
-					unsigned int rp = y + z * 128 + x * s;
-					data[lp*4] = data[rp*4];
-					data[lp*4 + 1] = data[rp*4 + 1];
-					data[lp*4 + 2] = data[rp*4 + 2];
-					data[lp*4 + 3] = data[rp*4 + 3];
-				}
-			}
+			unsigned char* plane = data + x * s;
+			if( Z < 0 )
+				memmove(plane, plane + n * row, (128 - n) * row);
+			else
+				memmove(plane + n * row, plane, (128 - n) * row);
 		}
 	}
 
-	if( Z < 0 )
+	// the fresh flags move with their chunks
+	bool moved[64];
+	for( int i = 0; i < (int)bw; i++ )
 	{
-		for( unsigned int y = 0; y < 128; y++)
+		for( int j = 0; j < (int)bh; j++ )
 		{
-			for( unsigned int x = 0; x < 128; x++)
-			{
-				for( unsigned int z = 16; z < 128; z++)
-				{
-					unsigned int lp = y + (z-16) * 128 + x * s;
-					unsigned int rp = y + z * 128 + x * s;
-					data[lp*4] = data[rp*4];
-					data[lp*4 + 1] = data[rp*4 + 1];
-					data[lp*4 + 2] = data[rp*4 + 2];
-					data[lp*4 + 3] = data[rp*4 + 3];
-				}
-			}
+			int si = i - X, sj = j - Z;
+			moved[i * 8 + j] = si >= 0 && si < (int)bw && sj >= 0 && sj < (int)bh && freshChunks[si * 8 + sj];
 		}
 	}
-	else if( Z > 0 )
+	memcpy(freshChunks, moved, sizeof(moved));
+}
+
+// shifts the map by x chunks and z chunks in a single step, reading in only
+// the chunks that were not already in view.
+void ShiftWorld( unsigned char* data, unsigned int w, 
+				 int x, int z, unsigned int bw, unsigned int bh )
+{
+	if( abs(x) >= (int)bw || abs(z) >= (int)bh )
+	{
+		// nothing in view survives the move
+		ReadMineCraft(data,w,bw,bh);
+		return;
+	}
+
+	shiftChunks(data, x, z, bw, bh);
+	occupancy->shift(z * 16, x * 16);
+	ores->shift(x, z);
+	if( shadeChannel >= 0 )
+		shade->shift(z * 16, x * 16);
+
+	// columns of chunks uncovered by the x shift, full height
+	if( x != 0 )
+		ReadMineCraft(data,w,bw,bh,
+		              x < 0 ? bw+x : 0, 0,
+		              x > 0 ? bw-x : 0, 0 );
+
+	// rows of chunks uncovered by the z shift, skipping the
+	// columns which were just read
+	if( z != 0 )
+		ReadMineCraft(data,w,bw,bh,
+		              x > 0 ? x : 0,
+		              z < 0 ? bh+z : 0,
+		              x < 0 ? -x : 0,
+		              z > 0 ? bh-z : 0 );
+}
+
+// recolors the ores of the grid by the vein each belongs to
+void ColorVeins( unsigned char* data )
+{
+	veins.clear();
+	veins.labelGrid(worldDir, cx, cz, 8, 8);
+	veins.merge();
+
+	for( unsigned int i = 0; i < 8; i++ )
 	{
-		for( unsigned int y = 0; y < 128; y++)
+		for( unsigned int j = 0; j < 8; j++ )
 		{
-			for( unsigned int x = 0; x < 128; x++)
+			for( unsigned int x = 0; x < 16; x++ )
 			{
-				for( int z = 111; z >= 0; z--)
+				for( unsigned int z = 0; z < 16; z++ )
 				{
-					unsigned int lp = y + (z+16) * 128 + x * s;
-					unsigned int rp = y + z * 128 + x * s;
-					data[lp*4] = data[rp*4];
-					data[lp*4 + 1] = data[rp*4 + 1];
-					data[lp*4 + 2] = data[rp*4 + 2];
-					data[lp*4 + 3] = data[rp*4 + 3];
+					unsigned char* column = data + ((j * 16 + z) * 128 + (i * 16 + x) * 128 * 128) * 4;
+					for( unsigned int y = 0; y < 128; y++ )
+					{
+						int v = veins.getVein(cx + i, cz + j, ChunkIndex(x, y, z));
+						if( v < 0 )
+							continue;
+
+						// neighbouring vein numbers get unrelated colors
+						unsigned int hash = (v + 1) * 2654435761u;
+						column[y * 4 + 0] = 64 + (hash >> 24) % 192;
+						column[y * 4 + 1] = 64 + (hash >> 16 & 0xff) % 192;
+						column[y * 4 + 2] = 64 + (hash >> 8 & 0xff) % 192;
+					}
 				}
 			}
 		}
 	}
 }
 
-void ShiftWorld( unsigned char* data, unsigned int w, 
-				 int x, int z, unsigned int bw, unsigned int bh )
+// replaces the terrain of the volume with its caves
+void ShowCaves( unsigned char* data )
 {
-	shiftChunks(data, x, z, bw, bh);
-	ReadMineCraft(data,w,bw,bh,
-		          x < 0 ? bw-2 : 0,
-				  z < 0 ? bh-2 : 0,
-				  x > 0 ? bw-1 : 0,
-				  z > 0 ? bh-1 : 0 );
+	caves->extract(worldDir, cx, cz);
+	caves->colorize(data);
+	occupancy->build(data);
+	if( shadeChannel >= 0 )
+		shade->build(data);
+}
+
+// highlights the blocks of the volume changed since the backup
+void ShowChanges( unsigned char* data )
+{
+	WorldDiff diff(backupDir, worldDir);
+	std::vector<ChunkDiff> chunks;
+	std::vector<BlockChange> blocks;
+	diff.diffGrid(cx, cz, 8, 8, &chunks, &blocks);
+	// only the chunks read since the last highlighting are faded
+	HighlightChanges(data, cx, cz, blocks, freshChunks);
+	memset(freshChunks, 0, sizeof(freshChunks));
+	occupancy->build(data);
+	if( shadeChannel >= 0 )
+		shade->build(data);
+	printf("%d chunks changed with %d blocks\n", (int)chunks.size(), (int)blocks.size());
+}
+
+// uploads the volume and its occupancy grid after the chunks change
+void UploadVolume()
+{
+	// the views below read their chunks again, which may have been saved
+	// since the grid was loaded
+	if( caveView || diffView || veinColors )
+		chunkCache.refresh();
+
+	if( caveView )
+		ShowCaves(vData);
+	else if( diffView )
+		ShowChanges(vData);
+	else if( veinColors )
+		ColorVeins(vData);
+	vBuff->setData(vData);
+	volumeRender->updateOccupancy();
+	volumeRender->updateShading();
+	oreRender->update(ores, &palette);
+	sliceStale = true;
+	progressive.restart();
+}
+
+// net movement requested since the last frame, in chunks
+int moveX = 0;
+int moveZ = 0;
+
+// queues a move of the map origin. Moves are coalesced and applied once per
+// frame by ApplyQueuedMove, so opposing or repeated key presses only cost
+// what the final position needs.
+void QueueMove( int dx, int dz )
+{
+	moveX += dx;
+	moveZ += dz;
+}
+
+// folds the queued move into the map origin without reading any chunks,
+// for callers which are about to reload the whole grid anyway
+void DiscardQueuedMove()
+{
+	cx += moveX;
+	cz += moveZ;
+	moveX = 0;
+	moveZ = 0;
+}
+
+// applies the net queued move as a single multi-chunk shift
+void ApplyQueuedMove()
+{
+	if( moveX == 0 && moveZ == 0 )
+		return;
+
+	cx += moveX;
+	cz += moveZ;
+	ShiftWorld(vData, world, -moveX, -moveZ, 8, 8);
+	UploadVolume();
+
+	moveX = 0;
+	moveZ = 0;
 }
 
 void key(unsigned char c, int x, int y)
@@ -992,29 +1319,22 @@ void key(unsigned char c, int x, int y)
             exit(0);
             break;
 		case 'a': // left arrow
-			++cx;
-			ShiftWorld(vData, world, -1,  0, 8, 8);
-			vBuff->setData(vData);
+			QueueMove( 1,  0);
 			break;
 		case 'w': // up arrow
-			--cz;
-			ShiftWorld(vData, world, 0,  1, 8, 8);
-			vBuff->setData(vData);
+			QueueMove( 0, -1);
 			break;
 		case 'd': // right arrow
-			--cx;
-			ShiftWorld(vData, world, 1,  0, 8, 8);
-			vBuff->setData(vData);
+			QueueMove(-1,  0);
 			break;
 		case 's': // down arrow
-			++cz;
-			ShiftWorld(vData, world, 0, -1, 8, 8);
-			vBuff->setData(vData);
+			QueueMove( 0,  1);
 			break;
 		case 'l': // toggle light scan
 			alphaLight = !alphaLight;
+			DiscardQueuedMove();
 			ReadMineCraft(vData, world, 8, 8);
-			vBuff->setData(vData);
+			UploadVolume();
 			break;
 		case '[':
 			density -= 0.01f;
@@ -1030,31 +1350,131 @@ void key(unsigned char c, int x, int y)
 			brightness -= 0.01f;
 			if( brightness < 0 ) brightness = 0;
 			volumeRender->setBrightness(brightness);
+			oreRender->setBrightness(brightness);
+			oreRender->update(ores, &palette);
 			break;
 		case '\'':
 			brightness += 0.01f;
 			if( brightness > 1 ) brightness = 1;
 			volumeRender->setBrightness(brightness);
+			oreRender->setBrightness(brightness);
+			oreRender->update(ores, &palette);
 			break;
 		case ',':
 			nonOreAlpha -= 0.01f;
 			if( nonOreAlpha < 0 ) nonOreAlpha = 0;
+			DiscardQueuedMove();
 			ReadMineCraft(vData, world, 8, 8);
-			vBuff->setData(vData);
+			UploadVolume();
 			break;
 		case '.':
 			nonOreAlpha += 0.01f;
 			if( nonOreAlpha > 1 ) nonOreAlpha = 1;
+			DiscardQueuedMove();
 			ReadMineCraft(vData, world, 8, 8);
-			vBuff->setData(vData);
+			UploadVolume();
 			break;
 		case 'p':
+			moveX = moveZ = 0;
 			ReadMineCraft(vData, world, 8, 8, 0, 0, 0, 0, true);
-			vBuff->setData(vData);
+			UploadVolume();
+			break;
+		case 'v':
+			voxelTraversal = !voxelTraversal;
+			volumeRender->setTraversal(voxelTraversal ? VolumeRender::TRAVERSE_VOXELS : VolumeRender::TRAVERSE_STEPS);
+			break;
+		case 'e':
+			// opaque rays always stop, as nothing more shows through them
+			earlyExit = !earlyExit;
+			volumeRender->setOpacityThreshold(earlyExit ? 0.95f : 1.0f);
+			break;
+		case 'f':
+			// steps grow past the near side of the volume at the start
+			// viewing distance
+			farSteps = !farSteps;
+			volumeRender->setStepDistance(farSteps ? -viewDistance - 0.5f : 0.0f);
+			break;
+		case 'o':
+			oreCubes = !oreCubes;
+			break;
+		case 'k':
+			sliceAxis = sliceAxis + 1 < VolumeSlicer::SLICE_AXES ? sliceAxis + 1 : -1;
+			break;
+		case '-':
+			if( sliceAxis >= 0 )
+				StepSlice(-1);
+			break;
+		case '=':
+			if( sliceAxis >= 0 )
+				StepSlice(1);
+			break;
+		case 'j':
+			if( sliceAxis == VolumeSlicer::SLICE_Y && !sliceScroll ) {
+				sliceScroll = true;
+				glutTimerFunc(SLICE_SCROLL_MS, scrollSlice, ++scrollCount);
+			}
+			else
+				sliceScroll = false;
+			break;
+		case 'x':
+			if( sliceAxis >= 0 )
+				ExportSlice();
+			break;
+		case 'h':
+			// the shade volume went stale while off, so is rebuilt
+			if( shadeChannel < 0 ) {
+				shade->build(vData);
+				printf("Shaded in %.2f ms\n", shade->getUpdateTime());
+			}
+			shadeChannel = shadeChannel + 1 < SHADE_CHANNELS ? shadeChannel + 1 : -1;
+			volumeRender->setShading(shadeChannel >= 0 ? shade : NULL, shadeChannel);
+			break;
+		case 't':
+			// each time on starts again from full quality
+			governed = !governed;
+			if( governed ) {
+				governor.reset();
+				if( !governor.openLog(GOVERNOR_LOG) )
+					printf("Cannot write %s\n", GOVERNOR_LOG);
+			}
+			printf("Governor %s\n", governed ? "on" : "off");
+			break;
+		case 'n':
+			// the ore colors are read back in when turned off
+			veinColors = !veinColors;
+			if( !veinColors )
+				ReadMineCraft(vData, world, 8, 8);
+			UploadVolume();
+			if( veinColors ) {
+				const std::vector<Vein> &found = veins.getVeins();
+				printf("%d veins labeled in %.2f ms\n", (int)found.size(), veins.getLabelTime() + veins.getMergeTime());
+				for( size_t v = 0; v < found.size() && v < 5; v++ )
+					printf("  %s: %lld blocks around %.1f %.1f %.1f\n", mc::MaterialName[found[v].id], found[v].size,
+					       found[v].centroid[0], found[v].centroid[1], found[v].centroid[2]);
+			}
+			break;
+		case 'u':
+			// the terrain is read back in when turned off
+			caveView = !caveView;
+			if( !caveView )
+				ReadMineCraft(vData, world, 8, 8);
+			UploadVolume();
+			if( caveView )
+				printf("%lld cave blocks found in %.2f ms\n", caves->getCaveBlocks(), caves->getUpdateTime());
+			break;
+		case 'b':
+			if( backupDir == NULL ) {
+				printf("No backup world given\n");
+				break;
+			}
+			diffView = !diffView;
+			if( !diffView )
+				ReadMineCraft(vData, world, 8, 8);
+			UploadVolume();
 			break;
     }
 
-    glutPostRedisplay();
+    Redraw();
 }
 
 void mainMenu(int i)
@@ -1087,11 +1507,10 @@ int main(int argc, char** argv)
 			cz = atoi(argv[3]);
 			useSpawn = false;
 		}
+		if( argc > 4 )
+			backupDir = argv[4];
 	}
 
-	QueryPerformanceCounter(&start_time);
-	QueryPerformanceFrequency(&time_freq);
-
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH | GLUT_DOUBLE);
     glutInitWindowSize(width, height);
@@ -1102,7 +1521,6 @@ int main(int argc, char** argv)
     glutReshapeFunc(reshape);
     glutMouseFunc(mouse);
     glutMotionFunc(motion);
-    glutIdleFunc(idle);
 
     initGL();
     initMenus();
@@ -1122,9 +1540,23 @@ int main(int argc, char** argv)
 	vBuff = new VolumeBuffer(GL_RGBA16F_ARB, 128, 128, 128, 1);
 	unsigned int size = 128*128*128*4;
 	vData = new unsigned char[size];
+	occupancy = new OccupancyGrid(128, 128, 128);
+	ores = new OreCloud(8, 8);
+	shade = new ShadeVolume(128, 128, 128);
+	caves = new CaveVolume(8, 8);
+	slicer = new VolumeSlicer(vData, 128, 128, 128);
+	oreRender = new OreRender();
 
 	InitColors();
 	mc::initialize_constants();
+
+	// every ore is a vein of its own, but redstone glows when touched
+	// and is the same vein either way
+	veins.setKeepLabels(true);
+	for( int id = 0; id < BLOCK_IDS; id++ )
+		if( IsOre((unsigned char)id) )
+			veins.setClass(id, id);
+	veins.setClass(74, 73);
 	cBuff = new ImageBuffer(GL_RGBA16F_ARB, 16, 16, 1);
 	cBuff -> setData((unsigned char*)BlockC);
 
@@ -1136,6 +1568,9 @@ int main(int argc, char** argv)
 		volumeRender = new VolumeRender(cgContext, vBuff, cBuff);
 		volumeRender->setDensity(density);
 		volumeRender->setBrightness(brightness);
+		volumeRender->setOccupancy(occupancy);
+		oreRender->setBrightness(brightness);
+		oreRender->update(ores, &palette);
 
 		//setup the option keys
 		optionKeyMap['c'] = OPTION_DRAW_CUBE;
@@ -1144,12 +1579,25 @@ int main(int argc, char** argv)
 		options[OPTION_DRAW_CHUNKS] = false;
 
 		printf( "MineTrace - displaying 64 chunks of selected world\n");
-		printf( "commandline arguements : MineTrace <world number> <NW chunk X> <NW chunk Z>" );
+		printf( "commandline arguements : MineTrace <world number> <NW chunk X> <NW chunk Z> <backup world directory>" );
 		printf( "   q/[ESC]    - Quit the app\n");
 		printf( "      c       - Toggle drawing the extents of the volume in wireframe\n");
 		printf( "      g       - Toggle drawing the extents of chunks in wireframe\n");
 		printf( "      l       - Toggle rendering with opacity lighting \n");
 		printf( "      p       - shift chunk with player position \n");
+		printf( "      v       - Toggle visiting every voxel along the rays \n");
+		printf( "      e       - Toggle stopping rays once nearly opaque \n");
+		printf( "      f       - Toggle longer steps far from the eye \n");
+		printf( "      o       - Toggle drawing only the ores, as cubes \n");
+		printf( "      k       - Cycle slices at a height, a z and an x, and the volume \n");
+		printf( "   - and =    - Move the slice down or up a layer\n");
+		printf( "      j       - Toggle scrolling through the height slices layer by layer\n");
+		printf( "      x       - Export the slice as slice_<axis>_<index>.png\n");
+		printf( "      h       - Cycle shading by occlusion, shadow, both and none \n");
+		printf( "      t       - Toggle holding moving frames to 16 ms, logged to governor.csv \n");
+		printf( "      n       - Toggle coloring each vein of ore apart \n");
+		printf( "      u       - Toggle drawing only the caves and enclosed air \n");
+		printf( "      b       - Toggle highlighting the blocks changed since the backup \n");
 		printf( "   [ and ]    - Change density\n");
 		printf( "   ; and '    - Change brightness\n");
 		printf( "   , and .    - Change alpha for non-ore\n");
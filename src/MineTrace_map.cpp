@@ -0,0 +1,449 @@
+//
+//  Decription: Renders a whole Minecraft World, region file by region file,
+//  into a zoomable pyramid of map tiles on the CPU, without a window, GPU,
+//  Cg or GLUT. Each region is composited top-down (see RegionMap.h) into
+//  one tile of the deepest level, and every coarser level halves four
+//  tiles of the level below into one, up to a single tile for the world.
+//
+//  usage: <MineTrace_map> <world directory> [options]
+//
+//  Options:
+//      -o <directory>       - Output directory (default map)
+//      -density <d>         - Density (default 1.0)
+//      -brightness <b>      - Brightness (default 1.0)
+//      -nonore <a>          - Alpha for non-ore (default 1.0)
+//      -alphalight          - Render with opacity lighting
+//      -threshold <a>       - Stop columns once their opacity reaches a (default 1)
+//      -surface             - Draw only the top block of each column, for quick overviews
+//      -heightmap           - Draw the top block from each chunk's HeightMap, under water and glass
+//      -threads <n>         - Worker threads (default all cores)
+//      -ppm                 - Write PPM tiles instead of PNG
+//      -update              - Only rebuild the tiles over chunks changed since the last run
+//
+//  Tiles are written to <directory>/<zoom>/<x>/<z>.png, zoom 0 being the
+//  whole world in one tile. <directory>/map.txt gives the number of levels,
+//  the tile size and the block at the corner of tile 0 0.
+//
+//  Regions are split into subtrees of the pyramid which render on the
+//  worker threads, so only a few tiles per worker are held at once however
+//  large the world is.
+//
+//  <directory>/manifest.txt keeps the timestamp of every chunk from the
+//  region file headers. With -update, chunks whose timestamps are unchanged
+//  are not decoded again: only the tiles over changed chunks and the tiles
+//  above them are rebuilt, reading their unchanged neighbours back from
+//  disk. A change of the options or of the extent of the world rebuilds
+//  everything.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "ImageWriter.h"
+#include "RegionManifest.h"
+#include "RegionMap.h"
+#include "TaskPool.h"
+#include "VolumeLoader.h"
+#include "blocks.hpp"
+
+typedef std::pair<int, int> TileCoord;
+typedef std::vector<unsigned char> TileImage;
+
+struct ChunkFlags {
+    bool changed[REGION_CHUNK_COUNT];
+};
+
+const size_t TILE_BYTES = (size_t)REGION_SIZE * REGION_SIZE * 3;
+
+// state shared by the tasks building the pyramid
+struct MapJob {
+    const char *world;
+    const char *output;
+    const char *extension;
+    const VolumePalette *palette;
+    MapSettings settings;
+
+    int levels;                             // zoom levels, 0 the coarsest
+    int originX, originZ;                   // region of tile 0 0 of the deepest level
+    std::vector< std::set<TileCoord> > tiles;   // tiles with regions under them, per level
+    std::vector< std::set<TileCoord> > dirty;   // tiles to build, per level
+    std::map<TileCoord, ChunkFlags> redraw;     // regions to update chunk by chunk
+    std::vector<ChunkData*> chunks;         // scratch per worker
+
+    std::atomic<int> found, written, failed;
+};
+
+void usage()
+{
+    printf( "usage : MineTrace_map <world directory> [options]\n");
+    printf( "   -o <directory>       - Output directory\n");
+    printf( "   -density <d>         - Density\n");
+    printf( "   -brightness <b>      - Brightness\n");
+    printf( "   -nonore <a>          - Alpha for non-ore\n");
+    printf( "   -alphalight          - Render with opacity lighting\n");
+    printf( "   -threshold <a>       - Stop columns once their opacity reaches a\n");
+    printf( "   -surface             - Draw only the top block of each column, for quick overviews\n");
+    printf( "   -heightmap           - Draw the top block from each chunk's HeightMap, under water and glass\n");
+    printf( "   -threads <n>         - Worker threads\n");
+    printf( "   -ppm                 - Write PPM tiles instead of PNG\n");
+    printf( "   -update              - Only rebuild the tiles over changed chunks\n");
+}
+
+// creates a directory, succeeding if it already exists
+bool MakeDirectory(const char *path)
+{
+#ifdef _WIN32
+    int status = _mkdir(path);
+#else
+    int status = mkdir(path, 0777);
+#endif
+    return status == 0 || errno == EEXIST;
+}
+
+void TilePath(const MapJob &job, int zoom, int x, int z, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%d/%d/%d.%s", job.output, zoom, x, z, job.extension);
+}
+
+// reads a tile written by an earlier run
+bool ReadTile(const MapJob &job, int zoom, int x, int z, TileImage &image)
+{
+    char path[1024];
+    TilePath(job, zoom, x, z, path, sizeof(path));
+    image.resize(TILE_BYTES);
+    return ReadImage(path, &image[0], REGION_SIZE, REGION_SIZE) != 0;
+}
+
+void WriteTile(MapJob &job, int zoom, int x, int z, const TileImage &image)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%d/%d", job.output, zoom, x);
+    MakeDirectory(path);
+    TilePath(job, zoom, x, z, path, sizeof(path));
+
+    if( WriteImage(path, &image[0], REGION_SIZE, REGION_SIZE) )
+        job.written++;
+    else {
+        printf("Cannot write %s\n", path);
+        job.failed++;
+    }
+}
+
+// renders tile (x,z) of a zoom level into image and writes it. The deepest
+// level renders its region, redrawing only its changed chunks over the old
+// tile if it has some. The others halve their four children: dirty ones
+// are taken from roots at level split or built recursively, the rest are
+// read back. force rebuilds the whole subtree, for tiles missing on disk.
+void BuildTile(MapJob &job, int zoom, int x, int z, int worker, int split,
+               std::map<TileCoord, TileImage> *roots, TileImage &image, bool force = false)
+{
+    TileCoord tile(x, z);
+
+    if( zoom == job.levels - 1 )
+    {
+        const bool *redraw = NULL;
+        std::map<TileCoord, ChunkFlags>::const_iterator r = job.redraw.find(tile);
+        if( !force && r != job.redraw.end() && ReadTile(job, zoom, x, z, image) )
+            redraw = r->second.changed;
+        else
+            image.assign(TILE_BYTES, 0);
+
+        RegionCoord region = { x + job.originX, z + job.originZ };
+        job.found += RenderRegionMap(job.world, region, job.palette, job.settings,
+                                     job.chunks[worker], &image[0], redraw);
+    }
+    else
+    {
+        image.assign(TILE_BYTES, 0);
+
+        TileImage child;
+        for(int q = 0; q < 4; q++)
+        {
+            TileCoord c(2 * x + (q & 1), 2 * z + (q >> 1));
+            if( job.tiles[zoom + 1].count(c) == 0 )
+                continue;
+
+            if( roots != NULL && zoom + 1 == split && roots->count(c) != 0 ) {
+                DownsampleQuadrant(&(*roots)[c][0], REGION_SIZE, &image[0], q & 1, q >> 1);
+                continue;
+            }
+
+            if( force || job.dirty[zoom + 1].count(c) != 0 )
+                BuildTile(job, zoom + 1, c.first, c.second, worker, split, roots, child, force);
+            else if( !ReadTile(job, zoom + 1, c.first, c.second, child) )
+                BuildTile(job, zoom + 1, c.first, c.second, worker, split, roots, child, true);
+            DownsampleQuadrant(&child[0], REGION_SIZE, &image[0], q & 1, q >> 1);
+        }
+    }
+
+    WriteTile(job, zoom, x, z, image);
+}
+
+int main(int argc, char** argv)
+{
+    if( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+
+    const char *world = argv[1];
+    const char *output = "map";
+    float density = 1.0f, brightness = 1.0f, nonOreAlpha = 1.0f;
+    float threshold = 1.0f;
+    bool alphaLight = false, ppm = false, update = false;
+    bool surface = false, heightMap = false;
+    int threads = 0;
+
+    for(int a = 2; a < argc; a++)
+    {
+        int left = argc - a - 1;
+        if( strcmp(argv[a], "-o") == 0 && left >= 1 )
+            output = argv[++a];
+        else if( strcmp(argv[a], "-density") == 0 && left >= 1 )
+            density = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-brightness") == 0 && left >= 1 )
+            brightness = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-nonore") == 0 && left >= 1 )
+            nonOreAlpha = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-alphalight") == 0 )
+            alphaLight = true;
+        else if( strcmp(argv[a], "-threshold") == 0 && left >= 1 )
+            threshold = (float)atof(argv[++a]);
+        else if( strcmp(argv[a], "-surface") == 0 )
+            surface = true;
+        else if( strcmp(argv[a], "-heightmap") == 0 )
+            surface = heightMap = true;
+        else if( strcmp(argv[a], "-threads") == 0 && left >= 1 )
+            threads = atoi(argv[++a]);
+        else if( strcmp(argv[a], "-ppm") == 0 )
+            ppm = true;
+        else if( strcmp(argv[a], "-update") == 0 )
+            update = true;
+        else {
+            printf("Unknown option %s\n", argv[a]);
+            usage();
+            return 1;
+        }
+    }
+
+    std::vector<RegionCoord> regions;
+    if( !ListRegions(world, &regions) )
+    {
+        printf("Cannot read the region directory of %s\n", world);
+        return 1;
+    }
+    if( regions.empty() )
+    {
+        printf("No region files in %s/region\n", world);
+        return 1;
+    }
+
+    // tiles count from the north west region, so each tile's children are
+    // 2x and 2x+1, with levels until every region falls into one tile
+    int minX = regions[0].x, maxX = minX, minZ = regions[0].z, maxZ = minZ;
+    for(size_t r = 1; r < regions.size(); r++)
+    {
+        if( regions[r].x < minX ) minX = regions[r].x;
+        if( regions[r].x > maxX ) maxX = regions[r].x;
+        if( regions[r].z < minZ ) minZ = regions[r].z;
+        if( regions[r].z > maxZ ) maxZ = regions[r].z;
+    }
+    int top = 0;
+    while( ((maxX - minX) >> top) != 0 || ((maxZ - minZ) >> top) != 0 )
+        top++;
+
+    VolumePalette palette;
+    mc::initialize_constants();
+    InitPalette(&palette, nonOreAlpha, alphaLight);
+
+    MapJob job;
+    job.world = world;
+    job.output = output;
+    job.extension = ppm ? "ppm" : "png";
+    job.palette = &palette;
+    job.settings.density = density;
+    job.settings.brightness = brightness;
+    job.settings.threshold = threshold;
+    job.settings.surface = surface;
+    job.settings.heightMap = heightMap;
+    job.levels = top + 1;
+    job.originX = minX;
+    job.originZ = minZ;
+    job.tiles.resize(job.levels);
+    job.dirty.resize(job.levels);
+    job.found = 0;
+    job.written = 0;
+    job.failed = 0;
+
+    for(size_t r = 0; r < regions.size(); r++)
+    {
+        int x = regions[r].x - job.originX, z = regions[r].z - job.originZ;
+        for(int zoom = 0; zoom < job.levels; zoom++)
+            job.tiles[zoom].insert(TileCoord(x >> (top - zoom), z >> (top - zoom)));
+    }
+
+    // everything the tiles depend on besides the chunks, so a run with other
+    // options or over a world which has grown starts over
+    RegionManifest before, after;
+    char settings[512];
+    snprintf(settings, sizeof(settings),
+             "density %g brightness %g nonore %g alphalight %d threshold %g surface %d heightmap %d format %s levels %d origin %d %d",
+             density, brightness, nonOreAlpha, alphaLight ? 1 : 0, threshold, surface ? 1 : 0, heightMap ? 1 : 0, job.extension,
+             job.levels, job.originX, job.originZ);
+    after.settings = settings;
+    ScanRegionManifest(world, regions, &after);
+
+    char manifestPath[1024];
+    snprintf(manifestPath, sizeof(manifestPath), "%s/manifest.txt", output);
+    bool incremental = update && LoadRegionManifest(manifestPath, &before) &&
+                       before.settings == after.settings;
+    if( update && !incremental )
+        printf("No manifest for these options in %s, rebuilding every tile\n", output);
+
+    // the tiles of changed regions are dirty, and so is every tile above them
+    int changedRegions = 0, changedChunks = 0;
+    for(size_t r = 0; r < regions.size(); r++)
+    {
+        TileCoord tile(regions[r].x - job.originX, regions[r].z - job.originZ);
+        if( incremental )
+        {
+            ChunkFlags flags;
+            int count = ChangedChunks(before, after, regions[r], flags.changed);
+            if( count == 0 )
+                continue;
+            if( count < REGION_CHUNK_COUNT )
+                job.redraw[tile] = flags;
+            changedChunks += count;
+        }
+        else
+            changedChunks += REGION_CHUNK_COUNT;
+
+        changedRegions++;
+        for(int zoom = 0; zoom < job.levels; zoom++)
+            job.dirty[zoom].insert(TileCoord(tile.first >> (top - zoom), tile.second >> (top - zoom)));
+    }
+
+    // tiles of regions which were deleted go, and the tiles above them are
+    // rebuilt if they still have other regions under them
+    std::map< std::pair<int, int>, std::vector<unsigned int> >::const_iterator old;
+    for(old = before.regions.begin(); incremental && old != before.regions.end(); ++old)
+    {
+        int x = old->first.first - job.originX, z = old->first.second - job.originZ;
+        if( job.tiles[top].count(TileCoord(x, z)) != 0 )
+            continue;
+
+        for(int zoom = 0; zoom < job.levels; zoom++)
+        {
+            TileCoord tile(x >> (top - zoom), z >> (top - zoom));
+            if( job.tiles[zoom].count(tile) != 0 )
+                job.dirty[zoom].insert(tile);
+            else {
+                char path[1024];
+                TilePath(job, zoom, tile.first, tile.second, path, sizeof(path));
+                remove(path);
+            }
+        }
+    }
+
+    if( !MakeDirectory(output) )
+    {
+        printf("Cannot create %s\n", output);
+        return 1;
+    }
+    for(int zoom = 0; zoom < job.levels; zoom++)
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%d", output, zoom);
+        MakeDirectory(path);
+    }
+
+    TaskPool &pool = TaskPool::shared();
+    if( threads > 0 )
+        pool.reserve(threads);
+    int workers = threads > 0 ? threads : pool.getThreadCount();
+    job.chunks.resize(pool.getThreadCount(), (ChunkData*)NULL);
+    for(size_t w = 0; w < job.chunks.size(); w++)
+        job.chunks[w] = new ChunkData;
+
+    // the coarsest level with enough tiles to keep every worker busy splits
+    // the pyramid: the workers build the subtrees below its tiles, holding
+    // a tile per level they are in, and the levels above are built from the
+    // subtree roots once they are all done
+    size_t enough = 2 * (size_t)workers;
+    if( enough > job.dirty[top].size() )
+        enough = job.dirty[top].size();
+    int split = 0;
+    while( split < top && job.dirty[split].size() < enough )
+        split++;
+
+    std::vector<TileCoord> subtrees(job.dirty[split].begin(), job.dirty[split].end());
+    std::vector<TileImage> subtreeImages(subtrees.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    pool.parallelFor((int)subtrees.size(), [&](int task, int worker) {
+        BuildTile(job, split, subtrees[task].first, subtrees[task].second, worker,
+                  split, NULL, subtreeImages[task]);
+    }, threads);
+
+    if( split > 0 && !job.dirty[0].empty() )
+    {
+        std::map<TileCoord, TileImage> roots;
+        for(size_t t = 0; t < subtrees.size(); t++)
+            roots[subtrees[t]].swap(subtreeImages[t]);
+
+        TileImage image;
+        BuildTile(job, 0, 0, 0, 0, split, &roots, image);
+    }
+
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(size_t w = 0; w < job.chunks.size(); w++)
+        delete job.chunks[w];
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/map.txt", output);
+    FILE *f = fopen(path, "w");
+    if( f != NULL )
+    {
+        fprintf(f, "levels %d\n", job.levels);
+        fprintf(f, "tilesize %d\n", REGION_SIZE);
+        fprintf(f, "origin %d %d\n", job.originX * REGION_SIZE, job.originZ * REGION_SIZE);
+        fclose(f);
+    }
+    else {
+        printf("Cannot write %s\n", path);
+        job.failed++;
+    }
+
+    // a failed run keeps the old manifest, so the next one tries again
+    if( job.failed == 0 && !SaveRegionManifest(manifestPath, after) )
+    {
+        printf("Cannot write %s\n", manifestPath);
+        job.failed++;
+    }
+
+    printf("Rendered %d of %d regions (%d chunks changed, %d found) into %d tiles over %d levels in %.2f s (%d threads)\n",
+           changedRegions, (int)regions.size(), changedChunks, (int)job.found, (int)job.written,
+           job.levels, total, workers);
+
+    mc::deinitialize_constants();
+
+    return job.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+//
+//  Decription: Counts every block of a whole Minecraft World by block id and
+//  height, such as how many diamonds there are and at which heights, on the
+//  CPU without a window, GPU, Cg or GLUT. Region files are read one after
+//  another, with the chunks of each decoded on the worker threads, so memory
+//  does not grow with the size of the world. Worlds in the old per-chunk
+//  format are read one directory of chunks at a time.
+//
+//  usage: <MineTrace_stats> <world directory> [options]
+//
+//  Options:
+//      -o <file>            - Output file, JSON if it ends in .json and CSV otherwise (default blocks.csv)
+//      -block <id>          - Only write this block id, may be given again for more (default all)
+//      -regions             - Also write the counts of each region file
+//      -old                 - Read the old per-chunk format even if there are region files
+//      -veins <id[,id...]>  - Also find the veins of these block ids, touching blocks of any of them
+//                             being one vein; may be given again for veins of other blocks
+//      -veinout <file>      - Vein output file (default veins.csv)
+//      -threads <n>         - Worker threads (default all cores)
+//
+//  The CSV has a row of scope,id,name,y,count for every block id and height
+//  with blocks, scope being "world" or the region file as r.x.z. The JSON
+//  holds the same counts as
+//
+//      { "regions": [ { "x": 0, "z": 0, "chunks": 1024, "blocks": { ... } }, ... ],
+//        "world": { "chunks": 1024, "blocks": { ... } } }
+//
+//  with blocks of the form "56": { "name": "DiamondOre", "total": 3,
+//  "heights": { "11": 2, "12": 1 } }. Chunks of this age store no biomes, so
+//  the counts are only split by region.
+//
+//  Veins (see VeinLabeler.h) are written largest first as rows of
+//  vein,id,name,size,minx,miny,minz,maxx,maxy,maxz,cx,cy,cz, the bounding
+//  box inclusive and the centroid in world blocks, y the height. They are
+//  only found in worlds with region files.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "BlockHistogram.h"
+#include "TaskPool.h"
+#include "VeinLabeler.h"
+#include "blocks.hpp"
+
+// directories of the old per-chunk format on each axis
+const int OLD_DIRECTORIES = 64;
+
+// an output file and the blocks to write to it
+struct StatsFile {
+    FILE *f;
+    bool json;
+    bool selected[BLOCK_IDS];
+    int regions;    // regions written so far, for the commas of JSON
+};
+
+void usage()
+{
+    printf( "usage : MineTrace_stats <world directory> [options]\n");
+    printf( "   -o <file>            - Output file, JSON if it ends in .json and CSV otherwise\n");
+    printf( "   -block <id>          - Only write this block id, may be given again for more\n");
+    printf( "   -regions             - Also write the counts of each region file\n");
+    printf( "   -old                 - Read the old per-chunk format even if there are region files\n");
+    printf( "   -veins <id[,id...]>  - Also find the veins of these block ids, may be given again\n");
+    printf( "   -veinout <file>      - Vein output file\n");
+    printf( "   -threads <n>         - Worker threads\n");
+}
+
+const char *BlockName(int id)
+{
+    return id < mc::MaterialCount ? mc::MaterialName[id] : "None";
+}
+
+bool OpenStats(StatsFile &file, const char *path)
+{
+    size_t length = strlen(path);
+    file.json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+    file.regions = 0;
+    file.f = fopen(path, "w");
+    if( file.f == NULL )
+        return false;
+
+    if( file.json )
+        fprintf(file.f, "{\n  \"regions\": [");
+    else
+        fprintf(file.f, "scope,id,name,y,count\n");
+    return true;
+}
+
+// the counts of a histogram as CSV rows of one scope
+void WriteRows(StatsFile &file, const char *scope, const BlockHistogram &histogram)
+{
+    for(int id = 0; id < BLOCK_IDS; id++)
+    {
+        if( !file.selected[id] )
+            continue;
+        for(int y = 0; y < CHUNK_HEIGHT; y++)
+            if( histogram.get(id, y) > 0 )
+                fprintf(file.f, "%s,%d,%s,%d,%llu\n", scope, id, BlockName(id), y, histogram.get(id, y));
+    }
+}
+
+// the chunks and blocks members of a JSON object
+void WriteObject(StatsFile &file, const BlockHistogram &histogram, const char *indent)
+{
+    fprintf(file.f, "\"chunks\": %lld, \"blocks\": {", histogram.getChunks());
+
+    bool first = true;
+    for(int id = 0; id < BLOCK_IDS; id++)
+    {
+        unsigned long long total = histogram.getTotal(id);
+        if( !file.selected[id] || total == 0 )
+            continue;
+
+        fprintf(file.f, "%s\n%s  \"%d\": { \"name\": \"%s\", \"total\": %llu, \"heights\": {",
+                first ? "" : ",", indent, id, BlockName(id), total);
+        bool firstHeight = true;
+        for(int y = 0; y < CHUNK_HEIGHT; y++)
+        {
+            if( histogram.get(id, y) == 0 )
+                continue;
+            fprintf(file.f, "%s \"%d\": %llu", firstHeight ? "" : ",", y, histogram.get(id, y));
+            firstHeight = false;
+        }
+        fprintf(file.f, " } }");
+        first = false;
+    }
+    if( !first )
+        fprintf(file.f, "\n%s", indent);
+    fprintf(file.f, "}");
+}
+
+void WriteRegion(StatsFile &file, const RegionCoord &region, const BlockHistogram &histogram)
+{
+    if( file.json )
+    {
+        fprintf(file.f, "%s\n    { \"x\": %d, \"z\": %d, ", file.regions > 0 ? "," : "", region.x, region.z);
+        WriteObject(file, histogram, "    ");
+        fprintf(file.f, " }");
+    }
+    else
+    {
+        char scope[64];
+        snprintf(scope, sizeof(scope), "r.%d.%d", region.x, region.z);
+        WriteRows(file, scope, histogram);
+    }
+    file.regions++;
+}
+
+bool WriteVeins(const char *path, const std::vector<Vein> &veins)
+{
+    FILE *f = fopen(path, "w");
+    if( f == NULL )
+        return false;
+
+    fprintf(f, "vein,id,name,size,minx,miny,minz,maxx,maxy,maxz,cx,cy,cz\n");
+    for(size_t v = 0; v < veins.size(); v++)
+    {
+        const Vein &vein = veins[v];
+        fprintf(f, "%d,%d,%s,%lld,%d,%d,%d,%d,%d,%d,%.2f,%.2f,%.2f\n", (int)v, vein.id, BlockName(vein.id), vein.size,
+                vein.lo[0], vein.lo[1], vein.lo[2], vein.hi[0], vein.hi[1], vein.hi[2],
+                vein.centroid[0], vein.centroid[1], vein.centroid[2]);
+    }
+
+    bool ok = ferror(f) == 0;
+    return fclose(f) == 0 && ok;
+}
+
+// writes the counts of the whole world and closes the file
+bool CloseStats(StatsFile &file, const BlockHistogram &world)
+{
+    if( file.json )
+    {
+        fprintf(file.f, "%s],\n  \"world\": { ", file.regions > 0 ? "\n  " : "");
+        WriteObject(file, world, "  ");
+        fprintf(file.f, " }\n}\n");
+    }
+    else
+        WriteRows(file, "world", world);
+
+    bool ok = ferror(file.f) == 0;
+    return fclose(file.f) == 0 && ok;
+}
+
+int main(int argc, char** argv)
+{
+    if( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+
+    const char *world = argv[1];
+    const char *output = "blocks.csv";
+    const char *veinOutput = "veins.csv";
+    bool perRegion = false, old = false;
+    int threads = 0, classes = 0;
+    std::vector<int> blocks;
+    VeinLabeler labeler;
+
+    for(int a = 2; a < argc; a++)
+    {
+        int left = argc - a - 1;
+        if( strcmp(argv[a], "-o") == 0 && left >= 1 )
+            output = argv[++a];
+        else if( strcmp(argv[a], "-block") == 0 && left >= 1 )
+            blocks.push_back(atoi(argv[++a]));
+        else if( strcmp(argv[a], "-regions") == 0 )
+            perRegion = true;
+        else if( strcmp(argv[a], "-old") == 0 )
+            old = true;
+        else if( strcmp(argv[a], "-veins") == 0 && left >= 1 ) {
+            // each option is a class of its own
+            classes++;
+            for(char *id = strtok(argv[++a], ","); id != NULL; id = strtok(NULL, ","))
+            {
+                int n = atoi(id);
+                if( n <= 0 || n >= BLOCK_IDS ) {
+                    usage();
+                    return 1;
+                }
+                labeler.setClass(n, classes);
+            }
+        }
+        else if( strcmp(argv[a], "-veinout") == 0 && left >= 1 )
+            veinOutput = argv[++a];
+        else if( strcmp(argv[a], "-threads") == 0 && left >= 1 )
+            threads = atoi(argv[++a]);
+        else {
+            printf("Unknown option %s\n", argv[a]);
+            usage();
+            return 1;
+        }
+    }
+
+    StatsFile file;
+    for(int id = 0; id < BLOCK_IDS; id++)
+        file.selected[id] = blocks.empty();
+    for(size_t b = 0; b < blocks.size(); b++)
+    {
+        if( blocks[b] < 0 || blocks[b] >= BLOCK_IDS ) {
+            usage();
+            return 1;
+        }
+        file.selected[blocks[b]] = true;
+    }
+
+    std::vector<RegionCoord> regions;
+    if( !old && !ListRegions(world, &regions) )
+        regions.clear();
+
+    mc::initialize_constants();
+
+    if( !OpenStats(file, output) )
+    {
+        printf("Cannot write %s\n", output);
+        mc::deinitialize_constants();
+        return 1;
+    }
+
+    TaskPool &pool = TaskPool::shared();
+    if( threads > 0 )
+        pool.reserve(threads);
+    int workers = threads > 0 ? threads : pool.getThreadCount();
+
+    BlockCounter counter;
+    counter.setThreads(threads);
+    labeler.setThreads(threads);
+    BlockHistogram total, region;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // labelling reads the regions again, its time is kept out of chunks/s
+    double labelSeconds = 0.0;
+
+    // without region files the world is in the old format, whose chunks
+    // are spread over directories by their position modulo 64
+    if( !regions.empty() )
+    {
+        for(size_t r = 0; r < regions.size(); r++)
+        {
+            region.clear();
+            counter.countRegion(world, regions[r], &region);
+            if( perRegion && region.getChunks() > 0 )
+                WriteRegion(file, regions[r], region);
+            total.add(region);
+            if( classes > 0 )
+            {
+                std::chrono::steady_clock::time_point labelStart = std::chrono::steady_clock::now();
+                labeler.labelRegion(world, regions[r]);
+                labelSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - labelStart).count();
+            }
+        }
+    }
+    else
+    {
+        for(int xt = 0; xt < OLD_DIRECTORIES; xt++)
+            for(int zt = 0; zt < OLD_DIRECTORIES; zt++)
+                counter.countOldDirectory(world, xt, zt, &total);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - labelSeconds;
+
+    int ok = CloseStats(file, total);
+    if( !ok )
+        printf("Cannot write %s\n", output);
+
+    if( classes > 0 && regions.empty() )
+        printf("Veins are only found in worlds with region files\n");
+    else if( classes > 0 )
+    {
+        labeler.merge();
+        if( !WriteVeins(veinOutput, labeler.getVeins()) ) {
+            printf("Cannot write %s\n", veinOutput);
+            ok = 0;
+        }
+    }
+
+    char source[64];
+    if( regions.empty() )
+        snprintf(source, sizeof(source), "the old format");
+    else
+        snprintf(source, sizeof(source), "%d region files", (int)regions.size());
+    printf("Counted %lld chunks of %s in %.2f s, %.0f chunks/s (%d threads)\n", total.getChunks(), source,
+           seconds, seconds > 0.0 ? total.getChunks() / seconds : 0.0, workers);
+    for(size_t b = 0; b < blocks.size(); b++)
+    {
+        // the height holding most of the blocks, for a quick answer
+        int id = blocks[b], peak = 0;
+        for(int y = 1; y < CHUNK_HEIGHT; y++)
+            if( total.get(id, y) > total.get(id, peak) )
+                peak = y;
+        printf("%s: %llu blocks, most at height %d\n", BlockName(id), total.getTotal(id), peak);
+    }
+    if( classes > 0 && !regions.empty() )
+    {
+        const std::vector<Vein> &veins = labeler.getVeins();
+        printf("%d veins labeled in %.2f s and merged in %.2f ms\n", (int)veins.size(),
+               labelSeconds, labeler.getMergeTime());
+        for(size_t v = 0; v < veins.size() && v < 5; v++)
+            printf("  %s: %lld blocks around %.1f %.1f %.1f\n", BlockName(veins[v].id), veins[v].size,
+                   veins[v].centroid[0], veins[v].centroid[1], veins[v].centroid[2]);
+    }
+
+    mc::deinitialize_constants();
+
+    return ok ? 0 : 1;
+}
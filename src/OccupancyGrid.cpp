@@ -0,0 +1,198 @@
+//
+// min/max alpha of the volume over bricks and chunks, for empty space skipping
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "OccupancyGrid.h"
+
+// a cell which has not been scanned yet, treated as occupied
+static const unsigned int UNKNOWN_CELL = 0xff;
+
+OccupancyGrid::OccupancyGrid(int width, int height, int depth)
+    : m_width(width),
+      m_height(height),
+      m_depth(depth)
+{
+    int size[3] = { width, height, depth };
+
+    for(int l = 0; l < OCCUPANCY_LEVELS; l++)
+    {
+        OccupancyLevel &level = m_levels[l];
+        for(int k = 0; k < 3; k++)
+        {
+            level.shift[k] = 3 + l;
+            level.dims[k] = (size[k] + (1 << level.shift[k]) - 1) >> level.shift[k];
+        }
+
+        int count = level.dims[0] * level.dims[1] * level.dims[2];
+        level.cells = new unsigned int[count];
+        for(int i = 0; i < count; i++)
+            level.cells[i] = UNKNOWN_CELL;
+    }
+}
+
+OccupancyGrid::~OccupancyGrid()
+{
+    for(int l = 0; l < OCCUPANCY_LEVELS; l++)
+        delete[] m_levels[l].cells;
+}
+
+void
+OccupancyGrid::build(const unsigned char *volume)
+{
+    update(volume, 0, 0, 0, m_width, m_height, m_depth);
+}
+
+void
+OccupancyGrid::update(const unsigned char *volume, int x0, int y0, int z0, int x1, int y1, int z1)
+{
+    updateBricks(volume, x0, y0, z0, x1, y1, z1);
+    updateCoarse(x0, y0, z0, x1, y1, z1);
+}
+
+void
+OccupancyGrid::updateBricks(const unsigned char *volume, int x0, int y0, int z0, int x1, int y1, int z1)
+{
+    if( !clip(x0, y0, z0, x1, y1, z1) )
+        return;
+
+    int c0[3], c1[3];
+    cellRange(OCCUPANCY_BRICK, x0, y0, z0, x1, y1, z1, c0, c1);
+    scanBricks(volume, c0[0], c0[1], c0[2], c1[0], c1[1], c1[2]);
+}
+
+void
+OccupancyGrid::updateCoarse(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+    if( !clip(x0, y0, z0, x1, y1, z1) )
+        return;
+
+    for(int l = 1; l < OCCUPANCY_LEVELS; l++)
+    {
+        int c0[3], c1[3];
+        cellRange(l, x0, y0, z0, x1, y1, z1, c0, c1);
+        updateLevel(l, c0[0], c0[1], c0[2], c1[0], c1[1], c1[2]);
+    }
+}
+
+// clamps texels [x0,x1) x [y0,y1) x [z0,z1) to the volume, false if empty
+bool
+OccupancyGrid::clip(int &x0, int &y0, int &z0, int &x1, int &y1, int &z1) const
+{
+    if( x0 < 0 ) x0 = 0;
+    if( y0 < 0 ) y0 = 0;
+    if( z0 < 0 ) z0 = 0;
+    if( x1 > m_width ) x1 = m_width;
+    if( y1 > m_height ) y1 = m_height;
+    if( z1 > m_depth ) z1 = m_depth;
+    return x0 < x1 && y0 < y1 && z0 < z1;
+}
+
+// cells [c0,c1) of level l touching the texels
+void
+OccupancyGrid::cellRange(int l, int x0, int y0, int z0, int x1, int y1, int z1, int c0[3], int c1[3]) const
+{
+    const int *s = m_levels[l].shift;
+    c0[0] = x0 >> s[0];
+    c0[1] = y0 >> s[1];
+    c0[2] = z0 >> s[2];
+    c1[0] = ((x1 - 1) >> s[0]) + 1;
+    c1[1] = ((y1 - 1) >> s[1]) + 1;
+    c1[2] = ((z1 - 1) >> s[2]) + 1;
+}
+
+void
+OccupancyGrid::scanBricks(const unsigned char *volume, int bx0, int by0, int bz0, int bx1, int by1, int bz1)
+{
+    const OccupancyLevel &bricks = m_levels[OCCUPANCY_BRICK];
+    const int *s = bricks.shift;
+
+    for(int bz = bz0; bz < bz1; bz++)
+    for(int by = by0; by < by1; by++)
+    for(int bx = bx0; bx < bx1; bx++)
+    {
+        int xe = (bx + 1) << s[0], ye = (by + 1) << s[1], ze = (bz + 1) << s[2];
+        if( xe > m_width ) xe = m_width;
+        if( ye > m_height ) ye = m_height;
+        if( ze > m_depth ) ze = m_depth;
+
+        unsigned char hi = 0, lo = 255;
+        for(int z = bz << s[2]; z < ze; z++)
+        {
+            for(int y = by << s[1]; y < ye; y++)
+            {
+                const unsigned char *texel = volume + (((size_t)z * m_height + y) * m_width + (bx << s[0])) * 4;
+                for(int x = bx << s[0]; x < xe; x++, texel += 4)
+                {
+                    if( texel[3] > hi ) hi = texel[3];
+                    if( texel[3] < lo ) lo = texel[3];
+                }
+            }
+        }
+
+        bricks.cells[(bz * bricks.dims[1] + by) * bricks.dims[0] + bx] = hi | (lo << 8);
+    }
+}
+
+// combines the 2x2x2 cells of level l - 1 below each cell of level l
+void
+OccupancyGrid::updateLevel(int l, int cx0, int cy0, int cz0, int cx1, int cy1, int cz1)
+{
+    const OccupancyLevel &fine = m_levels[l - 1];
+    const OccupancyLevel &level = m_levels[l];
+
+    for(int cz = cz0; cz < cz1; cz++)
+    for(int cy = cy0; cy < cy1; cy++)
+    for(int cx = cx0; cx < cx1; cx++)
+    {
+        unsigned char hi = 0, lo = 255;
+        for(int fz = cz * 2; fz < cz * 2 + 2 && fz < fine.dims[2]; fz++)
+        for(int fy = cy * 2; fy < cy * 2 + 2 && fy < fine.dims[1]; fy++)
+        for(int fx = cx * 2; fx < cx * 2 + 2 && fx < fine.dims[0]; fx++)
+        {
+            unsigned int cell = fine.cells[(fz * fine.dims[1] + fy) * fine.dims[0] + fx];
+            if( OccupancyMax(cell) > hi ) hi = OccupancyMax(cell);
+            if( OccupancyMin(cell) < lo ) lo = OccupancyMin(cell);
+        }
+
+        level.cells[(cz * level.dims[1] + cy) * level.dims[0] + cx] = hi | (lo << 8);
+    }
+}
+
+void
+OccupancyGrid::shift(int dy, int dz)
+{
+    const OccupancyLevel &bricks = m_levels[OCCUPANCY_BRICK];
+    const int *d = bricks.dims;
+    int sy = dy >> bricks.shift[1];
+    int sz = dz >> bricks.shift[2];
+    if( sy == 0 && sz == 0 )
+        return;
+
+    int count = d[0] * d[1] * d[2];
+    unsigned int *old = new unsigned int[count];
+    memcpy(old, bricks.cells, count * sizeof(unsigned int));
+
+    for(int z = 0; z < d[2]; z++)
+    {
+        for(int y = 0; y < d[1]; y++)
+        {
+            unsigned int *row = bricks.cells + (z * d[1] + y) * d[0];
+            int oy = y - sy, oz = z - sz;
+            if( oy < 0 || oy >= d[1] || oz < 0 || oz >= d[2] )
+            {
+                for(int x = 0; x < d[0]; x++)
+                    row[x] = UNKNOWN_CELL;
+            }
+            else
+                memcpy(row, old + (oz * d[1] + oy) * d[0], d[0] * sizeof(unsigned int));
+        }
+    }
+
+    delete[] old;
+
+    for(int l = 1; l < OCCUPANCY_LEVELS; l++)
+        updateLevel(l, 0, 0, 0, m_levels[l].dims[0], m_levels[l].dims[1], m_levels[l].dims[2]);
+}
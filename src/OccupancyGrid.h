@@ -0,0 +1,72 @@
+//
+// min/max alpha of the volume over bricks and chunks, for empty space skipping
+//
+// Three levels cover the volume: 8x8x8 texel bricks, the 16x16x16 sections
+// of each chunk, and 32x32x32 blocks of four chunk sections. Each cell stores
+// the largest alpha of its texels in the low byte and the smallest in the
+// next byte, so cells can be fetched with the same 32-bit gathers and RGBA
+// uploads as the volume itself. A ray may leap over any cell whose max alpha
+// is at or below the skip alpha without changing the image when that is 0.
+// A cell is only empty if all the cells of the finer level below it are, so
+// rays test the bricks first and only look at coarser levels while empty.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _OCCUPANCY_GRID_H
+#define _OCCUPANCY_GRID_H
+
+// levels of the grid, finest first. Level l has cells of 8 << l texels.
+enum OccupancyLevelId { OCCUPANCY_BRICK = 0, OCCUPANCY_SECTION, OCCUPANCY_BLOCK, OCCUPANCY_LEVELS };
+
+// cells of one level. Cell (x,y,z) covers texels [x<<shift[0], (x+1)<<shift[0])
+// etc. and is found at cells[(z * dims[1] + y) * dims[0] + x].
+struct OccupancyLevel {
+    int shift[3];
+    int dims[3];
+    unsigned int *cells;
+};
+
+inline unsigned char OccupancyMax(unsigned int cell) { return (unsigned char)(cell & 0xff); }
+inline unsigned char OccupancyMin(unsigned int cell) { return (unsigned char)((cell >> 8) & 0xff); }
+
+class OccupancyGrid {
+public:
+    // width, height and depth of the volume in texels
+    OccupancyGrid(int width, int height, int depth);
+    ~OccupancyGrid();
+
+    // rescans every texel of the RGBA volume
+    void build(const unsigned char *volume);
+
+    // rescans the bricks touching texels [x0,x1) x [y0,y1) x [z0,z1), then
+    // the coarser cells above them
+    void update(const unsigned char *volume, int x0, int y0, int z0, int x1, int y1, int z1);
+
+    // the two halves of update. Rescanning the bricks may run on several
+    // threads at once for regions that share no brick; the coarser cells
+    // above them are rebuilt afterwards.
+    void updateBricks(const unsigned char *volume, int x0, int y0, int z0, int x1, int y1, int z1);
+    void updateCoarse(int x0, int y0, int z0, int x1, int y1, int z1);
+
+    // moves the cells along with a volume whose contents moved dy texels in
+    // y and dz in z (multiples of the brick size). Uncovered cells are marked
+    // occupied until update is called for them.
+    void shift(int dy, int dz);
+
+    const OccupancyLevel &getLevel(int level) const { return m_levels[level]; }
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getDepth() const { return m_depth; }
+
+private:
+    bool clip(int &x0, int &y0, int &z0, int &x1, int &y1, int &z1) const;
+    void cellRange(int l, int x0, int y0, int z0, int x1, int y1, int z1, int c0[3], int c1[3]) const;
+    void scanBricks(const unsigned char *volume, int bx0, int by0, int bz0, int bx1, int by1, int bz1);
+    void updateLevel(int l, int cx0, int cy0, int cz0, int cx1, int cy1, int cz1);
+
+    int m_width, m_height, m_depth;
+    OccupancyLevel m_levels[OCCUPANCY_LEVELS];
+};
+
+#endif
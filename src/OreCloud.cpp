@@ -0,0 +1,78 @@
+//
+// sparse lists of the ore blocks of a grid of chunks
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "OreCloud.h"
+#include "VolumeLoader.h"
+
+OreCloud::OreCloud(int chunksX, int chunksZ)
+    : m_chunksX(chunksX),
+      m_chunksZ(chunksZ),
+      m_chunks(chunksX * chunksZ)
+{
+}
+
+void
+OreCloud::extract(const ChunkData *chunk, unsigned int i, unsigned int j)
+{
+    bool ore[256];
+    for(int id = 0; id < 256; id++)
+        ore[id] = IsOre((unsigned char)id);
+
+    std::vector<OrePoint> &list = m_chunks[j * m_chunksX + i];
+    list.clear();
+
+    for(unsigned int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for(unsigned int z = 0; z < CHUNK_SIZE; z++)
+        {
+            for(unsigned int y = 0; y < CHUNK_HEIGHT; y++)
+            {
+                unsigned int bpos = ChunkIndex(x, y, z);
+                if( !ore[chunk->blocks[bpos]] )
+                    continue;
+
+                OrePoint p;
+                p.x = (unsigned char)x;
+                p.y = (unsigned char)y;
+                p.z = (unsigned char)z;
+                p.id = chunk->blocks[bpos];
+                p.light = (unsigned char)(ChunkNibble(chunk->skyLight, bpos) << 4 |
+                                          ChunkNibble(chunk->blockLight, bpos));
+                list.push_back(p);
+            }
+        }
+    }
+}
+
+void
+OreCloud::clear(unsigned int i, unsigned int j)
+{
+    m_chunks[j * m_chunksX + i].clear();
+}
+
+void
+OreCloud::shift(int X, int Z)
+{
+    std::vector< std::vector<OrePoint> > moved(m_chunks.size());
+    for(int j = 0; j < m_chunksZ; j++)
+    {
+        for(int i = 0; i < m_chunksX; i++)
+        {
+            int ti = i + X, tj = j + Z;
+            if( ti >= 0 && ti < m_chunksX && tj >= 0 && tj < m_chunksZ )
+                moved[tj * m_chunksX + ti].swap(m_chunks[j * m_chunksX + i]);
+        }
+    }
+    m_chunks.swap(moved);
+}
+
+size_t
+OreCloud::size() const
+{
+    size_t n = 0;
+    for(size_t c = 0; c < m_chunks.size(); c++)
+        n += m_chunks[c].size();
+    return n;
+}
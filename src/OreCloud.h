@@ -0,0 +1,57 @@
+//
+// sparse lists of the ore blocks of a grid of chunks
+//
+// With non-ore alpha near zero only the ores show, yet the dense volume is
+// still marched from end to end. The cloud keeps, for every chunk of the
+// grid, just the blocks for which IsOre is true, so ore views can draw them
+// directly at a cost that follows the number of ores. The lists are filled
+// while the chunks are decoded and keep positions within their chunk, so
+// moving the grid only moves lists.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ORE_CLOUD_H
+#define _ORE_CLOUD_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "ChunkReader.h"
+
+struct OrePoint {
+    unsigned char x, y, z;  // block position within its chunk
+    unsigned char id;       // block id
+    unsigned char light;    // sky light in the high nibble, block light in the low
+};
+
+class OreCloud {
+public:
+    // grid of chunksX by chunksZ chunks, (i,j) being the volume's grid position
+    OreCloud(int chunksX, int chunksZ);
+
+    // replaces the list of grid position (i,j) with the ores of chunk. Each
+    // position may be filled from a different thread.
+    void extract(const ChunkData *chunk, unsigned int i, unsigned int j);
+    // empties grid position (i,j), for missing chunks
+    void clear(unsigned int i, unsigned int j);
+
+    // moves the lists by X chunks along i and Z chunks along j, as the
+    // viewer shifts the volume. Uncovered positions are emptied.
+    void shift(int X, int Z);
+
+    const std::vector<OrePoint> &getChunk(unsigned int i, unsigned int j) const
+    {
+        return m_chunks[j * m_chunksX + i];
+    }
+    int getChunksX() const { return m_chunksX; }
+    int getChunksZ() const { return m_chunksZ; }
+
+    // ores over the whole grid
+    size_t size() const;
+
+private:
+    int m_chunksX, m_chunksZ;
+    std::vector< std::vector<OrePoint> > m_chunks;
+};
+
+#endif
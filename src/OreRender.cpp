@@ -0,0 +1,95 @@
+//
+// class to draw the ores of an OreCloud as cubes with GL
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "OreRender.h"
+
+// corners of the six faces of a unit cube, counter-clockwise from outside
+static const float cubeFaces[24][3] = {
+    { 1, 0, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 1, 0, 1 },
+    { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 },
+    { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 },
+    { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 }, { 0, 0, 1 },
+    { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 },
+    { 0, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 },
+};
+
+OreRender::OreRender()
+    : m_brightness(1.0f)
+{
+}
+
+void
+OreRender::update(const OreCloud *ores, const VolumePalette *palette)
+{
+    m_vertices.clear();
+    m_colors.clear();
+    m_vertices.reserve(ores->size() * 24 * 3);
+    m_colors.reserve(ores->size() * 24 * 3);
+
+    // the volume spans -0.5 to 0.5 on each axis, x being the block height
+    // and y and z the grid rows and columns, as in the loader
+    float dims[3] = { (float)CHUNK_HEIGHT,
+                      (float)(ores->getChunksZ() * CHUNK_SIZE),
+                      (float)(ores->getChunksX() * CHUNK_SIZE) };
+
+    for(int j = 0; j < ores->getChunksZ(); j++)
+    {
+        for(int i = 0; i < ores->getChunksX(); i++)
+        {
+            const std::vector<OrePoint> &list = ores->getChunk(i, j);
+            for(size_t o = 0; o < list.size(); o++)
+            {
+                const OrePoint &p = list[o];
+                float corner[3] = { (float)p.y, (float)(j * CHUNK_SIZE + p.z), (float)(i * CHUNK_SIZE + p.x) };
+
+                // lit as the loader lights the volume texel
+                float d = (p.light >> 4) / 15.0f + (p.light & 15) / 15.0f + 0.5f;
+                if( d > 1 ) d = 1;
+                d *= m_brightness;
+                GLubyte rgb[3];
+                for(int k = 0; k < 3; k++)
+                {
+                    float v = palette->colors[p.id][k] / 255.0f * d;
+                    rgb[k] = (GLubyte)((v < 1.0f ? v : 1.0f) * 255.0f + 0.5f);
+                }
+
+                for(int v = 0; v < 24; v++)
+                {
+                    for(int k = 0; k < 3; k++)
+                    {
+                        m_vertices.push_back((corner[k] + cubeFaces[v][k]) / dims[k] - 0.5f);
+                        m_colors.push_back(rgb[k]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void
+OreRender::render()
+{
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if( m_vertices.empty() )
+        return;
+
+    glPushAttrib(GL_ENABLE_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_TEXTURE_3D);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &m_vertices[0]);
+    glColorPointer(3, GL_UNSIGNED_BYTE, 0, &m_colors[0]);
+
+    glDrawArrays(GL_QUADS, 0, (GLsizei)(m_vertices.size() / 3));
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glPopAttrib();
+}
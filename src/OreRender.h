@@ -0,0 +1,41 @@
+//
+// class to draw the ores of an OreCloud as cubes with GL
+//
+// For ore views, which would otherwise march the whole volume to show a
+// few thousand blocks. Every ore becomes a cube of its block in the volume's
+// object space, colored and lit as in the volume, and the cubes are drawn
+// from vertex arrays built once each time the chunks change.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ORE_RENDER_H
+#define _ORE_RENDER_H
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "OreCloud.h"
+#include "VolumeLoader.h"
+
+class OreRender {
+public:
+    OreRender();
+
+    // rebuilds the cubes from the ores and palette
+    void update(const OreCloud *ores, const VolumePalette *palette);
+
+    // clears the frame and draws the cubes with the current modelview
+    void render();
+
+    // scales the colors of the next update
+    void setBrightness(float x) { m_brightness = x; }
+
+    int getCubeCount() { return (int)m_vertices.size() / (24 * 3); }
+
+private:
+    float m_brightness;
+    std::vector<GLfloat> m_vertices;
+    std::vector<GLubyte> m_colors;
+};
+
+#endif
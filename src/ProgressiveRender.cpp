@@ -0,0 +1,133 @@
+//
+// progressive refinement of the view while the camera moves and settles
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ProgressiveRender.h"
+
+ProgressiveRender::ProgressiveRender()
+    : m_moving(false),
+      m_previewDue(false),
+      m_pass(0),
+      m_passes(8),
+      m_previewScale(2),
+      m_previewStepScale(2.0f)
+{
+}
+
+void
+ProgressiveRender::moved()
+{
+    m_moving = true;
+    m_previewDue = true;
+}
+
+void
+ProgressiveRender::settle()
+{
+    if( !m_moving )
+        return;
+    m_moving = false;
+    m_pass = 0;
+}
+
+void
+ProgressiveRender::restart()
+{
+    m_pass = 0;
+    if( m_moving )
+        m_previewDue = true;
+}
+
+bool
+ProgressiveRender::refining() const
+{
+    return m_moving ? m_previewDue : m_pass < m_passes;
+}
+
+// radical inverse of the pass in base 2 (0, 1/2, 1/4, 3/4, ...), so every
+// prefix of the passes spreads its offsets evenly over the step
+float
+ProgressiveRender::getJitter() const
+{
+    if( m_moving )
+        return 0.0f;
+
+    float x = 0.0f, f = 0.5f;
+    for(int i = m_pass; i > 0; i >>= 1, f *= 0.5f)
+        if( i & 1 )
+            x += f;
+    return x;
+}
+
+float
+ProgressiveRender::getWeight() const
+{
+    return m_moving ? 1.0f : 1.0f / (m_pass + 1);
+}
+
+void
+ProgressiveRender::next()
+{
+    if( m_moving )
+        m_previewDue = false;
+    else if( m_pass < m_passes )
+        m_pass++;
+}
+
+int
+ProgressiveRender::chooseScale(int width, int height, int maxPixels)
+{
+    int s = 1;
+    while( (long long)(width / s) * (height / s) > maxPixels )
+        s++;
+    return s;
+}
+
+void UpsampleImage(const unsigned char *src, int srcWidth, int srcHeight,
+                   unsigned char *dst, int dstWidth, int dstHeight)
+{
+    float sx = (float)srcWidth / dstWidth, sy = (float)srcHeight / dstHeight;
+
+    for(int y = 0; y < dstHeight; y++)
+    {
+        float fy = (y + 0.5f) * sy - 0.5f;
+        if( fy < 0.0f ) fy = 0.0f;
+        int y0 = (int)fy;
+        int y1 = y0 + 1 < srcHeight ? y0 + 1 : y0;
+        float wy = fy - y0;
+
+        const unsigned char *row0 = src + (size_t)y0 * srcWidth * 3;
+        const unsigned char *row1 = src + (size_t)y1 * srcWidth * 3;
+        unsigned char *out = dst + (size_t)y * dstWidth * 3;
+
+        for(int x = 0; x < dstWidth; x++, out += 3)
+        {
+            float fx = (x + 0.5f) * sx - 0.5f;
+            if( fx < 0.0f ) fx = 0.0f;
+            int x0 = (int)fx;
+            int x1 = x0 + 1 < srcWidth ? x0 + 1 : x0;
+            float wx = fx - x0;
+
+            for(int k = 0; k < 3; k++)
+            {
+                float top = row0[x0 * 3 + k] + (row0[x1 * 3 + k] - row0[x0 * 3 + k]) * wx;
+                float bottom = row1[x0 * 3 + k] + (row1[x1 * 3 + k] - row1[x0 * 3 + k]) * wx;
+                out[k] = (unsigned char)(top + (bottom - top) * wy + 0.5f);
+            }
+        }
+    }
+}
+
+void BlendImage(unsigned char *dst, const unsigned char *src, size_t bytes, float weight)
+{
+    if( weight >= 1.0f )
+    {
+        for(size_t i = 0; i < bytes; i++)
+            dst[i] = src[i];
+        return;
+    }
+
+    for(size_t i = 0; i < bytes; i++)
+        dst[i] = (unsigned char)(dst[i] + (src[i] - dst[i]) * weight + 0.5f);
+}
@@ -0,0 +1,75 @@
+//
+// progressive refinement of the view while the camera moves and settles
+//
+// While the camera moves each frame is rendered at a fraction of the window
+// resolution with longer steps, then upsampled, so dragging stays fluid on
+// large windows. Once the camera settles full resolution passes follow. The
+// first is the ordinary image; each later one starts its rays a different
+// fraction of a step further in and is averaged into the image, smoothing
+// the banding of the fixed steps. After the last pass nothing is redrawn.
+// The schedule is shared by the viewer and the CPU renderer, the helpers
+// below do the upsampling and averaging for the CPU.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _PROGRESSIVE_RENDER_H
+#define _PROGRESSIVE_RENDER_H
+
+#include <stddef.h>
+
+class ProgressiveRender {
+public:
+    ProgressiveRender();
+
+    // the camera moved, render a coarse frame and keep doing so for each
+    // move until settle is called
+    void moved();
+    // the camera stopped, refine from a full resolution pass
+    void settle();
+    // the image changed without the camera moving, start refining again
+    void restart();
+
+    // true while another frame would change the image
+    bool refining() const;
+    bool isMoving() const { return m_moving; }
+
+    // frames while moving are width / scale by height / scale pixels
+    int getScale() const { return m_moving ? m_previewScale : 1; }
+    // steps are this many times longer, with opacity corrected
+    float getStepScale() const { return m_moving ? m_previewStepScale : 1.0f; }
+    // offset of the first sample of each ray, in steps from 0 to 1
+    float getJitter() const;
+    // weight of the next frame in the image, 1 replaces it
+    float getWeight() const;
+
+    // call after rendering each frame
+    void next();
+
+    // preview scale for a window, the smallest which keeps the preview
+    // under maxPixels
+    static int chooseScale(int width, int height, int maxPixels);
+
+    void setPreviewScale(int s) { m_previewScale = s > 0 ? s : 1; }
+    void setPreviewStepScale(float x) { m_previewStepScale = x > 1.0f ? x : 1.0f; }
+    // full resolution passes averaged once settled, 1 for the ordinary image
+    void setPasses(int n) { m_passes = n > 0 ? n : 1; }
+    int getPass() const { return m_pass; }
+
+private:
+    bool m_moving;
+    bool m_previewDue;
+    int m_pass;
+    int m_passes;
+    int m_previewScale;
+    float m_previewStepScale;
+};
+
+// bilinear upsampling of a small RGB image to the full one, with pixel
+// centers aligned
+void UpsampleImage(const unsigned char *src, int srcWidth, int srcHeight,
+                   unsigned char *dst, int dstWidth, int dstHeight);
+
+// moves each byte of dst towards src by weight
+void BlendImage(unsigned char *dst, const unsigned char *src, size_t bytes, float weight);
+
+#endif
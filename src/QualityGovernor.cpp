@@ -0,0 +1,185 @@
+//
+// trades image quality for time to hold a target frame time
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+
+#include "QualityGovernor.h"
+
+// settings of a level, and its cost guessed relative to full quality until
+// the governor has seen the real ratio
+struct QualityLevel {
+    float resolution;
+    float stepScale;
+    float threshold;
+    int lodBias;
+    float cost;
+};
+
+static const QualityLevel LADDER[QualityGovernor::LEVELS] = {
+    { 1.0f,  1.0f, 1.0f,  0, 1.0f   },
+    { 1.0f,  1.0f, 0.95f, 0, 0.85f  },
+    { 1.0f,  1.5f, 0.95f, 0, 0.6f   },
+    { 1.0f,  1.5f, 0.95f, 1, 0.5f   },
+    { 0.75f, 1.5f, 0.95f, 1, 0.3f   },
+    { 0.75f, 2.0f, 0.9f,  2, 0.2f   },
+    { 0.5f,  2.0f, 0.9f,  2, 0.1f   },
+    { 0.5f,  3.0f, 0.9f,  3, 0.07f  },
+    { 0.35f, 3.0f, 0.85f, 3, 0.035f },
+    { 0.25f, 4.0f, 0.85f, 3, 0.015f },
+};
+
+// weight of each frame in the smoothed time
+static const float SMOOTHING = 0.25f;
+// a better level is taken back once expected under this share of the target
+static const float HEADROOM = 0.8f;
+
+QualityGovernor::QualityGovernor(float targetMs)
+    : m_log(NULL)
+{
+    setTarget(targetMs);
+    reset();
+}
+
+QualityGovernor::~QualityGovernor()
+{
+    if( m_log != NULL )
+        fclose(m_log);
+}
+
+bool
+QualityGovernor::openLog(const char *path)
+{
+    if( m_log != NULL )
+        fclose(m_log);
+    m_log = fopen(path, "w");
+    if( m_log == NULL )
+        return false;
+
+    fprintf(m_log, "frame,ms,average,target,from,to,resolution,stepscale,threshold,lodbias\n");
+    fflush(m_log);
+    return true;
+}
+
+void
+QualityGovernor::reset()
+{
+    m_average = 0.0f;
+    m_level = 0;
+    m_held = 0;
+    m_frames = 0;
+    m_changes = 0;
+    m_lastLevel = -1;
+    m_lastAverage = 0.0f;
+
+    m_ratio[0] = 1.0f;
+    for(int l = 1; l < LEVELS; l++)
+        m_ratio[l] = LADDER[l - 1].cost / LADDER[l].cost;
+}
+
+bool
+QualityGovernor::frame(float ms)
+{
+    m_frames++;
+    m_average = m_held == 0 ? ms : m_average + SMOOTHING * (ms - m_average);
+    if( ++m_held < HOLD_FRAMES )
+        return false;
+
+    // once the new level has settled, the two times give the real ratio
+    // between it and the last one, shared out evenly over the levels in
+    // between. A worse level may well be slower, such as when far steps
+    // grow and the CPU renderer leaves its packets for single rays.
+    if( m_lastLevel >= 0 )
+    {
+        int better = m_lastLevel < m_level ? m_lastLevel : m_level;
+        int worse = m_lastLevel < m_level ? m_level : m_lastLevel;
+        float betterTime = better == m_level ? m_average : m_lastAverage;
+        float worseTime = worse == m_level ? m_average : m_lastAverage;
+        if( betterTime > 0.0f && worseTime > 0.0f )
+        {
+            float expected = 1.0f;
+            for(int l = better + 1; l <= worse; l++)
+                expected *= m_ratio[l];
+            float f = powf(betterTime / worseTime / expected, 1.0f / (worse - better));
+            for(int l = better + 1; l <= worse; l++)
+            {
+                float r = m_ratio[l] * f;
+                m_ratio[l] = r < 0.25f ? 0.25f : (r > 16.0f ? 16.0f : r);
+            }
+        }
+        m_lastLevel = -1;
+    }
+
+    if( m_average > m_target )
+    {
+        // as many levels down as it takes to fit
+        int level = m_level;
+        float expected = m_average;
+        while( level + 1 < LEVELS && expected > m_target )
+            expected /= m_ratio[++level];
+        if( level != m_level ) {
+            change(level, ms);
+            return true;
+        }
+    }
+    else if( m_level > 0 && m_average * m_ratio[m_level] < m_target * HEADROOM )
+    {
+        change(m_level - 1, ms);
+        return true;
+    }
+    return false;
+}
+
+void
+QualityGovernor::change(int level, float ms)
+{
+    const QualityLevel &q = LADDER[level];
+    if( m_log != NULL )
+    {
+        fprintf(m_log, "%d,%.3f,%.3f,%.3f,%d,%d,%.2f,%.2f,%.2f,%d\n", m_frames, ms, m_average, m_target,
+                m_level, level, q.resolution, q.stepScale, q.threshold, q.lodBias);
+        fflush(m_log);
+    }
+
+    m_lastLevel = m_level;
+    m_lastAverage = m_average;
+    m_level = level;
+    m_held = 0;
+    m_changes++;
+}
+
+float
+QualityGovernor::getResolution() const
+{
+    return LADDER[m_level].resolution;
+}
+
+float
+QualityGovernor::getStepScale() const
+{
+    return LADDER[m_level].stepScale;
+}
+
+float
+QualityGovernor::getThreshold() const
+{
+    return LADDER[m_level].threshold;
+}
+
+int
+QualityGovernor::getLodBias() const
+{
+    return LADDER[m_level].lodBias;
+}
+
+float
+QualityGovernor::getFarDistance(float distance, float start) const
+{
+    int bias = LADDER[m_level].lodBias;
+    if( bias == 0 )
+        return distance;
+    if( distance <= 0.0f )
+        return start / (float)(1 << (bias - 1));
+    return distance / (float)(1 << bias);
+}
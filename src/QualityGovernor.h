@@ -0,0 +1,87 @@
+//
+// trades image quality for time to hold a target frame time
+//
+// The governor is told how long each frame took and keeps a smoothed time,
+// then walks a ladder of quality levels, each cheaper than the one before:
+// rays stop earlier once nearly opaque, steps grow, samples far from the eye
+// coarsen from a distance which halves, and the image is rendered at a
+// fraction of the window and upsampled. A frame over the target jumps to
+// the level expected to fit; a better level is only taken back once it is
+// expected to come in well under the target, from the ratios of the times
+// seen at the levels before, so the quality does not flicker between them.
+// After each change a few frames pass before the next decision.
+//
+// Every change can be written to a log as a row of CSV, for looking at how
+// the governor behaved afterwards. The governor only picks settings; the
+// viewer and the CPU renderer apply them, on top of the ones set by hand.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _QUALITY_GOVERNOR_H
+#define _QUALITY_GOVERNOR_H
+
+#include <stdio.h>
+
+class QualityGovernor {
+public:
+    // levels of the ladder, 0 being full quality
+    static const int LEVELS = 10;
+    // frames at a new level before the next decision
+    static const int HOLD_FRAMES = 3;
+
+    explicit QualityGovernor(float targetMs = 16.0f);
+    ~QualityGovernor();
+
+    void setTarget(float ms) { m_target = ms > 0.0f ? ms : 1.0f; }
+    float getTarget() const { return m_target; }
+
+    // writes each change to a CSV file from now on, false if it cannot be
+    // opened
+    bool openLog(const char *path);
+
+    // records the milliseconds of a frame rendered with the current
+    // settings. Returns true if the settings changed for the next frame.
+    bool frame(float ms);
+
+    // back to full quality, forgetting the times seen so far
+    void reset();
+
+    int getLevel() const { return m_level; }
+    float getAverage() const { return m_average; }
+    int getFrames() const { return m_frames; }
+    int getChanges() const { return m_changes; }
+
+    // fraction of the width and height to render at
+    float getResolution() const;
+    // multiplies the step length
+    float getStepScale() const;
+    // rays stop at this opacity, or the one set by hand if that is lower
+    float getThreshold() const;
+    // far samples coarsen from a distance halved this many times
+    int getLodBias() const;
+
+    // distance past which far samples coarsen, from the one set by hand,
+    // 0 for never, and the one to start from once the governor needs it
+    float getFarDistance(float distance, float start) const;
+
+private:
+    void change(int level, float ms);
+
+    float m_target;
+    float m_average;
+    int m_level;
+    int m_held;
+    int m_frames;
+    int m_changes;
+
+    // time of level l-1 over the time of level l, guessed at first and
+    // learnt from the changes
+    float m_ratio[LEVELS];
+    // level left by the last change and its time, to learn the ratio
+    int m_lastLevel;
+    float m_lastAverage;
+
+    FILE *m_log;
+};
+
+#endif
@@ -0,0 +1,99 @@
+//
+// chunk modification times of a world, for regenerating only what changed
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RegionManifest.h"
+
+void ScanRegionManifest(const char *world, const std::vector<RegionCoord> &regions,
+                        RegionManifest *manifest)
+{
+    manifest->regions.clear();
+
+    std::vector<unsigned int> stamps(REGION_CHUNK_COUNT);
+    for(size_t r = 0; r < regions.size(); r++)
+    {
+        if( ReadRegionTimestamps(world, regions[r], &stamps[0]) )
+            manifest->regions[std::make_pair(regions[r].x, regions[r].z)] = stamps;
+    }
+}
+
+int LoadRegionManifest(const char *filename, RegionManifest *manifest)
+{
+    FILE *f = fopen(filename, "r");
+    if( f == NULL )
+        return 0;
+
+    manifest->settings.clear();
+    manifest->regions.clear();
+
+    char line[1024];
+    bool ok = fgets(line, sizeof(line), f) != NULL && strncmp(line, "settings ", 9) == 0;
+    if( ok )
+    {
+        manifest->settings = line + 9;
+        while( !manifest->settings.empty() &&
+               (manifest->settings.back() == '\n' || manifest->settings.back() == '\r') )
+            manifest->settings.pop_back();
+    }
+
+    char word[16];
+    while( ok && fscanf(f, " %15s", word) == 1 )
+    {
+        int x, z;
+        ok = strcmp(word, "region") == 0 && fscanf(f, "%d %d", &x, &z) == 2;
+
+        std::vector<unsigned int> stamps(REGION_CHUNK_COUNT);
+        for(int c = 0; ok && c < REGION_CHUNK_COUNT; c++)
+            ok = fscanf(f, "%u", &stamps[c]) == 1;
+
+        if( ok )
+            manifest->regions[std::make_pair(x, z)].swap(stamps);
+    }
+    fclose(f);
+
+    return ok ? 1 : 0;
+}
+
+int SaveRegionManifest(const char *filename, const RegionManifest &manifest)
+{
+    FILE *f = fopen(filename, "w");
+    if( f == NULL )
+        return 0;
+
+    fprintf(f, "settings %s\n", manifest.settings.c_str());
+
+    std::map< std::pair<int, int>, std::vector<unsigned int> >::const_iterator it;
+    for(it = manifest.regions.begin(); it != manifest.regions.end(); ++it)
+    {
+        fprintf(f, "region %d %d", it->first.first, it->first.second);
+        for(int c = 0; c < REGION_CHUNK_COUNT; c++)
+            fprintf(f, "%s%u", c % REGION_CHUNKS == 0 ? "\n" : " ", it->second[c]);
+        fprintf(f, "\n");
+    }
+
+    bool ok = ferror(f) == 0;
+    return fclose(f) == 0 && ok;
+}
+
+int ChangedChunks(const RegionManifest &before, const RegionManifest &after,
+                  const RegionCoord &region, bool *changed)
+{
+    std::pair<int, int> key(region.x, region.z);
+    std::map< std::pair<int, int>, std::vector<unsigned int> >::const_iterator b, a;
+    b = before.regions.find(key);
+    a = after.regions.find(key);
+
+    int count = 0;
+    for(int c = 0; c < REGION_CHUNK_COUNT; c++)
+    {
+        changed[c] = b == before.regions.end() || a == after.regions.end() ||
+                     b->second[c] != a->second[c];
+        if( changed[c] )
+            count++;
+    }
+    return count;
+}
@@ -0,0 +1,49 @@
+//
+// chunk modification times of a world, for regenerating only what changed
+//
+// A manifest holds the timestamp of every chunk of every region file as
+// it was when some output was last built from the world, and a settings
+// line describing everything else that output depends on. Comparing it
+// with the timestamps of the world now tells which chunks need decoding
+// again. It is saved as text:
+//
+//     settings <anything up to the end of the line>
+//     region <x> <z>
+//     <32 lines of 32 timestamps, one row of chunks with increasing x each>
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _REGION_MANIFEST_H
+#define _REGION_MANIFEST_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ChunkReader.h"
+
+const int REGION_CHUNK_COUNT = REGION_CHUNKS * REGION_CHUNKS;
+
+struct RegionManifest {
+    std::string settings;
+    // timestamps of each region, by region (x,z)
+    std::map< std::pair<int, int>, std::vector<unsigned int> > regions;
+};
+
+// reads the timestamps of the given regions of a world. Regions whose
+// header cannot be read are left out, so they always count as changed.
+void ScanRegionManifest(const char *world, const std::vector<RegionCoord> &regions,
+                        RegionManifest *manifest);
+
+// Return 0 if the file cannot be read or written, or is malformed.
+int LoadRegionManifest(const char *filename, RegionManifest *manifest);
+int SaveRegionManifest(const char *filename, const RegionManifest &manifest);
+
+// flags in changed[x + z * 32] the chunks of region whose timestamps differ
+// between the two manifests, all of them if either lacks the region.
+// Returns the number flagged.
+int ChangedChunks(const RegionManifest &before, const RegionManifest &after,
+                  const RegionCoord &region, bool *changed);
+
+#endif
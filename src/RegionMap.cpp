@@ -0,0 +1,121 @@
+//
+// top-down maps of whole region files, for world-scale tile pyramids
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "RegionMap.h"
+#include "SurfaceMap.h"
+
+// composites one column of a chunk from the top down into an RGB pixel
+static void compositeColumn(const ChunkData *chunk, const VolumePalette *palette,
+                            const MapSettings &settings, unsigned int x, unsigned int z,
+                            unsigned char *out)
+{
+    float c[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    unsigned int base = ChunkIndex(x, 0, z);
+
+    for(int y = CHUNK_HEIGHT - 1; y >= 0; y--)
+    {
+        unsigned int bpos = base + y;
+        if( palette->colors[chunk->blocks[bpos]][3] == 0 )
+            continue;
+
+        unsigned char t[4];
+        ChunkTexel(chunk, palette, bpos, t);
+
+        // premultiply alpha and composite under what is above
+        float w = (1.0f - c[3]) * (t[3] / 255.0f) * settings.density;
+        c[0] += w * (t[0] / 255.0f);
+        c[1] += w * (t[1] / 255.0f);
+        c[2] += w * (t[2] / 255.0f);
+        c[3] += w;
+        if( c[3] >= settings.threshold )
+            break;
+    }
+
+    for(int k = 0; k < 3; k++)
+    {
+        float v = c[k] * settings.brightness;
+        if( v > 1.0f ) v = 1.0f;
+        out[k] = (unsigned char)(v * 255.0f + 0.5f);
+    }
+}
+
+// colors a pixel with the top block of a column, as ChunkTexel lights it
+static void surfaceColumn(const SurfaceColumn &column, const VolumePalette *palette,
+                          const MapSettings &settings, unsigned char *out)
+{
+    const unsigned char *bCol = palette->colors[column.id];
+
+    float d = column.skyLight / 15.0f + column.blockLight / 15.0f + 0.50f;
+    if( d > 1 ) d = 1;
+    d *= settings.brightness;
+
+    for(int k = 0; k < 3; k++)
+    {
+        float v = (bCol[k] / 255.0f) * d;
+        if( v > 1.0f ) v = 1.0f;
+        out[k] = (unsigned char)(v * 255.0f + 0.5f);
+    }
+}
+
+int RenderRegionMap(const char *world, const RegionCoord &region,
+                    const VolumePalette *palette, const MapSettings &settings,
+                    ChunkData *chunk, unsigned char *rgb, const bool *redraw)
+{
+    int found = 0;
+    for(int j = 0; j < REGION_CHUNKS; j++)
+    {
+        for(int i = 0; i < REGION_CHUNKS; i++)
+        {
+            if( redraw != NULL && !redraw[i + j * REGION_CHUNKS] )
+                continue;
+
+            bool read = ReadRegionChunk(world, region.x * REGION_CHUNKS + i,
+                                        region.z * REGION_CHUNKS + j, chunk) != 0;
+            if( read )
+                found++;
+
+            SurfaceColumn columns[CHUNK_SIZE * CHUNK_SIZE];
+            if( read && settings.surface )
+                ExtractSurface(chunk, columns, settings.heightMap);
+
+            for(int z = 0; z < CHUNK_SIZE; z++)
+            {
+                unsigned char *row = rgb + ((size_t)(j * CHUNK_SIZE + z) * REGION_SIZE + i * CHUNK_SIZE) * 3;
+                if( !read ) {
+                    memset(row, 0, CHUNK_SIZE * 3);
+                    continue;
+                }
+
+                for(int x = 0; x < CHUNK_SIZE; x++)
+                {
+                    if( settings.surface )
+                        surfaceColumn(columns[x + z * CHUNK_SIZE], palette, settings, row + x * 3);
+                    else
+                        compositeColumn(chunk, palette, settings, x, z, row + x * 3);
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void DownsampleQuadrant(const unsigned char *src, int size, unsigned char *dst, int qx, int qz)
+{
+    int half = size / 2;
+    for(int v = 0; v < half; v++)
+    {
+        const unsigned char *s0 = src + (size_t)(2 * v) * size * 3;
+        const unsigned char *s1 = s0 + size * 3;
+        unsigned char *d = dst + ((size_t)(qz * half + v) * size + qx * half) * 3;
+
+        for(int u = 0; u < half; u++, s0 += 6, s1 += 6, d += 3)
+        {
+            for(int k = 0; k < 3; k++)
+                d[k] = (unsigned char)((s0[k] + s0[k + 3] + s1[k] + s1[k + 3] + 2) / 4);
+        }
+    }
+}
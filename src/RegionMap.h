@@ -0,0 +1,46 @@
+//
+// top-down maps of whole region files, for world-scale tile pyramids
+//
+// A region is rendered looking straight down with the volume compositing
+// model of the renderers: every column of blocks is composited front to
+// back, from the top of the world down, with the palette colors and lights
+// the volume loader uses, one sample per block. The map has one pixel per
+// block, x (east) to the right and z (south) down.
+//
+// Surface maps draw only the top block of each column instead, lit by the
+// light above it, from a SurfaceMap scan or the chunk's HeightMap, for
+// quick overviews of large worlds.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _REGION_MAP_H
+#define _REGION_MAP_H
+
+#include "ChunkReader.h"
+#include "VolumeLoader.h"
+
+// edge length of a region, and of its map, in blocks
+const int REGION_SIZE = REGION_CHUNKS * CHUNK_SIZE;
+
+struct MapSettings {
+    float density;      // scales the alpha of every block
+    float brightness;   // scales the composited color
+    float threshold;    // a column stops once its opacity reaches this
+    bool surface;       // draw only the top block of each column
+    bool heightMap;     // with surface, take the top from the HeightMap tag
+};
+
+// renders the map of a region into rgb, REGION_SIZE * REGION_SIZE pixels of
+// three bytes. chunk is scratch space for decoding. Missing chunks are
+// black. If redraw is given only the chunks flagged in redraw[x + z * 32]
+// are read and drawn, leaving the rest of rgb as it is. Returns the number
+// of chunks found.
+int RenderRegionMap(const char *world, const RegionCoord &region,
+                    const VolumePalette *palette, const MapSettings &settings,
+                    ChunkData *chunk, unsigned char *rgb, const bool *redraw = NULL);
+
+// halves a size x size image into quadrant (qx,qz) of dst, of the same
+// size, averaging every 2x2 block of pixels
+void DownsampleQuadrant(const unsigned char *src, int size, unsigned char *dst, int qx, int qz);
+
+#endif
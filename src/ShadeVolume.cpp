@@ -0,0 +1,204 @@
+//
+// ambient occlusion and sun shadow of every texel of the volume
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <chrono>
+
+#include "ShadeVolume.h"
+#include "TaskPool.h"
+
+const char *ShadeChannelNames[SHADE_CHANNELS] = { "occlusion", "shadow", "both" };
+
+int FindShadeChannel(const char *name)
+{
+    for(int c = 0; c < SHADE_CHANNELS; c++)
+        if( strcmp(name, ShadeChannelNames[c]) == 0 )
+            return c;
+    return -1;
+}
+
+// texels of a column task on the y and z axes
+static const int COLUMN = 16;
+
+// a cell of an unshaded texel
+static const unsigned int UNSHADED_CELL = 0xffffffff;
+
+ShadeVolume::ShadeVolume(int width, int height, int depth)
+    : m_width(width),
+      m_height(height),
+      m_depth(depth),
+      m_cells((size_t)width * height * depth, UNSHADED_CELL),
+      m_updateTime(0.0)
+{
+}
+
+void
+ShadeVolume::build(const unsigned char *volume)
+{
+    update(volume, 0, 0, m_height, m_depth);
+}
+
+void
+ShadeVolume::update(const unsigned char *volume, int y0, int z0, int y1, int z1)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // occlusion reaches the radius each way, shadow rays reach back from
+    // texels up to half their length before
+    const int R = OCCLUSION_RADIUS;
+    int reach = SHADOW_LENGTH / 2 > R ? SHADOW_LENGTH / 2 : R;
+    y0 -= R;
+    y1 += R;
+    z0 -= reach;
+    z1 += R;
+
+    if( y0 < 0 ) y0 = 0;
+    if( z0 < 0 ) z0 = 0;
+    if( y1 > m_height ) y1 = m_height;
+    if( z1 > m_depth ) z1 = m_depth;
+    if( y0 >= y1 || z0 >= z1 )
+        return;
+
+    int cy0 = y0 / COLUMN, cy1 = (y1 + COLUMN - 1) / COLUMN;
+    int cz0 = z0 / COLUMN, cz1 = (z1 + COLUMN - 1) / COLUMN;
+    int rows = cy1 - cy0;
+
+    TaskPool &pool = TaskPool::shared();
+    std::vector<std::vector<int> > sums(pool.getThreadCount());
+
+    pool.parallelFor(rows * (cz1 - cz0), [&](int task, int worker) {
+        shadeColumn(volume, (cy0 + task % rows) * COLUMN, (cz0 + task / rows) * COLUMN, sums[worker]);
+    });
+
+    m_updateTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// shades the texels [y0,y0+COLUMN) x [z0,z0+COLUMN) of every height, with
+// sums as scratch space
+void
+ShadeVolume::shadeColumn(const unsigned char *volume, int y0, int z0, std::vector<int> &sums)
+{
+    const int R = OCCLUSION_RADIUS;
+    const int W = m_width;
+    const int P = COLUMN + 2 * R;
+    int ny = m_height - y0 < COLUMN ? m_height - y0 : COLUMN;
+    int nz = m_depth - z0 < COLUMN ? m_depth - z0 : COLUMN;
+
+    // alpha summed over the box in three passes: along x for every column
+    // of the padded area, then along y and z. Outside the volume is empty.
+    sums.resize((size_t)W * P * P + (size_t)W * COLUMN * P);
+    int *sx = &sums[0];
+    int *sy = sx + (size_t)W * P * P;
+
+    for(int pz = 0; pz < P; pz++)
+    {
+        for(int py = 0; py < P; py++)
+        {
+            int *dst = sx + (size_t)(pz * P + py) * W;
+            int y = y0 + py - R, z = z0 + pz - R;
+            if( y < 0 || y >= m_height || z < 0 || z >= m_depth ) {
+                memset(dst, 0, W * sizeof(int));
+                continue;
+            }
+
+            const unsigned char *column = volume + ((size_t)z * m_height + y) * W * 4 + 3;
+            int sum = 0;
+            for(int x = 0; x < R && x < W; x++)
+                sum += column[x * 4];
+            for(int x = 0; x < W; x++)
+            {
+                if( x + R < W ) sum += column[(x + R) * 4];
+                dst[x] = sum;
+                if( x - R >= 0 ) sum -= column[(x - R) * 4];
+            }
+        }
+    }
+
+    for(int pz = 0; pz < P; pz++)
+    {
+        for(int y = 0; y < ny; y++)
+        {
+            int *dst = sy + (size_t)(pz * COLUMN + y) * W;
+            memset(dst, 0, W * sizeof(int));
+            for(int py = y; py <= y + 2 * R; py++)
+            {
+                const int *src = sx + (size_t)(pz * P + py) * W;
+                for(int x = 0; x < W; x++)
+                    dst[x] += src[x];
+            }
+        }
+    }
+
+    // a texel on flat open ground has the layers below and the rest of its
+    // own layer occluding it, which counts as fully open
+    const int box = (2 * R + 1) * (2 * R + 1) * (2 * R + 1);
+    const float open = (float)(R * (2 * R + 1) * (2 * R + 1)) / (box - 1);
+    const float fractionScale = 1.0f / (255.0f * (box - 1));
+
+    float transmit[256];
+    for(int a = 0; a < 256; a++)
+        transmit[a] = 1.0f - a / 255.0f;
+
+    for(int z = 0; z < nz; z++)
+    {
+        for(int y = 0; y < ny; y++)
+        {
+            size_t texel = ((size_t)(z0 + z) * m_height + y0 + y) * W;
+            const unsigned char *alpha = volume + texel * 4 + 3;
+            unsigned int *cells = &m_cells[texel];
+
+            for(int x = 0; x < W; x++)
+            {
+                int sum = -alpha[x * 4];
+                for(int pz = z; pz <= z + 2 * R; pz++)
+                    sum += sy[(size_t)(pz * COLUMN + y) * W + x];
+
+                float occlusion = (1.0f - sum * fractionScale) / (1.0f - open);
+                if( occlusion > 1.0f ) occlusion = 1.0f;
+                if( occlusion < 0.0f ) occlusion = 0.0f;
+
+                // up the height and along z, leaving the volume unshadowed
+                float shadow = 1.0f;
+                for(int k = 1; k <= SHADOW_LENGTH && shadow > 1.0f / 512.0f; k++)
+                {
+                    int hx = x + k, hz = z0 + z + k / 2;
+                    if( hx >= W || hz >= m_depth )
+                        break;
+                    shadow *= transmit[volume[(((size_t)hz * m_height + y0 + y) * W + hx) * 4 + 3]];
+                }
+
+                unsigned int o = (unsigned int)(occlusion * 255.0f + 0.5f);
+                unsigned int s = (unsigned int)(SHADOW_AMBIENT + shadow * (255 - SHADOW_AMBIENT) + 0.5f);
+                cells[x] = o | (s << 8) | (((o * s + 127) / 255) << 16) | 0xff000000;
+            }
+        }
+    }
+}
+
+void
+ShadeVolume::shift(int dy, int dz)
+{
+    if( dy == 0 && dz == 0 )
+        return;
+
+    std::vector<unsigned int> old(m_cells);
+    size_t row = (size_t)m_width;
+
+    for(int z = 0; z < m_depth; z++)
+    {
+        for(int y = 0; y < m_height; y++)
+        {
+            unsigned int *dst = &m_cells[((size_t)z * m_height + y) * row];
+            int oy = y - dy, oz = z - dz;
+            if( oy < 0 || oy >= m_height || oz < 0 || oz >= m_depth )
+            {
+                for(size_t x = 0; x < row; x++)
+                    dst[x] = UNSHADED_CELL;
+            }
+            else
+                memcpy(dst, &old[((size_t)oz * m_height + oy) * row], row * sizeof(unsigned int));
+        }
+    }
+}
@@ -0,0 +1,87 @@
+//
+// ambient occlusion and sun shadow of every texel of the volume
+//
+// Both terms come from the alpha of the volume, taken as the opacity of a
+// block, and are computed once when chunks load instead of with secondary
+// rays each frame. Occlusion sums the alpha of the box of texels within
+// OCCLUSION_RADIUS around a texel and compares it with an open half space,
+// so flat ground stays unshaded while creases, hollows and cave walls
+// darken. Shadow is the transmittance of a ray of SHADOW_LENGTH texels
+// toward a sun overhead and leaning toward +z, on top of an even ambient
+// share of SHADOW_AMBIENT so that texels cut open by the sides of the
+// volume, which are all in shadow, stay visible. Neither reaches past the next
+// chunk, so after chunks change only they and their neighbours are
+// recomputed, one 16x16 column of texels per task of the shared TaskPool.
+//
+// Each texel has a 32-bit cell holding, from the low byte up, occlusion,
+// shadow and their product, 255 for unshaded, so the renderers pick a
+// channel and the cells are fetched with the same gathers and RGBA uploads
+// as the volume and the OccupancyGrid.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _SHADE_VOLUME_H
+#define _SHADE_VOLUME_H
+
+#include <vector>
+
+// channels of a shade cell
+enum ShadeChannel { SHADE_OCCLUSION = 0, SHADE_SHADOW, SHADE_BOTH, SHADE_CHANNELS };
+
+// names of the channels, for options and messages
+extern const char *ShadeChannelNames[SHADE_CHANNELS];
+
+// channel of a name, -1 if there is none
+int FindShadeChannel(const char *name);
+
+// byte of a cell holding a channel
+inline unsigned char ShadeValue(unsigned int cell, int channel)
+{
+    return (unsigned char)((cell >> (channel * 8)) & 0xff);
+}
+
+class ShadeVolume {
+public:
+    // texels within this distance of one on each axis occlude it
+    static const int OCCLUSION_RADIUS = 3;
+    // texels a shadow ray crosses, rising one texel and moving half a texel
+    // in z per step
+    static const int SHADOW_LENGTH = 32;
+    // light of a texel in full shadow, out of 255
+    static const int SHADOW_AMBIENT = 128;
+
+    // width, height and depth of the volume in texels, with width the block
+    // height as in the volume. Cells start unshaded.
+    ShadeVolume(int width, int height, int depth);
+
+    // recomputes every texel of the RGBA volume
+    void build(const unsigned char *volume);
+
+    // recomputes the texels, over the full width, whose shade may depend on
+    // the ones in [y0,y1) x [z0,z1) after those changed. Runs on the shared
+    // pool, so must not be called from one of its tasks.
+    void update(const unsigned char *volume, int y0, int z0, int y1, int z1);
+
+    // moves the cells along with a volume whose contents moved dy texels in
+    // y and dz in z. Uncovered cells are unshaded until update is called.
+    void shift(int dy, int dz);
+
+    // cell of texel (x,y,z) is cells[(z * height + y) * width + x]
+    const unsigned int *getCells() const { return &m_cells[0]; }
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getDepth() const { return m_depth; }
+
+    // milliseconds the last build or update took
+    double getUpdateTime() const { return m_updateTime; }
+
+private:
+    void shadeColumn(const unsigned char *volume, int y0, int z0, std::vector<int> &sums);
+
+    int m_width, m_height, m_depth;
+    std::vector<unsigned int> m_cells;
+    double m_updateTime;
+};
+
+#endif
@@ -0,0 +1,123 @@
+//
+// the surface of a grid of chunks: the height, block and light of the top
+// of every column
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "SurfaceMap.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+int ColumnHeight(const unsigned char *column)
+{
+    // 16 heights at a time from the top, until one of them is not air
+    const __m128i air = _mm_setzero_si128();
+    for(int y = CHUNK_HEIGHT - 16; y >= 0; y -= 16)
+    {
+        __m128i ids = _mm_loadu_si128((const __m128i*)(column + y));
+        int solid = ~_mm_movemask_epi8(_mm_cmpeq_epi8(ids, air)) & 0xffff;
+        if( solid == 0 )
+            continue;
+
+        int b = 15;
+        while( (solid & (1 << b)) == 0 )
+            b--;
+        return y + b + 1;
+    }
+    return 0;
+}
+
+#else
+
+int ColumnHeight(const unsigned char *column)
+{
+    for(int y = CHUNK_HEIGHT - 1; y >= 0; y--)
+        if( column[y] != 0 )
+            return y + 1;
+    return 0;
+}
+
+#endif
+
+void ExtractSurface(const ChunkData *chunk, SurfaceColumn *columns, bool useHeightMap)
+{
+    for(int z = 0; z < CHUNK_SIZE; z++)
+    {
+        for(int x = 0; x < CHUNK_SIZE; x++)
+        {
+            unsigned int base = ChunkIndex(x, 0, z);
+
+            // a HeightMap left stale over air is not trusted
+            int height = -1;
+            if( useHeightMap && chunk->hasHeightMap )
+            {
+                height = chunk->heightMap[x + z * CHUNK_SIZE];
+                if( height > CHUNK_HEIGHT || (height > 0 && chunk->blocks[base + height - 1] == 0) )
+                    height = -1;
+            }
+            if( height < 0 )
+                height = ColumnHeight(chunk->blocks + base);
+
+            SurfaceColumn &column = columns[x + z * CHUNK_SIZE];
+            column.height = (unsigned char)height;
+            column.id = height > 0 ? chunk->blocks[base + height - 1] : 0;
+            if( height < CHUNK_HEIGHT )
+            {
+                column.skyLight = ChunkNibble(chunk->skyLight, base + height);
+                column.blockLight = ChunkNibble(chunk->blockLight, base + height);
+            }
+            else
+            {
+                column.skyLight = 15;
+                column.blockLight = 0;
+            }
+        }
+    }
+}
+
+SurfaceMap::SurfaceMap(int chunksX, int chunksZ)
+    : m_chunksX(chunksX),
+      m_chunksZ(chunksZ),
+      m_useHeightMap(false)
+{
+    SurfaceColumn air = { 0, 0, 15, 0 };
+    m_columns.assign((size_t)chunksX * chunksZ * CHUNK_SIZE * CHUNK_SIZE, air);
+}
+
+void
+SurfaceMap::update(const ChunkData *chunk, unsigned int i, unsigned int j)
+{
+    SurfaceColumn columns[CHUNK_SIZE * CHUNK_SIZE];
+    ExtractSurface(chunk, columns, m_useHeightMap);
+
+    for(int z = 0; z < CHUNK_SIZE; z++)
+    {
+        size_t row = i * CHUNK_SIZE + (size_t)(j * CHUNK_SIZE + z) * m_chunksX * CHUNK_SIZE;
+        memcpy(&m_columns[row], columns + z * CHUNK_SIZE, CHUNK_SIZE * sizeof(SurfaceColumn));
+    }
+}
+
+void
+SurfaceMap::clear(unsigned int i, unsigned int j)
+{
+    SurfaceColumn air = { 0, 0, 15, 0 };
+    for(int z = 0; z < CHUNK_SIZE; z++)
+    {
+        size_t row = i * CHUNK_SIZE + (size_t)(j * CHUNK_SIZE + z) * m_chunksX * CHUNK_SIZE;
+        for(int x = 0; x < CHUNK_SIZE; x++)
+            m_columns[row + x] = air;
+    }
+}
+
+int
+SurfaceMap::getMaxHeight() const
+{
+    int height = 0;
+    for(size_t c = 0; c < m_columns.size(); c++)
+        if( m_columns[c].height > height )
+            height = m_columns[c].height;
+    return height;
+}
@@ -0,0 +1,73 @@
+//
+// the surface of a grid of chunks: the height, block and light of the top
+// of every column
+//
+// Top-down overviews and the ray marcher only need to know where the
+// terrain starts, not every block below it. The surface is read from the
+// HeightMap tag chunks are saved with, which gives the height sky light
+// comes down to, or found by scanning each column of 128 block ids down
+// from the top, 16 at a time with SSE2 where it is available. Neither
+// colorizes anything, so the surface of a chunk costs a small fraction of
+// writing it into the volume.
+//
+// The HeightMap stops at the first block which blocks sky light, so it goes
+// under water, glass, flowers and torches to the ground or sea floor; the
+// scan finds the top block of any kind, and is the one to use when the
+// height must cover every block.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _SURFACE_MAP_H
+#define _SURFACE_MAP_H
+
+#include <vector>
+#include "ChunkReader.h"
+
+struct SurfaceColumn {
+    unsigned char height;       // top block's height + 1, 0 for a column of air
+    unsigned char id;           // top block's id, 0 for a column of air
+    unsigned char skyLight;     // light of the block above the top one
+    unsigned char blockLight;
+};
+
+// height of the top block of a column of 128 block ids which is not air,
+// plus one, or 0 for a column of air
+int ColumnHeight(const unsigned char *column);
+
+// finds the top of every column of chunk into columns[x + z * 16], from its
+// HeightMap if useHeightMap is set and the chunk has one, scanning the
+// columns otherwise
+void ExtractSurface(const ChunkData *chunk, SurfaceColumn *columns, bool useHeightMap);
+
+class SurfaceMap {
+public:
+    // grid of chunksX by chunksZ chunks, (i,j) being the volume's grid
+    // position, all of it air
+    SurfaceMap(int chunksX, int chunksZ);
+
+    // the surface is found by scanning the columns unless this is set, see
+    // ExtractSurface
+    void setUseHeightMap(bool x) { m_useHeightMap = x; }
+
+    // replaces the columns of grid position (i,j) with the surface of
+    // chunk. Each position may be filled from a different thread.
+    void update(const ChunkData *chunk, unsigned int i, unsigned int j);
+    // makes grid position (i,j) air, for missing chunks
+    void clear(unsigned int i, unsigned int j);
+
+    // column (x,z) of the grid in blocks
+    const SurfaceColumn &get(int x, int z) const { return m_columns[x + (size_t)z * m_chunksX * CHUNK_SIZE]; }
+    int getChunksX() const { return m_chunksX; }
+    int getChunksZ() const { return m_chunksZ; }
+
+    // highest column of the grid; no block of the grid is at or above it
+    // when the columns were scanned
+    int getMaxHeight() const;
+
+private:
+    int m_chunksX, m_chunksZ;
+    bool m_useHeightMap;
+    std::vector<SurfaceColumn> m_columns;
+};
+
+#endif
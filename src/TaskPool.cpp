@@ -0,0 +1,217 @@
+//
+// work-stealing pool of threads shared by the CPU-side passes
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+
+#include "TaskPool.h"
+
+TaskPool::TaskPool(int threads)
+    : m_task(NULL),
+      m_cost(NULL),
+      m_workers(0),
+      m_steals(0),
+      m_generation(0),
+      m_running(0),
+      m_quit(false)
+{
+    m_ranges.push_back(new Range);
+    grow(threads > 0 ? threads : coreCount());
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for(size_t t = 0; t < m_threads.size(); t++)
+        m_threads[t].join();
+    for(size_t r = 0; r < m_ranges.size(); r++)
+        delete m_ranges[r];
+}
+
+int
+TaskPool::coreCount()
+{
+    int n = (int)std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+TaskPool &
+TaskPool::shared()
+{
+    static TaskPool pool;
+    return pool;
+}
+
+// starts threads until the pool has the given number of workers. Only
+// called while no parallelFor is running, so the new threads wait for the
+// generation after the current one.
+void
+TaskPool::grow(int threads)
+{
+    while( getThreadCount() < threads )
+    {
+        int worker = getThreadCount();
+        m_ranges.push_back(new Range);
+        m_threads.push_back(std::thread(&TaskPool::run, this, worker, m_generation));
+    }
+}
+
+void
+TaskPool::reserve(int threads)
+{
+    std::lock_guard<std::mutex> call(m_call);
+    grow(threads);
+}
+
+void
+TaskPool::parallelFor(int count, const Task &task, int workers, float *cost)
+{
+    if( count <= 0 )
+        return;
+
+    std::lock_guard<std::mutex> call(m_call);
+
+    if( workers <= 0 )
+        workers = getThreadCount();
+    if( workers > count )
+        workers = count;
+    grow(workers);
+
+    // one contiguous range of tasks per worker
+    for(int w = 0; w < getThreadCount(); w++)
+    {
+        Range &r = *m_ranges[w];
+        std::lock_guard<std::mutex> lock(r.lock);
+        r.begin = w < workers ? (int)((long long)count * w / workers) : 0;
+        r.end = w < workers ? (int)((long long)count * (w + 1) / workers) : 0;
+    }
+
+    m_task = &task;
+    m_cost = cost;
+    m_workers = workers;
+    m_steals = 0;
+
+    if( workers > 1 )
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_running = (int)m_threads.size();
+            m_generation++;
+        }
+        m_wake.notify_all();
+    }
+
+    work(0);
+
+    if( workers > 1 )
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_done.wait(lock, [this]() { return m_running == 0; });
+    }
+
+    m_task = NULL;
+    m_cost = NULL;
+}
+
+// loop of the pool's threads, working on every parallelFor they are part of
+void
+TaskPool::run(int worker, unsigned int seen)
+{
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wake.wait(lock, [this, seen]() { return m_quit || m_generation != seen; });
+            if( m_quit )
+                return;
+            seen = m_generation;
+        }
+
+        if( worker < m_workers )
+            work(worker);
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if( --m_running == 0 )
+            m_done.notify_one();
+    }
+}
+
+void
+TaskPool::work(int worker)
+{
+    int task;
+    while( take(worker, &task) || steal(worker, &task) )
+    {
+        if( m_cost == NULL ) {
+            (*m_task)(task, worker);
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        (*m_task)(task, worker);
+        m_cost[task] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+// next task off the front of the worker's own range
+bool
+TaskPool::take(int worker, int *task)
+{
+    Range &r = *m_ranges[worker];
+    std::lock_guard<std::mutex> lock(r.lock);
+    if( r.begin >= r.end )
+        return false;
+    *task = r.begin++;
+    return true;
+}
+
+// moves the back half of the fullest other range to the worker, returning
+// the first task of it. False once every range is empty.
+bool
+TaskPool::steal(int worker, int *task)
+{
+    for(;;)
+    {
+        // sizes are read without locking, the victim is checked again below
+        int victim = -1, most = 0;
+        for(int w = 0; w < m_workers; w++)
+        {
+            const Range &r = *m_ranges[w];
+            int left = r.end - r.begin;
+            if( w != worker && left > most ) {
+                victim = w;
+                most = left;
+            }
+        }
+        if( victim < 0 )
+            return false;
+
+        int begin, end;
+        {
+            Range &r = *m_ranges[victim];
+            std::lock_guard<std::mutex> lock(r.lock);
+            int left = r.end - r.begin;
+            if( left <= 0 )
+                continue;
+            end = r.end;
+            begin = r.end - (left + 1) / 2;
+            r.end = begin;
+        }
+
+        {
+            Range &r = *m_ranges[worker];
+            std::lock_guard<std::mutex> lock(r.lock);
+            r.begin = begin + 1;
+            r.end = end;
+        }
+
+        m_steals++;
+        *task = begin;
+        return true;
+    }
+}
@@ -0,0 +1,88 @@
+//
+// work-stealing pool of threads shared by the CPU-side passes
+//
+// parallelFor hands each worker one contiguous range of the tasks. A worker
+// takes tasks off the front of its own range and, once that is empty,
+// steals the back half of the fullest range left, so tasks which finish at
+// once (tiles of sky) and tasks which take long (tiles of dense terrain)
+// even out over the cores while neighbouring tasks mostly stay on one
+// worker. The threads persist between calls, so rendering a frame or
+// loading chunks does not start any. The calling thread is worker 0.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _TASK_POOL_H
+#define _TASK_POOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskPool {
+public:
+    // task index, and the index of the worker running it (below the worker
+    // count passed to parallelFor), for per-worker scratch buffers
+    typedef std::function<void(int task, int worker)> Task;
+
+    // threads workers including the caller, 0 for one per core
+    explicit TaskPool(int threads = 0);
+    ~TaskPool();
+
+    // runs task for every index in [0,count) on up to workers threads, 0
+    // for all of the pool, which grows to that many if needed. Returns once
+    // every task is done. cost, if given, receives the milliseconds each
+    // task took. Calls from several threads run one after another; a task
+    // must not call parallelFor itself.
+    void parallelFor(int count, const Task &task, int workers = 0, float *cost = NULL);
+
+    // starts threads until the pool has at least this many workers
+    void reserve(int threads);
+
+    // workers of the pool, including the caller
+    int getThreadCount() const { return (int)m_threads.size() + 1; }
+    // workers used and tasks stolen by the last parallelFor
+    int getWorkers() const { return m_workers; }
+    int getSteals() const { return m_steals; }
+
+    // one worker per core
+    static int coreCount();
+    // pool shared by the renderer and the loader
+    static TaskPool &shared();
+
+private:
+    // tasks [begin,end) left to a worker, padded to a cache line. Changed
+    // under the lock, read without it by thieves looking for a victim.
+    struct Range {
+        std::mutex lock;
+        std::atomic<int> begin, end;
+        char pad[64];
+    };
+
+    void grow(int threads);
+    void run(int worker, unsigned int seen);
+    void work(int worker);
+    bool take(int worker, int *task);
+    bool steal(int worker, int *task);
+
+    std::vector<std::thread> m_threads;
+    std::vector<Range*> m_ranges;
+
+    // the current parallelFor
+    const Task *m_task;
+    float *m_cost;
+    int m_workers;
+    std::atomic<int> m_steals;
+
+    std::mutex m_call;
+    std::mutex m_lock;
+    std::condition_variable m_wake, m_done;
+    unsigned int m_generation;
+    int m_running;
+    bool m_quit;
+};
+
+#endif
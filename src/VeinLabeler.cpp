@@ -0,0 +1,382 @@
+//
+// connected veins of selected blocks, such as ores, lava pools or water
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "VeinLabeler.h"
+#include "TaskPool.h"
+
+// root of a union-find entry, halving the path on the way
+static int findRoot(int *parent, int i)
+{
+    while( parent[i] != i ) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static void join(int *parent, int a, int b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if( a < b )
+        parent[b] = a;
+    else if( b < a )
+        parent[a] = b;
+}
+
+VeinLabeler::VeinLabeler()
+    : m_keep(false),
+      m_threads(0),
+      m_labelTime(0.0),
+      m_mergeTime(0.0)
+{
+    memset(m_class, 0, sizeof(m_class));
+}
+
+void
+VeinLabeler::clear()
+{
+    m_parts.clear();
+    m_parent.clear();
+    m_chunks.clear();
+    m_labeled.clear();
+    m_veins.clear();
+    m_partVein.clear();
+    m_labelTime = 0.0;
+}
+
+int
+VeinLabeler::labelRegion(const char *world, const RegionCoord &region)
+{
+    std::vector<ChunkCoord> coords(REGION_CHUNKS * REGION_CHUNKS);
+    for(int c = 0; c < REGION_CHUNKS * REGION_CHUNKS; c++)
+    {
+        coords[c].x = region.x * REGION_CHUNKS + c % REGION_CHUNKS;
+        coords[c].z = region.z * REGION_CHUNKS + c / REGION_CHUNKS;
+    }
+    return label(world, coords);
+}
+
+int
+VeinLabeler::labelGrid(const char *world, int cx, int cz, int chunksX, int chunksZ)
+{
+    std::vector<ChunkCoord> coords;
+    for(int i = 0; i < chunksX; i++)
+    {
+        for(int j = 0; j < chunksZ; j++)
+        {
+            ChunkCoord c = { cx + i, cz + j };
+            coords.push_back(c);
+        }
+    }
+    return label(world, coords);
+}
+
+bool
+VeinLabeler::isLabeled(int cx, int cz) const
+{
+    std::map< std::pair<int, int>, std::vector<bool> >::const_iterator r =
+        m_labeled.find(std::make_pair(cx >> 5, cz >> 5));
+    return r != m_labeled.end() && r->second[(cx & 31) + (cz & 31) * REGION_CHUNKS];
+}
+
+void
+VeinLabeler::setLabeled(int cx, int cz)
+{
+    std::vector<bool> &region = m_labeled[std::make_pair(cx >> 5, cz >> 5)];
+    if( region.empty() )
+        region.assign(REGION_CHUNKS * REGION_CHUNKS, false);
+    region[(cx & 31) + (cz & 31) * REGION_CHUNKS] = true;
+}
+
+int
+VeinLabeler::label(const char *world, const std::vector<ChunkCoord> &coords)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<ChunkCoord> todo;
+    for(size_t c = 0; c < coords.size(); c++)
+        if( !isLabeled(coords[c].x, coords[c].z) )
+            todo.push_back(coords[c]);
+
+    TaskPool &pool = TaskPool::shared();
+    int workers = m_threads > 0 ? m_threads : pool.getThreadCount();
+    std::vector<ChunkData*> chunks(workers, (ChunkData*)NULL);
+    std::vector< std::vector<int> > scratch(workers);
+    std::vector< std::vector<Part> > parts(todo.size());
+    std::vector<ChunkParts> results(todo.size());
+    std::atomic<int> found(0);
+
+    pool.parallelFor((int)todo.size(), [&](int task, int worker) {
+        if( chunks[worker] == NULL )
+            chunks[worker] = new ChunkData;
+        ChunkData *chunk = chunks[worker];
+
+        if( ReadRegionChunk(world, todo[task].x, todo[task].z, chunk) )
+        {
+            labelChunk(chunk, todo[task].x, todo[task].z, &parts[task], &results[task], scratch[worker]);
+            found++;
+        }
+    }, m_threads);
+
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    // parts are numbered in the order of the chunks, whichever worker
+    // finished first; chunks without parts cannot join anything
+    for(size_t c = 0; c < todo.size(); c++)
+    {
+        setLabeled(todo[c].x, todo[c].z);
+        if( parts[c].empty() )
+            continue;
+
+        results[c].base = (int)m_parts.size();
+        for(size_t p = 0; p < parts[c].size(); p++)
+        {
+            m_parent.push_back((int)m_parts.size());
+            m_parts.push_back(parts[c][p]);
+        }
+        std::swap(m_chunks[std::make_pair(todo[c].x, todo[c].z)], results[c]);
+    }
+
+    for(size_t c = 0; c < todo.size(); c++)
+        joinSides(todo[c].x, todo[c].z);
+
+    m_labelTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return found;
+}
+
+void
+VeinLabeler::labelChunk(const ChunkData *chunk, int cx, int cz, std::vector<Part> *result,
+                        ChunkParts *sides, std::vector<int> &scratch) const
+{
+    // every selected block starts as its own root and joins the ones
+    // before it along y, z and x of the same class
+    scratch.assign(CHUNK_BLOCKS * 2, -1);
+    int *parent = &scratch[0];
+    int *partOf = parent + CHUNK_BLOCKS;
+    const unsigned char *blocks = chunk->blocks;
+
+    for(int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for(int z = 0; z < CHUNK_SIZE; z++)
+        {
+            for(int y = 0; y < CHUNK_HEIGHT; y++)
+            {
+                int bpos = ChunkIndex(x, y, z);
+                int cls = m_class[blocks[bpos]];
+                if( cls == 0 )
+                    continue;
+
+                parent[bpos] = bpos;
+                if( y > 0 && m_class[blocks[bpos - 1]] == cls )
+                    join(parent, bpos, bpos - 1);
+                if( z > 0 && m_class[blocks[bpos - CHUNK_HEIGHT]] == cls )
+                    join(parent, bpos, bpos - CHUNK_HEIGHT);
+                if( x > 0 && m_class[blocks[bpos - CHUNK_HEIGHT * CHUNK_SIZE]] == cls )
+                    join(parent, bpos, bpos - CHUNK_HEIGHT * CHUNK_SIZE);
+            }
+        }
+    }
+
+    std::vector<Part> &parts = *result;
+    parts.clear();
+    if( m_keep )
+        sides->labels.assign(CHUNK_BLOCKS, 0);
+
+    for(int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for(int z = 0; z < CHUNK_SIZE; z++)
+        {
+            for(int y = 0; y < CHUNK_HEIGHT; y++)
+            {
+                int bpos = ChunkIndex(x, y, z);
+                if( parent[bpos] < 0 )
+                    continue;
+
+                int root = findRoot(parent, bpos);
+                int p[3] = { cx * CHUNK_SIZE + x, y, cz * CHUNK_SIZE + z };
+                if( partOf[root] < 0 )
+                {
+                    partOf[root] = (int)parts.size();
+                    Part part = { blocks[bpos], m_class[blocks[bpos]], 0,
+                                  { p[0], p[1], p[2] }, { p[0], p[1], p[2] }, { 0.0, 0.0, 0.0 } };
+                    parts.push_back(part);
+                }
+
+                Part &part = parts[partOf[root]];
+                part.size++;
+                if( blocks[bpos] < part.id )
+                    part.id = blocks[bpos];
+                for(int k = 0; k < 3; k++)
+                {
+                    part.lo[k] = std::min(part.lo[k], p[k]);
+                    part.hi[k] = std::max(part.hi[k], p[k]);
+                    part.sum[k] += p[k];
+                }
+                if( m_keep )
+                    sides->labels[bpos] = (unsigned short)(partOf[root] + 1);
+            }
+        }
+    }
+
+    // the sides, in order of position along them and then height, so
+    // facing sides are joined by walking both at once
+    for(int s = 0; s < 4; s++)
+    {
+        std::vector< std::pair<int, int> > &side = sides->sides[s];
+        side.clear();
+        if( parts.empty() )
+            continue;
+
+        int edge = (s & 1) ? CHUNK_SIZE - 1 : 0;
+        for(int along = 0; along < CHUNK_SIZE; along++)
+        {
+            for(int y = 0; y < CHUNK_HEIGHT; y++)
+            {
+                int bpos = s < 2 ? ChunkIndex(edge, y, along) : ChunkIndex(along, y, edge);
+                if( parent[bpos] >= 0 )
+                    side.push_back(std::make_pair(along * CHUNK_HEIGHT + y, partOf[findRoot(parent, bpos)]));
+            }
+        }
+    }
+}
+
+void
+VeinLabeler::joinSides(int cx, int cz)
+{
+    std::map< std::pair<int, int>, ChunkParts >::iterator a = m_chunks.find(std::make_pair(cx, cz));
+
+    // sides 0 to 3 face the chunks at x - 1, x + 1, z - 1 and z + 1, each
+    // of which has side s ^ 1 facing back
+    for(int s = 0; s < 4; s++)
+    {
+        int nx = cx + (s == 0 ? -1 : (s == 1 ? 1 : 0));
+        int nz = cz + (s == 2 ? -1 : (s == 3 ? 1 : 0));
+        if( !isLabeled(nx, nz) )
+            continue;
+
+        std::map< std::pair<int, int>, ChunkParts >::iterator b = m_chunks.find(std::make_pair(nx, nz));
+        if( a != m_chunks.end() && b != m_chunks.end() )
+        {
+            const std::vector< std::pair<int, int> > &sa = a->second.sides[s], &sb = b->second.sides[s ^ 1];
+            int baseA = a->second.base, baseB = b->second.base;
+            size_t i = 0, j = 0;
+            while( i < sa.size() && j < sb.size() )
+            {
+                if( sa[i].first < sb[j].first )
+                    i++;
+                else if( sb[j].first < sa[i].first )
+                    j++;
+                else
+                {
+                    if( m_parts[baseA + sa[i].second].cls == m_parts[baseB + sb[j].second].cls )
+                        join(&m_parent[0], baseA + sa[i].second, baseB + sb[j].second);
+                    i++;
+                    j++;
+                }
+            }
+        }
+
+        // neither side is needed again, and a chunk with none left and no
+        // labels is forgotten
+        if( a != m_chunks.end() )
+            std::vector< std::pair<int, int> >().swap(a->second.sides[s]);
+        if( b != m_chunks.end() )
+        {
+            std::vector< std::pair<int, int> >().swap(b->second.sides[s ^ 1]);
+            if( b->second.spent() )
+                m_chunks.erase(b);
+        }
+    }
+
+    if( a != m_chunks.end() && a->second.spent() )
+        m_chunks.erase(a);
+}
+
+void
+VeinLabeler::merge()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // the parts of each root summed into one vein
+    int total = (int)m_parts.size();
+    std::vector<Part> sums;
+    std::vector<int> rootSum(total, -1);
+    m_partVein.assign(total, -1);
+    for(int p = 0; p < total; p++)
+    {
+        const Part &part = m_parts[p];
+        int root = findRoot(&m_parent[0], p);
+        if( rootSum[root] < 0 ) {
+            rootSum[root] = (int)sums.size();
+            sums.push_back(part);
+        }
+        else
+        {
+            Part &sum = sums[rootSum[root]];
+            sum.size += part.size;
+            sum.id = std::min(sum.id, part.id);
+            for(int k = 0; k < 3; k++)
+            {
+                sum.lo[k] = std::min(sum.lo[k], part.lo[k]);
+                sum.hi[k] = std::max(sum.hi[k], part.hi[k]);
+                sum.sum[k] += part.sum[k];
+            }
+        }
+        m_partVein[p] = rootSum[root];
+    }
+
+    // largest first, then by position, so vein numbers do not depend on
+    // the order chunks were labeled in
+    std::vector<int> order(sums.size());
+    for(size_t v = 0; v < order.size(); v++)
+        order[v] = (int)v;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        const Part &pa = sums[a], &pb = sums[b];
+        if( pa.size != pb.size ) return pa.size > pb.size;
+        for(int k = 0; k < 3; k++)
+            if( pa.lo[k] != pb.lo[k] ) return pa.lo[k] < pb.lo[k];
+        return pa.id < pb.id;
+    });
+
+    std::vector<int> rank(sums.size());
+    m_veins.resize(sums.size());
+    for(size_t v = 0; v < order.size(); v++)
+    {
+        const Part &sum = sums[order[v]];
+        Vein &vein = m_veins[v];
+        vein.id = sum.id;
+        vein.size = sum.size;
+        for(int k = 0; k < 3; k++)
+        {
+            vein.lo[k] = sum.lo[k];
+            vein.hi[k] = sum.hi[k];
+            // block centers are half a block in
+            vein.centroid[k] = sum.sum[k] / sum.size + 0.5;
+        }
+        rank[order[v]] = (int)v;
+    }
+    for(int p = 0; p < total; p++)
+        m_partVein[p] = rank[m_partVein[p]];
+
+    m_mergeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int
+VeinLabeler::getVein(int cx, int cz, int bpos) const
+{
+    std::map< std::pair<int, int>, ChunkParts >::const_iterator c = m_chunks.find(std::make_pair(cx, cz));
+    if( c == m_chunks.end() || c->second.labels.empty() || m_partVein.empty() )
+        return -1;
+
+    int label = c->second.labels[bpos];
+    return label > 0 ? m_partVein[c->second.base + label - 1] : -1;
+}
@@ -0,0 +1,119 @@
+//
+// connected veins of selected blocks, such as ores, lava pools or water
+//
+// Blocks are given classes by id; two blocks of the same nonzero class
+// sharing a face belong to the same vein, so flowing and still water can
+// share a class while diamond and lapis ore are kept apart. Every chunk is
+// labeled on its own, as one task of the shared TaskPool, with a
+// union-find over its blocks; what is kept of it is the size, bounding box
+// and position sum of each of its parts, and the parts of the selected
+// blocks on its four sides. Once a batch of chunks is labeled, the sides
+// facing chunks labeled so far are joined with a second union-find over
+// the parts alone and dropped, so a whole world is labeled region by
+// region while holding only the parts and the sides facing chunks not yet
+// labeled, not the blocks. merge then sums the parts into veins.
+//
+// The viewer asks for the label of every block of its grid to color the
+// veins; the reports only need the veins.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _VEIN_LABELER_H
+#define _VEIN_LABELER_H
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "ChunkReader.h"
+
+struct Vein {
+    int id;             // smallest block id of the vein
+    long long size;     // blocks
+    int lo[3], hi[3];   // bounding box in world blocks, inclusive, y the height
+    double centroid[3];
+};
+
+class VeinLabeler {
+public:
+    VeinLabeler();
+
+    // blocks of id join blocks of the same class, 0 for blocks which are
+    // not labeled (the default)
+    void setClass(int id, int cls) { m_class[id] = cls; }
+    int getClass(int id) const { return m_class[id]; }
+    // keeps the label of every block for getVein, for small grids
+    void setKeepLabels(bool keep) { m_keep = keep; }
+    // workers of the shared pool, 0 for all
+    void setThreads(int n) { m_threads = n > 0 ? n : 0; }
+
+    // forgets every chunk labeled so far
+    void clear();
+
+    // labels the chunks of a region file, or of a grid of chunks with chunk
+    // (cx,cz) at its NW corner, adding them to those labeled before and
+    // joining them to their labeled neighbours. Chunks labeled before are
+    // skipped. Returns the number of chunks found.
+    int labelRegion(const char *world, const RegionCoord &region);
+    int labelGrid(const char *world, int cx, int cz, int chunksX, int chunksZ);
+
+    // sums the parts of the chunks labeled so far into veins, largest first
+    void merge();
+
+    const std::vector<Vein> &getVeins() const { return m_veins; }
+    // vein of block bpos of chunk (cx,cz) after merge, -1 for blocks in no
+    // vein or without kept labels
+    int getVein(int cx, int cz, int bpos) const;
+
+    // milliseconds the labeling and the last merge took
+    double getLabelTime() const { return m_labelTime; }
+    double getMergeTime() const { return m_mergeTime; }
+
+private:
+    // a vein, or the part of one within a chunk, while it is summed
+    struct Part {
+        int id, cls;
+        long long size;
+        int lo[3], hi[3];
+        double sum[3];
+    };
+
+    // a chunk whose parts are still needed: the parts of the blocks on its
+    // sides x = 0, x = 15, z = 0 and z = 15 as (position along the side *
+    // 128 + y, part), until the chunk beyond is labeled, and the labels of
+    // its blocks when they are kept
+    struct ChunkParts {
+        int base;       // index of the chunk's first part in m_parts
+        std::vector< std::pair<int, int> > sides[4];
+        std::vector<unsigned short> labels;     // part + 1 of each block, when kept
+
+        bool spent() const { return labels.empty() && sides[0].empty() && sides[1].empty() &&
+                                    sides[2].empty() && sides[3].empty(); }
+    };
+
+    int label(const char *world, const std::vector<ChunkCoord> &coords);
+    void labelChunk(const ChunkData *chunk, int cx, int cz, std::vector<Part> *parts, ChunkParts *result,
+                    std::vector<int> &scratch) const;
+    void joinSides(int cx, int cz);
+
+    bool isLabeled(int cx, int cz) const;
+    void setLabeled(int cx, int cz);
+
+    int m_class[BLOCK_IDS];
+    bool m_keep;
+    int m_threads;
+
+    // every part labeled so far, and the union-find joining them
+    std::vector<Part> m_parts;
+    std::vector<int> m_parent;
+    std::map< std::pair<int, int>, ChunkParts > m_chunks;
+    // chunks labeled so far, a bit each by region file
+    std::map< std::pair<int, int>, std::vector<bool> > m_labeled;
+
+    std::vector<Vein> m_veins;
+    std::vector<int> m_partVein;
+
+    double m_labelTime, m_mergeTime;
+};
+
+#endif
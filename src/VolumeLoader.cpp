@@ -0,0 +1,183 @@
+//
+// converts decoded chunks into the 128x128x128 RGBA volume that is rendered
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#include "VolumeLoader.h"
+#include "BlockIndex.h"
+#include "OccupancyGrid.h"
+#include "OreCloud.h"
+#include "ShadeVolume.h"
+#include "SurfaceMap.h"
+#include "TaskPool.h"
+#include "blocks.hpp"
+
+bool IsOre(unsigned char c)
+{
+    return c == mc::RedstoneOre ||
+           c == mc::GlowingRedstoneOre ||
+           c == mc::DiamondOre ||
+           c == mc::GoldOre ||
+           c == mc::IronOre ||
+           c == mc::CoalOre ||
+           c == mc::LapisLazuliOre;
+}
+
+void InitPalette(VolumePalette *palette, float nonOreAlpha, bool alphaLight)
+{
+    for(int c = 0; c < 256; c++)
+    {
+        mc::color temp = c < mc::MaterialCount ? mc::MaterialColor[c] : mc::color(0, 0, 0, 0);
+        if( !IsOre((unsigned char)c) )
+            temp.a *= nonOreAlpha;
+
+        palette->colors[c][0] = temp.r;
+        palette->colors[c][1] = temp.g;
+        palette->colors[c][2] = temp.b;
+        palette->colors[c][3] = temp.a;
+    }
+    palette->alphaLight = alphaLight;
+}
+
+void WriteChunkColors(unsigned char *data, const ChunkData *chunk,
+                      const VolumePalette *palette, unsigned int i, unsigned int j)
+{
+    for(unsigned int x = 0; x < 16; x++)
+    {
+        for(unsigned int z = 0; z < 16; z++)
+        {
+            unsigned char *column = data + ((j * 16 + z) * 128 + (i * 16 + x) * 128 * 128) * 4;
+
+            for(unsigned int y = 0; y < 128; y++)
+                ChunkTexel(chunk, palette, ChunkIndex(x, y, z), column + y * 4);
+        }
+    }
+}
+
+void ClearChunkColors(unsigned char *data, unsigned int i, unsigned int j)
+{
+    for(unsigned int x = 0; x < 16; x++)
+        for(unsigned int z = 0; z < 16; z++)
+            memset(data + ((j * 16 + z) * 128 + (i * 16 + x) * 128 * 128) * 4, 0, 128 * 4);
+}
+
+int LoadVolume(unsigned char *data, const char *world, int cx, int cz,
+               const VolumePalette *palette,
+               unsigned int bw, unsigned int bh,
+               unsigned int bxs, unsigned int bys,
+               unsigned int bxe, unsigned int bye,
+               OccupancyGrid *occupancy, OreCloud *ores,
+               ShadeVolume *shade, SurfaceMap *surface)
+{
+    if( bxs + bxe >= bw || bys + bye >= bh )
+        return 0;
+
+    // every chunk is read, colorized and has its bricks scanned as one task
+    // of the shared pool, each worker decoding into its own ChunkData
+    unsigned int columns = bh - bye - bys;
+    int count = (int)((bw - bxe - bxs) * columns);
+    TaskPool &pool = TaskPool::shared();
+    std::vector<ChunkData*> chunks(pool.getThreadCount(), (ChunkData*)NULL);
+    std::atomic<int> found(0);
+
+    pool.parallelFor(count, [&](int task, int worker) {
+        unsigned int i = bxs + task / columns;
+        unsigned int j = bys + task % columns;
+        if( chunks[worker] == NULL )
+            chunks[worker] = new ChunkData;
+        ChunkData *chunk = chunks[worker];
+
+        if( !ReadRegionChunk(world, cx + i, cz + j, chunk) )
+        {
+#ifdef _DEBUG
+            printf("No chunk at (%d,%d)\n", cx + i, cz + j);
+#endif
+            ClearChunkColors(data, i, j);
+            if( ores != NULL )
+                ores->clear(i, j);
+            if( surface != NULL )
+                surface->clear(i, j);
+        }
+        else
+        {
+#ifdef _DEBUG
+            printf("Reading chunk at (%d,%d)...\n", cx + i, cz + j);
+#endif
+            WriteChunkColors(data, chunk, palette, i, j);
+            if( ores != NULL )
+                ores->extract(chunk, i, j);
+            if( surface != NULL )
+                surface->update(chunk, i, j);
+            found++;
+        }
+
+        if( occupancy != NULL )
+            occupancy->updateBricks(data, 0, j * 16, i * 16, 128, j * 16 + 16, i * 16 + 16);
+    });
+
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    if( occupancy != NULL )
+        occupancy->updateCoarse(0, bys * 16, bxs * 16, 128, (bh - bye) * 16, (bw - bxe) * 16);
+
+    // shading reaches into neighbouring chunks, so waits for all of them
+    if( shade != NULL )
+        shade->update(data, bys * 16, bxs * 16, (bh - bye) * 16, (bw - bxe) * 16);
+
+    return found;
+}
+
+int LoadOreCloud(OreCloud *ores, const char *world, int cx, int cz,
+                 const BlockIndex *index, int *skipped)
+{
+    BlockSet oreIds;
+    for(int id = 0; id < BLOCK_IDS; id++)
+        if( IsOre((unsigned char)id) )
+            oreIds.add(id);
+
+    int chunksX = ores->getChunksX();
+    int chunksZ = ores->getChunksZ();
+    TaskPool &pool = TaskPool::shared();
+    std::vector<ChunkData*> chunks(pool.getThreadCount(), (ChunkData*)NULL);
+    std::atomic<int> found(0), unread(0);
+
+    pool.parallelFor(chunksX * chunksZ, [&](int task, int worker) {
+        unsigned int i = task / chunksZ;
+        unsigned int j = task % chunksZ;
+
+        // chunks the index has never seen are read all the same
+        const ChunkBlocks *blocks = index != NULL ? index->find(cx + i, cz + j) : NULL;
+        if( blocks != NULL && !blocks->present.intersects(oreIds) )
+        {
+            ores->clear(i, j);
+            found++;
+            unread++;
+            return;
+        }
+
+        if( chunks[worker] == NULL )
+            chunks[worker] = new ChunkData;
+        ChunkData *chunk = chunks[worker];
+
+        if( !ReadRegionChunk(world, cx + i, cz + j, chunk) )
+            ores->clear(i, j);
+        else
+        {
+            ores->extract(chunk, i, j);
+            found++;
+        }
+    });
+
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    if( skipped != NULL )
+        *skipped = unread;
+    return found;
+}
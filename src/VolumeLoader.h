@@ -0,0 +1,89 @@
+//
+// converts decoded chunks into the 128x128x128 RGBA volume that is rendered
+//
+// The volume holds an 8x8 grid of chunks. Its x axis (fastest varying, the
+// texture s coordinate) is the block height, followed by the z and x block
+// positions: texel = y + (j * 16 + z) * 128 + (i * 16 + x) * 128 * 128
+// for block (x,y,z) of grid chunk (i,j).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _VOLUME_LOADER_H
+#define _VOLUME_LOADER_H
+
+#include <stddef.h>
+#include "ChunkReader.h"
+
+class BlockIndex;
+class OccupancyGrid;
+class OreCloud;
+class ShadeVolume;
+class SurfaceMap;
+
+// edge length of the volume in texels and in chunks
+const int VOLUME_SIZE = 128;
+const int VOLUME_CHUNKS = 8;
+
+// colors used to convert block ids into volume texels
+struct VolumePalette {
+    unsigned char colors[256][4];
+    bool alphaLight;    // scale alpha by the block light as well as color
+};
+
+// true for the block ids that stay opaque when non-ore alpha is lowered
+bool IsOre(unsigned char id);
+
+// builds the palette from the material colors, scaling the alpha of every
+// non-ore block by nonOreAlpha. mc::initialize_constants must have been called.
+void InitPalette(VolumePalette *palette, float nonOreAlpha, bool alphaLight);
+
+// writes the color of block bpos of a chunk into an RGBA texel, lit by its
+// sky and block light
+inline void ChunkTexel(const ChunkData *chunk, const VolumePalette *palette,
+                       unsigned int bpos, unsigned char *texel)
+{
+    const unsigned char *bCol = palette->colors[chunk->blocks[bpos]];
+
+    float d = ChunkNibble(chunk->skyLight, bpos) / 15.0f;
+    float r = ChunkNibble(chunk->blockLight, bpos) / 15.0f;
+
+    d += r + 0.50f;
+    if( d > 1 ) d = 1;
+
+    texel[0] = (char)(((bCol[0] / 255.0f) * d) * 255.0f);
+    texel[1] = (char)(((bCol[1] / 255.0f) * d) * 255.0f);
+    texel[2] = (char)(((bCol[2] / 255.0f) * d) * 255.0f);
+    texel[3] = (char)((bCol[3] / 255.0f) * 255.0f * (palette->alphaLight ? d : 1.0f));
+}
+
+// writes the colors of a chunk into grid position (i,j) of the volume
+void WriteChunkColors(unsigned char *data, const ChunkData *chunk,
+                      const VolumePalette *palette, unsigned int i, unsigned int j);
+
+// zeroes grid position (i,j) of the volume, for missing chunks
+void ClearChunkColors(unsigned char *data, unsigned int i, unsigned int j);
+
+// reads and converts the chunks of grid columns [bxs, bw-bxe) and rows
+// [bys, bh-bye) of the world with chunk (cx,cz) at grid position (0,0).
+// Returns the number of chunks found; missing chunks are zeroed. The cells
+// of occupancy, if given, are updated for every chunk written, and so are
+// the ore lists of ores. shade, if given, is updated once all of them are
+// written, for them and their neighbours. The columns of surface, if given,
+// are updated for every chunk as well.
+int LoadVolume(unsigned char *data, const char *world, int cx, int cz,
+               const VolumePalette *palette,
+               unsigned int bw, unsigned int bh,
+               unsigned int bxs = 0, unsigned int bys = 0,
+               unsigned int bxe = 0, unsigned int bye = 0,
+               OccupancyGrid *occupancy = NULL, OreCloud *ores = NULL,
+               ShadeVolume *shade = NULL, SurfaceMap *surface = NULL);
+
+// fills only the ore lists of the grid with chunk (cx,cz) at position
+// (0,0), without the volume, for ore views. Chunks which index, if given,
+// shows to hold no ore are emptied without being read, so the index must
+// be up to date with the world. Returns the number of chunks found;
+// skipped, if given, receives the number left unread.
+int LoadOreCloud(OreCloud *ores, const char *world, int cx, int cz,
+                 const BlockIndex *index = NULL, int *skipped = NULL);
+
+#endif
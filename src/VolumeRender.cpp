@@ -22,15 +22,31 @@ VolumeRender::VolumeRender(CGcontext cg_context, VolumeBuffer *volume, ImageBuff
       m_volume(volume),
 	  m_image(image),
       m_density(0.05),
-      m_brightness(2.0)
+      m_brightness(2.0),
+      m_threshold(1.0),
+      m_stepDistance(0.0),
+      m_stepScale(1.0),
+      m_jitter(0.0),
+      m_traversal(TRAVERSE_STEPS),
+      m_occupancy(NULL),
+      m_skipAlpha(0),
+      m_shade(NULL),
+      m_shadeChannel(0),
+      m_shadeTex(NULL)
 {
+    for(int l = 0; l < OCCUPANCY_LEVELS; l++)
+        m_occupancyTex[l] = NULL;
+
     loadPrograms();
 }
 
 VolumeRender::~VolumeRender()
 {
+    freeOccupancy();
+    freeShading();
     cgDestroyProgram(m_raymarch_vprog);
-    cgDestroyProgram(m_raymarch_fprog);
+    for(int m = 0; m < TRAVERSE_MODES; m++)
+        cgDestroyProgram(m_raymarch_fprog[m]);
 }
 
 void
@@ -46,17 +62,107 @@ VolumeRender::loadPrograms()
         m_raymarch_vprog = cgCreateProgramFromFile( m_cg_context, CG_SOURCE, resolved_path.c_str(), m_cg_vprofile , "RayMarchVP", 0);
         cgGLLoadProgram(m_raymarch_vprog);
 
-        m_raymarch_fprog = cgCreateProgramFromFile( m_cg_context, CG_SOURCE, resolved_path.c_str(), m_cg_fprofile , "RayMarchFP", 0);
-        cgGLLoadProgram(m_raymarch_fprog);
-
-        m_density_param = cgGetNamedParameter(m_raymarch_fprog, "density");
-        m_brightness_param = cgGetNamedParameter(m_raymarch_fprog, "brightness");
+        const char *entry[TRAVERSE_MODES] = { "RayMarchFP", "RayMarchVoxelFP" };
+        for(int m = 0; m < TRAVERSE_MODES; m++)
+        {
+            CGprogram fprog = cgCreateProgramFromFile( m_cg_context, CG_SOURCE, resolved_path.c_str(), m_cg_fprofile , entry[m], 0);
+            cgGLLoadProgram(fprog);
+            m_raymarch_fprog[m] = fprog;
+
+            // parameters missing from a program are NULL and ignored by Cg,
+            // the voxel program only uses the bricks
+            m_density_param[m] = cgGetNamedParameter(fprog, "density");
+            m_brightness_param[m] = cgGetNamedParameter(fprog, "brightness");
+            m_threshold_param[m] = cgGetNamedParameter(fprog, "threshold");
+            m_stepDistance_param[m] = cgGetNamedParameter(fprog, "stepDistance");
+            m_stepScale_param[m] = cgGetNamedParameter(fprog, "stepScale");
+            m_jitter_param[m] = cgGetNamedParameter(fprog, "jitter");
+            m_skipAlpha_param[m] = cgGetNamedParameter(fprog, "skipAlpha");
+            m_occupancy_param[m][OCCUPANCY_BRICK] = cgGetNamedParameter(fprog, "brickTex");
+            m_occupancy_param[m][OCCUPANCY_SECTION] = cgGetNamedParameter(fprog, "sectionTex");
+            m_occupancy_param[m][OCCUPANCY_BLOCK] = cgGetNamedParameter(fprog, "blockTex");
+            m_shade_param[m] = cgGetNamedParameter(fprog, "shadeTex");
+            m_shadeMask_param[m] = cgGetNamedParameter(fprog, "shadeMask");
+        }
     }
     else {
         fprintf( stderr, "Failed to find shader file '%s'\n", "shaders/raymarch.cg");
     }
 }
 
+void
+VolumeRender::freeOccupancy()
+{
+    for(int l = 0; l < OCCUPANCY_LEVELS; l++)
+    {
+        delete m_occupancyTex[l];
+        m_occupancyTex[l] = NULL;
+    }
+}
+
+void
+VolumeRender::setOccupancy(const OccupancyGrid *occupancy)
+{
+    freeOccupancy();
+    m_occupancy = occupancy;
+    if( m_occupancy == NULL )
+        return;
+
+    // one texel per cell, nearest filtered. Outside the volume the border
+    // reads as empty, where the volume reads as transparent.
+    for(int l = 0; l < OCCUPANCY_LEVELS; l++)
+    {
+        const OccupancyLevel &level = m_occupancy->getLevel(l);
+        m_occupancyTex[l] = new VolumeBuffer(GL_RGBA8, level.dims[0], level.dims[1], level.dims[2], 1);
+    }
+
+    updateOccupancy();
+}
+
+void
+VolumeRender::updateOccupancy()
+{
+    if( m_occupancy == NULL )
+        return;
+
+    // the cells hold max alpha in the low byte, so they upload as RGBA with
+    // the max in red and the min in green
+    for(int l = 0; l < OCCUPANCY_LEVELS; l++)
+        m_occupancyTex[l]->setData((unsigned char*)m_occupancy->getLevel(l).cells);
+}
+
+void
+VolumeRender::freeShading()
+{
+    delete m_shadeTex;
+    m_shadeTex = NULL;
+}
+
+void
+VolumeRender::setShading(const ShadeVolume *shade, int channel)
+{
+    m_shadeChannel = channel;
+    if( shade == m_shade )
+        return;
+
+    freeShading();
+    m_shade = shade;
+    if( m_shade == NULL )
+        return;
+
+    m_shadeTex = new VolumeBuffer(GL_RGBA8, m_shade->getWidth(), m_shade->getHeight(), m_shade->getDepth(), 1);
+    updateShading();
+}
+
+void
+VolumeRender::updateShading()
+{
+    if( m_shade == NULL )
+        return;
+
+    // occlusion, shadow and both upload as red, green and blue
+    m_shadeTex->setData((unsigned char*)m_shade->getCells());
+}
 
 // render using ray marching
 void
@@ -66,9 +172,35 @@ VolumeRender::render()
     cgGLEnableProfile(m_cg_vprofile);
     cgGLEnableProfile(m_cg_fprofile);
 
-    cgGLBindProgram(m_raymarch_fprog);
-    cgGLSetParameter1f(m_density_param, m_density);
-    cgGLSetParameter1f(m_brightness_param, m_brightness);
+    int m = m_traversal;
+    cgGLBindProgram(m_raymarch_fprog[m]);
+    cgGLSetParameter1f(m_density_param[m], m_density);
+    cgGLSetParameter1f(m_brightness_param[m], m_brightness);
+    cgGLSetParameter1f(m_threshold_param[m], m_threshold);
+    cgGLSetParameter1f(m_stepDistance_param[m], m_stepDistance);
+    cgGLSetParameter1f(m_stepScale_param[m], m_stepScale);
+    cgGLSetParameter1f(m_jitter_param[m], m_jitter);
+
+    // a negative skip alpha turns leaping off in the shader
+    cgGLSetParameter1f(m_skipAlpha_param[m], m_occupancy != NULL ? m_skipAlpha / 255.0f : -1.0f);
+    for(int l = 0; l < OCCUPANCY_LEVELS; l++)
+    {
+        if( m_occupancyTex[l] == NULL || m_occupancy_param[m][l] == NULL )
+            continue;
+        cgGLSetTextureParameter(m_occupancy_param[m][l], m_occupancyTex[l]->getTexture());
+        cgGLEnableTextureParameter(m_occupancy_param[m][l]);
+    }
+
+    // the mask picks the channel of the shade texture, all zero leaves
+    // colors unshaded
+    float mask[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    if( m_shadeTex != NULL && m_shade_param[m] != NULL )
+    {
+        mask[m_shadeChannel] = 1.0f;
+        cgGLSetTextureParameter(m_shade_param[m], m_shadeTex->getTexture());
+        cgGLEnableTextureParameter(m_shade_param[m]);
+    }
+    cgGLSetParameter4fv(m_shadeMask_param[m], mask);
 
     glActiveTextureARB(GL_TEXTURE0_ARB);
     glBindTexture(GL_TEXTURE_3D, m_volume->getTexture());
@@ -85,6 +217,14 @@ VolumeRender::render()
 
     glutSolidCube(1.0);
 
+    for(int l = 0; l < OCCUPANCY_LEVELS; l++)
+    {
+        if( m_occupancyTex[l] != NULL && m_occupancy_param[m][l] != NULL )
+            cgGLDisableTextureParameter(m_occupancy_param[m][l]);
+    }
+    if( m_shadeTex != NULL && m_shade_param[m] != NULL )
+        cgGLDisableTextureParameter(m_shade_param[m]);
+
     cgGLDisableProfile(m_cg_vprofile);
     cgGLDisableProfile(m_cg_fprofile);
 }
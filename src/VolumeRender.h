@@ -10,6 +10,8 @@
 #include <Cg/cgGL.h>
 #include "VolumeBuffer.h"
 #include "ImageBuffer.h"
+#include "OccupancyGrid.h"
+#include "ShadeVolume.h"
 
 // class to render a 3D volume
 class VolumeRender  {
@@ -21,11 +23,43 @@ public:
 
     void setVolume(VolumeBuffer *volume) { m_volume = volume; }
 
+    // TRAVERSE_STEPS marches RayMarchFP's fixed steps, TRAVERSE_VOXELS runs
+    // RayMarchVoxelFP, which visits each texel along the ray once
+    enum Traversal { TRAVERSE_STEPS = 0, TRAVERSE_VOXELS, TRAVERSE_MODES };
+    void setTraversal(Traversal mode) { m_traversal = mode; }
+
     void setDensity(float x) { m_density = x; }
     void setBrightness(float x) { m_brightness = x; }
 
+    // rays stop once their opacity reaches x, 1 only stops opaque rays
+    void setOpacityThreshold(float x) { m_threshold = x; }
+    // beyond this distance from the eye steps grow with the distance, 0 for
+    // fixed steps. Only used when traversing with steps.
+    void setStepDistance(float x) { m_stepDistance = x; }
+    // steps x times longer, with opacity corrected, for coarse previews
+    void setStepScale(float x) { m_stepScale = x; }
+    // rays start x (0 to 1) of a step further in, for averaged passes
+    void setJitter(float x) { m_jitter = x; }
+
+    // grid of empty space to leap over, NULL to march every sample. The
+    // grid is uploaded to small textures, which updateOccupancy refreshes
+    // after the grid changes.
+    void setOccupancy(const OccupancyGrid *occupancy);
+    void updateOccupancy();
+
+    // bricks with alpha up to this (0-255) are skipped, 0 leaves the image as is
+    void setSkipAlpha(int x) { m_skipAlpha = x; }
+
+    // scales the color of each texel by a ShadeChannel of shade, NULL to
+    // leave colors unshaded. The cells are uploaded to an RGBA texture the
+    // size of the volume, which updateShading refreshes after they change.
+    void setShading(const ShadeVolume *shade, int channel = 0);
+    void updateShading();
+
 private:
     void loadPrograms();
+    void freeOccupancy();
+    void freeShading();
 
     VolumeBuffer *m_volume;
 	ImageBuffer *m_image;
@@ -33,8 +67,24 @@ private:
     CGcontext m_cg_context;
     CGprofile m_cg_vprofile, m_cg_fprofile;
 
-    CGprogram m_raymarch_vprog, m_raymarch_fprog;
-    CGparameter m_density_param, m_brightness_param;
+    // fragment programs and their parameters, by traversal mode
+    CGprogram m_raymarch_vprog, m_raymarch_fprog[TRAVERSE_MODES];
+    CGparameter m_density_param[TRAVERSE_MODES], m_brightness_param[TRAVERSE_MODES];
+    CGparameter m_threshold_param[TRAVERSE_MODES], m_stepDistance_param[TRAVERSE_MODES];
+    CGparameter m_stepScale_param[TRAVERSE_MODES], m_jitter_param[TRAVERSE_MODES];
+    CGparameter m_skipAlpha_param[TRAVERSE_MODES], m_occupancy_param[TRAVERSE_MODES][OCCUPANCY_LEVELS];
+    CGparameter m_shade_param[TRAVERSE_MODES], m_shadeMask_param[TRAVERSE_MODES];
+    Traversal m_traversal;
 
     float m_density, m_brightness;
+    float m_threshold, m_stepDistance;
+    float m_stepScale, m_jitter;
+
+    const OccupancyGrid *m_occupancy;
+    VolumeBuffer *m_occupancyTex[OCCUPANCY_LEVELS];
+    int m_skipAlpha;
+
+    const ShadeVolume *m_shade;
+    int m_shadeChannel;
+    VolumeBuffer *m_shadeTex;
 };
\ No newline at end of file
@@ -0,0 +1,109 @@
+//
+// class to cut 2D slices out of the loaded volume on the CPU
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+
+#include "VolumeSlicer.h"
+#include "TaskPool.h"
+
+// color of an RGBA texel over black
+static inline void premultiply(const unsigned char *texel, unsigned char *rgb)
+{
+    rgb[0] = (unsigned char)((texel[0] * texel[3] + 127) / 255);
+    rgb[1] = (unsigned char)((texel[1] * texel[3] + 127) / 255);
+    rgb[2] = (unsigned char)((texel[2] * texel[3] + 127) / 255);
+}
+
+VolumeSlicer::VolumeSlicer(const unsigned char *volume, int width, int height, int depth)
+    : m_volume(volume),
+      m_width(width),
+      m_height(height),
+      m_depth(depth),
+      m_layers((size_t)width * height * depth * 3)
+{
+}
+
+void
+VolumeSlicer::update()
+{
+    // each layer is gathered by one task, reading every column once per
+    // layer but writing its own contiguous block
+    int width = m_width, height = m_height, depth = m_depth;
+    TaskPool::shared().parallelFor(width, [this, width, height, depth](int y, int /*worker*/) {
+        unsigned char *out = &m_layers[(size_t)y * height * depth * 3];
+        for(int row = 0; row < height; row++)
+        {
+            for(int col = 0; col < depth; col++, out += 3)
+                premultiply(m_volume + (((size_t)col * height + row) * width + y) * 4, out);
+        }
+    });
+}
+
+void
+VolumeSlicer::getSliceSize(Axis axis, int *sliceWidth, int *sliceHeight) const
+{
+    switch( axis ) {
+        case SLICE_Y: *sliceWidth = m_depth;  *sliceHeight = m_height; break;
+        case SLICE_Z: *sliceWidth = m_depth;  *sliceHeight = m_width;  break;
+        default:      *sliceWidth = m_height; *sliceHeight = m_width;  break;
+    }
+}
+
+int
+VolumeSlicer::getSliceCount(Axis axis) const
+{
+    return axis == SLICE_Y ? m_width : axis == SLICE_Z ? m_height : m_depth;
+}
+
+void
+VolumeSlicer::extract(Axis axis, int index, unsigned char *rgb) const
+{
+    int count = getSliceCount(axis);
+    if( index < 0 ) index = 0;
+    if( index >= count ) index = count - 1;
+
+    if( axis == SLICE_Y )
+    {
+        size_t bytes = (size_t)m_height * m_depth * 3;
+        memcpy(rgb, &m_layers[index * bytes], bytes);
+        return;
+    }
+
+    // a world z is one row of texels in every column, a world x a whole
+    // block of columns; either way each column's heights are contiguous
+    for(int col = 0; col < (axis == SLICE_Z ? m_depth : m_height); col++)
+    {
+        const unsigned char *column = axis == SLICE_Z ?
+            m_volume + ((size_t)col * m_height + index) * m_width * 4 :
+            m_volume + ((size_t)index * m_height + col) * m_width * 4;
+        int sliceWidth = axis == SLICE_Z ? m_depth : m_height;
+
+        for(int y = 0; y < m_width; y++)
+            premultiply(column + y * 4, rgb + ((size_t)(m_width - 1 - y) * sliceWidth + col) * 3);
+    }
+}
+
+void
+VolumeSlicer::extractPlane(const float origin[3], const float u[3], const float v[3],
+                           int w, int h, unsigned char *rgb) const
+{
+    for(int py = 0; py < h; py++)
+    {
+        for(int px = 0; px < w; px++, rgb += 3)
+        {
+            int t[3];
+            for(int k = 0; k < 3; k++)
+                t[k] = (int)floorf(origin[k] + px * u[k] + py * v[k]);
+
+            if( t[0] < 0 || t[0] >= m_width || t[1] < 0 || t[1] >= m_height ||
+                t[2] < 0 || t[2] >= m_depth ) {
+                rgb[0] = rgb[1] = rgb[2] = 0;
+                continue;
+            }
+            premultiply(m_volume + (((size_t)t[2] * m_height + t[1]) * m_width + t[0]) * 4, rgb);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+//
+// class to cut 2D slices out of the loaded volume on the CPU
+//
+// Checking one mining layer should not need a 3D march. The slicer reads
+// slices straight out of the volume the chunks were loaded into, keeping a
+// copy of it with one height per layer so that a slice at a height, the
+// common case when going through a world layer by layer, is one contiguous
+// block of memory. Planes across the other axes are contiguous in the
+// volume's own layout already. Pixels are the texel color premultiplied by
+// its alpha, over black, so slices follow the non-ore alpha as views do.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _VOLUME_SLICER_H
+#define _VOLUME_SLICER_H
+
+#include <vector>
+
+class VolumeSlicer {
+public:
+    // SLICE_Y cuts at a block height, looking down with world x to the
+    // right and z downwards. SLICE_Z and SLICE_X cut at a world z or x,
+    // looking along it with the height upwards and x or z to the right.
+    enum Axis { SLICE_Y = 0, SLICE_Z, SLICE_X, SLICE_AXES };
+
+    // volume is width*height*depth RGBA texels in GL texture order, the
+    // width being the block height as in VolumeLoader
+    VolumeSlicer(const unsigned char *volume, int width, int height, int depth);
+
+    // rebuilds the copy of layers after the volume changes
+    void update();
+
+    // size of the slices of an axis and the number of them
+    void getSliceSize(Axis axis, int *sliceWidth, int *sliceHeight) const;
+    int getSliceCount(Axis axis) const;
+
+    // writes slice index of axis into rgb, getSliceSize pixels of three
+    // bytes, top row first. Indices are clamped to the volume.
+    void extract(Axis axis, int index, unsigned char *rgb) const;
+
+    // samples the plane through origin spanned by u and v, in texels, at
+    // the nearest texel: pixel (px,py) of the w by h image is at
+    // origin + px * u + py * v. Points outside the volume are black.
+    void extractPlane(const float origin[3], const float u[3], const float v[3],
+                      int w, int h, unsigned char *rgb) const;
+
+private:
+    const unsigned char *m_volume;
+    int m_width, m_height, m_depth;
+    // premultiplied RGB of every texel, heights slowest varying
+    std::vector<unsigned char> m_layers;
+};
+
+#endif
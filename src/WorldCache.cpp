@@ -0,0 +1,504 @@
+//
+// decoded chunks of a world, kept beside it for loading without NBT
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "WorldCache.h"
+#include "RegionManifest.h"
+#include "TaskPool.h"
+
+static const char CACHE_MAGIC[9] = "MTCACHE1";
+const int CACHE_HEADER_BYTES = 32;
+const int CACHE_REGION_BYTES = 8 + REGION_CHUNK_COUNT * 4;
+const int CACHE_ENTRY_BYTES = 32;
+// flags of a brick
+const unsigned int BRICK_HEIGHT_MAP = 1;
+
+static const WorldCache *s_chunkCache = NULL;
+
+void SetChunkCache(const WorldCache *cache)
+{
+    s_chunkCache = cache;
+}
+
+const WorldCache *GetChunkCache()
+{
+    return s_chunkCache;
+}
+
+static unsigned int get32(const unsigned char *p)
+{
+    return (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static unsigned long long get64(const unsigned char *p)
+{
+    return (unsigned long long)get32(p) | (unsigned long long)get32(p + 4) << 32;
+}
+
+static void put32(std::vector<unsigned char> &out, unsigned int x)
+{
+    for(int b = 0; b < 4; b++)
+        out.push_back((unsigned char)(x >> (b * 8)));
+}
+
+static void put64(std::vector<unsigned char> &out, unsigned long long x)
+{
+    put32(out, (unsigned int)x);
+    put32(out, (unsigned int)(x >> 32));
+}
+
+// the arrays of a chunk one after another, as a brick holds them
+static void gatherBrick(const ChunkData *chunk, unsigned char *raw)
+{
+    memcpy(raw, chunk->blocks, CHUNK_BLOCKS);
+    memcpy(raw + CHUNK_BLOCKS, chunk->skyLight, CHUNK_BLOCKS / 2);
+    memcpy(raw + CHUNK_BLOCKS * 3 / 2, chunk->blockLight, CHUNK_BLOCKS / 2);
+    memcpy(raw + CHUNK_BLOCKS * 2, chunk->heightMap, CHUNK_SIZE * CHUNK_SIZE);
+}
+
+// byte run-length code: a control byte c below 128 is followed by c + 1
+// bytes to copy, any other by one byte to repeat c - 126 times. Runs of
+// blocks and light down the columns make most of a chunk.
+static void packBrick(const unsigned char *raw, std::vector<unsigned char> &out)
+{
+    out.clear();
+    int n = CACHE_BRICK_BYTES;
+    int i = 0;
+    while( i < n )
+    {
+        int run = 1;
+        while( i + run < n && run < 129 && raw[i + run] == raw[i] )
+            run++;
+        if( run >= 3 )
+        {
+            out.push_back((unsigned char)(run + 126));
+            out.push_back(raw[i]);
+            i += run;
+            continue;
+        }
+
+        // copy up to the next run of three
+        int start = i;
+        while( i < n && i - start < 128 &&
+               !(i + 2 < n && raw[i] == raw[i + 1] && raw[i] == raw[i + 2]) )
+            i++;
+        out.push_back((unsigned char)(i - start - 1));
+        out.insert(out.end(), raw + start, raw + i);
+    }
+}
+
+// unpacks a brick into chunk, false if it does not unpack to exactly one
+static bool unpackBrick(const unsigned char *in, unsigned int length, unsigned int flags, ChunkData *chunk)
+{
+    // the brick is split back into the arrays of the chunk
+    unsigned char *raw[4] = { chunk->blocks, chunk->skyLight, chunk->blockLight, chunk->heightMap };
+    const int ends[4] = { CHUNK_BLOCKS, CHUNK_BLOCKS * 3 / 2, CHUNK_BLOCKS * 2, CACHE_BRICK_BYTES };
+    const int starts[4] = { 0, CHUNK_BLOCKS, CHUNK_BLOCKS * 3 / 2, CHUNK_BLOCKS * 2 };
+
+    const unsigned char *end = in + length;
+    int o = 0, a = 0;
+    while( in < end )
+    {
+        int c = *in++;
+        int count = c < 128 ? c + 1 : c - 126;
+        if( (c < 128 && end - in < count) || (c >= 128 && in == end) || o + count > CACHE_BRICK_BYTES )
+            return false;
+
+        // a token may cross from one array into the next
+        while( count > 0 )
+        {
+            while( o >= ends[a] )
+                a++;
+            int n = ends[a] - o < count ? ends[a] - o : count;
+            unsigned char *dst = raw[a] + (o - starts[a]);
+            if( c < 128 ) {
+                memcpy(dst, in, n);
+                in += n;
+            }
+            else
+                memset(dst, *in, n);
+            o += n;
+            count -= n;
+        }
+        if( c >= 128 )
+            in++;
+    }
+
+    chunk->hasHeightMap = (flags & BRICK_HEIGHT_MAP) != 0;
+    return o == CACHE_BRICK_BYTES;
+}
+
+WorldCache::WorldCache()
+    : m_data(NULL),
+      m_size(0),
+#ifdef _WIN32
+      m_file(NULL),
+      m_mapping(NULL),
+#endif
+      m_regions(0),
+      m_chunks(0),
+      m_regionTable(NULL),
+      m_index(NULL),
+      m_hits(0),
+      m_misses(0)
+{
+}
+
+WorldCache::~WorldCache()
+{
+    close();
+}
+
+int
+WorldCache::open(const char *filename, const char *world)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if( file == INVALID_HANDLE_VALUE )
+        return 0;
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if( GetFileSizeEx(file, &size) && size.QuadPart >= CACHE_HEADER_BYTES )
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if( mapping == NULL ) {
+        CloseHandle(file);
+        return 0;
+    }
+    m_data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if( m_data == NULL ) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return 0;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_size = (size_t)size.QuadPart;
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if( fd < 0 )
+        return 0;
+    struct stat st;
+    void *data = MAP_FAILED;
+    if( fstat(fd, &st) == 0 && st.st_size >= CACHE_HEADER_BYTES )
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if( data == MAP_FAILED )
+        return 0;
+    m_data = (const unsigned char*)data;
+    m_size = (size_t)st.st_size;
+#endif
+
+    // the tables must lie within the file, after the header
+    unsigned int regions = get32(m_data + 8), chunks = get32(m_data + 12);
+    unsigned long long tableOffset = get64(m_data + 16), indexOffset = get64(m_data + 24);
+    bool ok = memcmp(m_data, CACHE_MAGIC, 8) == 0 &&
+              regions <= m_size / CACHE_REGION_BYTES && chunks <= m_size / CACHE_ENTRY_BYTES &&
+              tableOffset >= CACHE_HEADER_BYTES && tableOffset + (unsigned long long)regions * CACHE_REGION_BYTES <= m_size &&
+              indexOffset >= CACHE_HEADER_BYTES && indexOffset + (unsigned long long)chunks * CACHE_ENTRY_BYTES <= m_size;
+    if( !ok ) {
+        close();
+        return 0;
+    }
+
+    m_world = world;
+    m_regions = (int)regions;
+    m_chunks = (int)chunks;
+    m_regionTable = m_data + tableOffset;
+    m_index = m_data + indexOffset;
+    return 1;
+}
+
+void
+WorldCache::close()
+{
+    if( m_data != NULL )
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle((HANDLE)m_mapping);
+        CloseHandle((HANDLE)m_file);
+        m_file = m_mapping = NULL;
+#else
+        munmap((void*)m_data, m_size);
+#endif
+    }
+    m_data = NULL;
+    m_size = 0;
+    m_regions = m_chunks = 0;
+    m_regionTable = m_index = NULL;
+    m_current.clear();
+    m_hits = 0;
+    m_misses = 0;
+}
+
+void
+WorldCache::refresh()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_current.clear();
+}
+
+const unsigned char *
+WorldCache::findBrick(int cx, int cz, unsigned int *timestamp, unsigned int *length, unsigned int *flags) const
+{
+    // binary search of the index, sorted by z and then x
+    int lo = 0, hi = m_chunks;
+    while( lo < hi )
+    {
+        int mid = (lo + hi) / 2;
+        const unsigned char *entry = m_index + (size_t)mid * CACHE_ENTRY_BYTES;
+        int x = (int)get32(entry), z = (int)get32(entry + 4);
+        if( z < cz || (z == cz && x < cx) )
+            lo = mid + 1;
+        else if( z == cz && x == cx )
+        {
+            unsigned long long offset = get64(entry + 16);
+            *timestamp = get32(entry + 8);
+            *length = get32(entry + 12);
+            *flags = get32(entry + 24);
+            if( offset + *length > m_size )
+                return NULL;
+            return m_data + offset;
+        }
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+const unsigned char *
+WorldCache::findRegion(int rx, int rz) const
+{
+    // sorted by z and then x, as the index
+    int lo = 0, hi = m_regions;
+    while( lo < hi )
+    {
+        int mid = (lo + hi) / 2;
+        const unsigned char *region = m_regionTable + (size_t)mid * CACHE_REGION_BYTES;
+        int x = (int)get32(region), z = (int)get32(region + 4);
+        if( z < rz || (z == rz && x < rx) )
+            lo = mid + 1;
+        else if( z == rz && x == rx )
+            return region + 8;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+bool
+WorldCache::isCurrent(int cx, int cz, unsigned int timestamp) const
+{
+    RegionCoord region = { cx >> 5, cz >> 5 };
+    int c = (cx & 31) + (cz & 31) * REGION_CHUNKS;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::pair<int, int> key(region.x, region.z);
+    std::map< std::pair<int, int>, std::vector<unsigned int> >::iterator r = m_current.find(key);
+    if( r == m_current.end() )
+    {
+        // a region file which cannot be read has nothing current
+        std::vector<unsigned int> &stamps = m_current[key];
+        stamps.assign(REGION_CHUNK_COUNT, 0);
+        ReadRegionTimestamps(m_world.c_str(), region, &stamps[0]);
+        r = m_current.find(key);
+    }
+    return r->second[c] == timestamp;
+}
+
+int
+WorldCache::readChunk(const char *world, int cx, int cz, ChunkData *chunk) const
+{
+    if( m_data == NULL || m_world != world )
+        return 0;
+
+    unsigned int timestamp, length, flags;
+    const unsigned char *brick = findBrick(cx, cz, &timestamp, &length, &flags);
+    if( brick == NULL || !isCurrent(cx, cz, timestamp) || !unpackBrick(brick, length, flags, chunk) ) {
+        m_misses++;
+        return 0;
+    }
+    m_hits++;
+    return 1;
+}
+
+int
+WorldCache::update(const char *world, const char *filename, int threads)
+{
+    std::vector<RegionCoord> regions;
+    if( !ListRegions(world, &regions) )
+        return -1;
+    struct ByZX {
+        bool operator()(const RegionCoord &a, const RegionCoord &b) const
+        {
+            return a.z < b.z || (a.z == b.z && a.x < b.x);
+        }
+    };
+    std::sort(regions.begin(), regions.end(), ByZX());
+
+    // the new file is written beside the old one, which stays mapped until
+    // its bricks are copied
+    std::string temp = std::string(filename) + ".tmp";
+    FILE *f = fopen(temp.c_str(), "wb");
+    if( f == NULL )
+        return -1;
+    std::vector<unsigned char> header(CACHE_HEADER_BYTES, 0);
+    bool ok = fwrite(&header[0], header.size(), 1, f) == 1;
+
+    // a brick of a chunk, new or copied from this cache
+    struct Brick {
+        int cx, cz;
+        unsigned int timestamp, flags;
+        std::vector<unsigned char> packed;
+        bool stored;
+    };
+
+    TaskPool &pool = TaskPool::shared();
+    int workers = threads > 0 ? threads : pool.getThreadCount();
+    std::vector<ChunkData*> chunks(workers, (ChunkData*)NULL);
+    std::vector< std::vector<unsigned char> > raw(workers);
+    std::vector<unsigned char> table, index;
+    std::vector<Brick> bricks;
+    std::vector<unsigned int> stamps(REGION_CHUNK_COUNT);
+    unsigned long long offset = CACHE_HEADER_BYTES;
+    int regionCount = 0, chunkCount = 0;
+    std::atomic<int> decoded(0);
+
+    for(size_t r = 0; r < regions.size() && ok; r++)
+    {
+        if( !ReadRegionTimestamps(world, regions[r], &stamps[0]) )
+            continue;
+        put32(table, (unsigned int)regions[r].x);
+        put32(table, (unsigned int)regions[r].z);
+        for(int c = 0; c < REGION_CHUNK_COUNT; c++)
+            put32(table, stamps[c]);
+        regionCount++;
+
+        bricks.clear();
+        for(int c = 0; c < REGION_CHUNK_COUNT; c++)
+        {
+            if( stamps[c] == 0 )
+                continue;
+            Brick b;
+            b.cx = regions[r].x * REGION_CHUNKS + c % REGION_CHUNKS;
+            b.cz = regions[r].z * REGION_CHUNKS + c / REGION_CHUNKS;
+            b.timestamp = stamps[c];
+            b.flags = 0;
+            b.stored = false;
+            bricks.push_back(b);
+        }
+
+        // each chunk of the region is copied or decoded and packed as one
+        // task, from the region files themselves rather than the cache
+        pool.parallelFor((int)bricks.size(), [&](int task, int worker) {
+            Brick &b = bricks[task];
+            unsigned int timestamp = 0, length = 0, flags = 0;
+            const unsigned char *old = m_data != NULL && m_world == world ?
+                                       findBrick(b.cx, b.cz, &timestamp, &length, &flags) : NULL;
+            if( old != NULL && timestamp == b.timestamp )
+            {
+                b.packed.assign(old, old + length);
+                b.flags = flags;
+                b.stored = true;
+                return;
+            }
+
+            if( chunks[worker] == NULL ) {
+                chunks[worker] = new ChunkData;
+                raw[worker].resize(CACHE_BRICK_BYTES);
+            }
+            ChunkData *chunk = chunks[worker];
+            std::vector<unsigned char> payload;
+            decoded++;
+            if( !ReadRegionPayload(world, b.cx, b.cz, &payload) ||
+                !InflateChunk(&payload[0], (unsigned int)payload.size(), chunk) )
+                return;
+            gatherBrick(chunk, &raw[worker][0]);
+            packBrick(&raw[worker][0], b.packed);
+            b.flags = chunk->hasHeightMap ? BRICK_HEIGHT_MAP : 0;
+            b.stored = true;
+        }, threads);
+
+        // chunks which cannot be read are left out, and read from the
+        // region file, failing again, when asked for
+        for(size_t b = 0; b < bricks.size() && ok; b++)
+        {
+            if( !bricks[b].stored )
+                continue;
+            put32(index, (unsigned int)bricks[b].cx);
+            put32(index, (unsigned int)bricks[b].cz);
+            put32(index, bricks[b].timestamp);
+            put32(index, (unsigned int)bricks[b].packed.size());
+            put64(index, offset);
+            put32(index, bricks[b].flags);
+            put32(index, 0);
+            ok = fwrite(&bricks[b].packed[0], bricks[b].packed.size(), 1, f) == 1;
+            offset += bricks[b].packed.size();
+            chunkCount++;
+        }
+    }
+
+    for(size_t w = 0; w < chunks.size(); w++)
+        delete chunks[w];
+
+    // the index sorted by z and then x, for finding bricks by binary search
+    std::vector<int> order(chunkCount);
+    for(int c = 0; c < chunkCount; c++)
+        order[c] = c;
+    std::sort(order.begin(), order.end(), [&index](int a, int b) {
+        int ax = (int)get32(&index[a * CACHE_ENTRY_BYTES]), az = (int)get32(&index[a * CACHE_ENTRY_BYTES + 4]);
+        int bx = (int)get32(&index[b * CACHE_ENTRY_BYTES]), bz = (int)get32(&index[b * CACHE_ENTRY_BYTES + 4]);
+        return az < bz || (az == bz && ax < bx);
+    });
+    std::vector<unsigned char> sorted(index.size());
+    for(int c = 0; c < chunkCount; c++)
+        memcpy(&sorted[c * CACHE_ENTRY_BYTES], &index[order[c] * CACHE_ENTRY_BYTES], CACHE_ENTRY_BYTES);
+
+    header.clear();
+    header.insert(header.end(), CACHE_MAGIC, CACHE_MAGIC + 8);
+    put32(header, (unsigned int)regionCount);
+    put32(header, (unsigned int)chunkCount);
+    put64(header, offset);
+    put64(header, offset + table.size());
+
+    ok = ok && (table.empty() || fwrite(&table[0], table.size(), 1, f) == 1);
+    ok = ok && (sorted.empty() || fwrite(&sorted[0], sorted.size(), 1, f) == 1);
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&header[0], header.size(), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+
+    // the old file must be unmapped before it can be replaced, and is
+    // mapped again if it is not
+    bool wasOpen = m_data != NULL;
+    std::string mapped = m_world;
+    close();
+    if( ok )
+    {
+        remove(filename);
+        ok = rename(temp.c_str(), filename) == 0;
+    }
+    if( !ok )
+        remove(temp.c_str());
+
+    if( ok )
+        open(filename, world);
+    else if( wasOpen )
+        open(filename, mapped.c_str());
+    return ok ? (int)decoded : -1;
+}
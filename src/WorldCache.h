@@ -0,0 +1,109 @@
+//
+// decoded chunks of a world, kept beside it for loading without NBT
+//
+// Reading a chunk from a region file means inflating it with zlib and
+// parsing its NBT, which costs more than everything the loaders then do
+// with it. The cache keeps each chunk already decoded, as a brick of its
+// block, sky light, block light and height map arrays, 65792 bytes, packed
+// on its own with a byte run-length code that unpacks at close to memcpy
+// speed. The file is memory-mapped, and a brick is only unpacked when a
+// loader asks for its chunk.
+//
+// The file holds a header, the bricks, the timestamps of every region
+// file's chunks as they were when the cache was written, and an index of
+// the bricks sorted by chunk z and then x:
+//
+//     "MTCACHE1" <regions> <chunks> <region table offset> <index offset>
+//     <bricks>
+//     <region x> <z> <1024 timestamps>, for each region
+//     <chunk x> <z> <timestamp> <length> <offset> <flags> 0, for each brick
+//
+// every number being 32 bits, offsets 64 bits, little-endian. The first
+// time a chunk of a region is asked for after opening or refresh(), the
+// region file's header is read and compared with the table; chunks whose
+// timestamps changed since, and chunks the cache does not have, are read
+// from the region files instead.
+// Bringing the cache up to date decodes only the chunks which changed and
+// copies the other bricks as they are.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _WORLD_CACHE_H
+#define _WORLD_CACHE_H
+
+#include <stddef.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ChunkReader.h"
+
+// uncompressed size of a brick
+const int CACHE_BRICK_BYTES = CHUNK_BLOCKS * 2 + CHUNK_SIZE * CHUNK_SIZE;
+
+class WorldCache {
+public:
+    WorldCache();
+    ~WorldCache();
+
+    // maps the cache file of world. Returns 0 if it cannot be read or is
+    // malformed, leaving the cache closed.
+    int open(const char *filename, const char *world);
+    void close();
+    bool isOpen() const { return m_data != NULL; }
+
+    // forgets the timestamps read from the region files, so chunks saved
+    // since are read from them again. Called before each load by callers
+    // which keep the cache open while the world is played.
+    void refresh();
+
+    // unpacks chunk (cx,cz) of world, as ReadRegionChunk reads it. Returns
+    // 0 if the cache is of another world, has no brick for the chunk or
+    // the chunk changed since it was written. Safe from several threads.
+    int readChunk(const char *world, int cx, int cz, ChunkData *chunk) const;
+
+    // writes the cache of every chunk of world to filename, copying the
+    // bricks of this cache whose timestamps are unchanged and decoding the
+    // others on up to threads workers of the shared pool, 0 for all, then
+    // maps the new file. Returns the number of chunks decoded, -1 if the
+    // region directory cannot be read or the file cannot be written.
+    int update(const char *world, const char *filename, int threads = 0);
+
+    // bricks in the cache
+    int getChunkCount() const { return m_chunks; }
+    // chunks read from the cache, and asked for but read elsewhere, since
+    // it was opened
+    int getHits() const { return m_hits; }
+    int getMisses() const { return m_misses; }
+
+private:
+    const unsigned char *findBrick(int cx, int cz, unsigned int *timestamp, unsigned int *length,
+                                   unsigned int *flags) const;
+    const unsigned char *findRegion(int rx, int rz) const;
+    bool isCurrent(int cx, int cz, unsigned int timestamp) const;
+
+    std::string m_world;
+    const unsigned char *m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void *m_file, *m_mapping;
+#endif
+    int m_regions, m_chunks;
+    const unsigned char *m_regionTable;
+    const unsigned char *m_index;
+
+    // timestamps the region files have now, read the first time a chunk of
+    // the region is asked for
+    mutable std::mutex m_lock;
+    mutable std::map< std::pair<int, int>, std::vector<unsigned int> > m_current;
+    mutable std::atomic<int> m_hits, m_misses;
+};
+
+// cache ReadRegionChunk consults before the region files, NULL for none
+void SetChunkCache(const WorldCache *cache);
+const WorldCache *GetChunkCache();
+
+#endif
@@ -0,0 +1,258 @@
+//
+// the blocks that changed between two copies of a world, such as backups
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <utility>
+
+#include "WorldDiff.h"
+#include "TaskPool.h"
+#include "VolumeLoader.h"
+
+// 64-bit FNV-1a of the compressed data of a chunk
+static unsigned long long hashPayload(const std::vector<unsigned char> &payload)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    for(size_t b = 0; b < payload.size(); b++)
+    {
+        hash ^= payload[b];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+WorldDiff::WorldDiff(const char *before, const char *after)
+    : m_before(before),
+      m_after(after),
+      m_threads(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+int
+WorldDiff::listRegions(std::vector<RegionCoord> *regions) const
+{
+    std::vector<RegionCoord> before, after;
+    int found = ListRegions(m_before, &before);
+    found |= ListRegions(m_after, &after);
+
+    // each region once, in order of z and then x
+    regions->clear();
+    std::map< std::pair<int, int>, RegionCoord > all;
+    for(size_t r = 0; r < before.size(); r++)
+        all[std::make_pair(before[r].z, before[r].x)] = before[r];
+    for(size_t r = 0; r < after.size(); r++)
+        all[std::make_pair(after[r].z, after[r].x)] = after[r];
+    for(std::map< std::pair<int, int>, RegionCoord >::iterator r = all.begin(); r != all.end(); ++r)
+        regions->push_back(r->second);
+    return found;
+}
+
+int
+WorldDiff::diffRegion(const RegionCoord &region, std::vector<ChunkDiff> *chunks,
+                      std::vector<BlockChange> *blocks)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // a region missing from one world has every chunk of the other added
+    // or removed
+    const int entries = REGION_CHUNKS * REGION_CHUNKS;
+    std::vector<unsigned int> before(entries, 0), after(entries, 0);
+    int hasBefore = ReadRegionTimestamps(m_before, region, &before[0]);
+    int hasAfter = ReadRegionTimestamps(m_after, region, &after[0]);
+    if( !hasBefore && !hasAfter )
+        return 0;
+
+    m_stats.regions++;
+    if( before == after )
+    {
+        m_stats.regionsSkipped++;
+        m_stats.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return 0;
+    }
+
+    std::vector<ChunkPair> pairs;
+    for(int c = 0; c < entries; c++)
+    {
+        if( before[c] == after[c] )
+            continue;
+        ChunkPair pair = { region.x * REGION_CHUNKS + c % REGION_CHUNKS, region.z * REGION_CHUNKS + c / REGION_CHUNKS,
+                           before[c], after[c] };
+        pairs.push_back(pair);
+    }
+
+    int found = diffChunks(pairs, chunks, blocks);
+    m_stats.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return found;
+}
+
+int
+WorldDiff::diffGrid(int cx, int cz, int chunksX, int chunksZ, std::vector<ChunkDiff> *chunks,
+                    std::vector<BlockChange> *blocks)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // the headers of each region the grid touches, read once
+    const int entries = REGION_CHUNKS * REGION_CHUNKS;
+    std::map< std::pair<int, int>, std::vector<unsigned int> > headers;
+    std::vector<ChunkPair> pairs;
+    for(int j = 0; j < chunksZ; j++)
+    {
+        for(int i = 0; i < chunksX; i++)
+        {
+            RegionCoord region = { (cx + i) >> 5, (cz + j) >> 5 };
+            std::pair<int, int> key(region.x, region.z);
+            std::vector<unsigned int> &stamps = headers[key];
+            if( stamps.empty() )
+            {
+                stamps.assign(entries * 2, 0);
+                ReadRegionTimestamps(m_before, region, &stamps[0]);
+                ReadRegionTimestamps(m_after, region, &stamps[entries]);
+                m_stats.regions++;
+            }
+
+            int c = ((cx + i) & 31) + ((cz + j) & 31) * REGION_CHUNKS;
+            if( stamps[c] == stamps[entries + c] )
+                continue;
+            ChunkPair pair = { cx + i, cz + j, stamps[c], stamps[entries + c] };
+            pairs.push_back(pair);
+        }
+    }
+
+    int found = diffChunks(pairs, chunks, blocks);
+    m_stats.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return found;
+}
+
+int
+WorldDiff::diffChunks(const std::vector<ChunkPair> &pairs, std::vector<ChunkDiff> *chunks,
+                      std::vector<BlockChange> *blocks)
+{
+    // each worker reads both worlds into its own buffers
+    struct Scratch {
+        std::vector<unsigned char> payload[2];
+        ChunkData chunk[2];
+    };
+
+    TaskPool &pool = TaskPool::shared();
+    int workers = m_threads > 0 ? m_threads : pool.getThreadCount();
+    std::vector<Scratch*> scratch(workers, (Scratch*)NULL);
+    std::vector<ChunkDiff> diffs(pairs.size());
+    std::vector< std::vector<BlockChange> > changes(pairs.size());
+    std::atomic<int> read(0), decoded(0);
+
+    pool.parallelFor((int)pairs.size(), [&](int task, int worker) {
+        if( scratch[worker] == NULL )
+            scratch[worker] = new Scratch;
+        Scratch &s = *scratch[worker];
+        const ChunkPair &pair = pairs[task];
+        const char *worlds[2] = { m_before, m_after };
+        unsigned int stamps[2] = { pair.before, pair.after };
+
+        bool has[2];
+        for(int w = 0; w < 2; w++)
+        {
+            has[w] = stamps[w] != 0 && ReadRegionPayload(worlds[w], pair.x, pair.z, &s.payload[w]);
+            read += has[w];
+        }
+
+        ChunkDiff &diff = diffs[task];
+        diff.x = pair.x;
+        diff.z = pair.z;
+        diff.change = CHUNK_SAME;
+        diff.blocks = 0;
+
+        // chunks saved again without changing are told apart by a hash
+        // of their compressed data, before decompressing anything
+        if( !has[0] && !has[1] )
+            return;
+        if( has[0] && has[1] && s.payload[0].size() == s.payload[1].size() &&
+            hashPayload(s.payload[0]) == hashPayload(s.payload[1]) )
+            return;
+
+        // a chunk missing or unreadable in one world is air there
+        decoded++;
+        for(int w = 0; w < 2; w++)
+        {
+            if( !has[w] || !InflateChunk(&s.payload[w][0], (unsigned int)s.payload[w].size(), &s.chunk[w]) )
+                memset(s.chunk[w].blocks, 0, CHUNK_BLOCKS);
+        }
+
+        const unsigned char *a = s.chunk[0].blocks, *b = s.chunk[1].blocks;
+        for(int bpos = 0; bpos < CHUNK_BLOCKS; bpos++)
+        {
+            if( a[bpos] == b[bpos] )
+                continue;
+            diff.blocks++;
+            if( blocks != NULL )
+            {
+                BlockChange change = { pair.x * CHUNK_SIZE + bpos / (CHUNK_HEIGHT * CHUNK_SIZE), bpos % CHUNK_HEIGHT,
+                                       pair.z * CHUNK_SIZE + bpos / CHUNK_HEIGHT % CHUNK_SIZE, a[bpos], b[bpos] };
+                changes[task].push_back(change);
+            }
+        }
+        if( diff.blocks > 0 )
+            diff.change = !has[0] ? CHUNK_ADDED : (!has[1] ? CHUNK_REMOVED : CHUNK_CHANGED);
+    }, m_threads);
+
+    for(size_t w = 0; w < scratch.size(); w++)
+        delete scratch[w];
+
+    // in the order of the pairs, whichever worker finished first
+    int found = 0;
+    for(size_t p = 0; p < pairs.size(); p++)
+    {
+        if( diffs[p].change == CHUNK_SAME )
+            continue;
+        chunks->push_back(diffs[p]);
+        if( blocks != NULL )
+            blocks->insert(blocks->end(), changes[p].begin(), changes[p].end());
+        m_stats.blocks += diffs[p].blocks;
+        found++;
+    }
+
+    m_stats.chunksRead += read;
+    m_stats.chunksDecoded += decoded;
+    m_stats.chunksChanged += found;
+    return found;
+}
+
+void HighlightChanges(unsigned char *volume, int cx, int cz, const std::vector<BlockChange> &blocks,
+                      const bool *fade)
+{
+    const int grid = VOLUME_SIZE / CHUNK_SIZE;
+    for(int i = 0; i < grid; i++)
+    {
+        for(int j = 0; j < grid; j++)
+        {
+            if( fade != NULL && !fade[i * grid + j] )
+                continue;
+            for(int x = i * CHUNK_SIZE; x < (i + 1) * CHUNK_SIZE; x++)
+            {
+                unsigned char *rows = volume + (j * CHUNK_SIZE + x * VOLUME_SIZE) * VOLUME_SIZE * 4;
+                for(int t = 0; t < CHUNK_SIZE * VOLUME_SIZE; t++)
+                    rows[t * 4 + 3] /= 64;
+            }
+        }
+    }
+
+    for(size_t b = 0; b < blocks.size(); b++)
+    {
+        const BlockChange &change = blocks[b];
+        int x = change.x - cx * CHUNK_SIZE;
+        int z = change.z - cz * CHUNK_SIZE;
+        if( x < 0 || x >= VOLUME_SIZE || z < 0 || z >= VOLUME_SIZE )
+            continue;
+
+        unsigned char *texel = volume + (change.y + (z + x * VOLUME_SIZE) * VOLUME_SIZE) * 4;
+        texel[0] = change.before != 0 ? 255 : 40;
+        texel[1] = change.after != 0 ? 255 : 40;
+        texel[2] = 40;
+        texel[3] = 255;
+    }
+}
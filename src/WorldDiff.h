@@ -0,0 +1,94 @@
+//
+// the blocks that changed between two copies of a world, such as backups
+//
+// Worlds are compared one region file at a time, so memory stays the same
+// however large they are. The headers of both copies of a region are read
+// first, and a region whose chunk timestamps all match is skipped without
+// reading anything more. Each chunk whose timestamp differs is one task of
+// the shared TaskPool, which reads the compressed chunk from both worlds
+// and compares a hash of the two; only chunks whose compressed data differ
+// are decompressed and their block arrays compared. A chunk stored in one
+// world only is compared with air.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _WORLD_DIFF_H
+#define _WORLD_DIFF_H
+
+#include <vector>
+#include "ChunkReader.h"
+
+enum ChunkChange { CHUNK_SAME = 0, CHUNK_CHANGED, CHUNK_ADDED, CHUNK_REMOVED };
+
+// a block whose id differs, in world blocks with y the height
+struct BlockChange {
+    int x, y, z;
+    unsigned char before, after;
+};
+
+// a chunk whose blocks differ, with how many
+struct ChunkDiff {
+    int x, z;
+    int change;
+    int blocks;
+};
+
+struct WorldDiffStats {
+    int regions;        // regions compared
+    int regionsSkipped; // of those, skipped by their headers
+    int chunksRead;     // chunks read from either world, after the headers
+    int chunksDecoded;  // chunks whose compressed data differed
+    int chunksChanged;  // chunks whose blocks differed
+    long long blocks;   // blocks that changed
+    double ms;          // milliseconds the comparisons took
+};
+
+class WorldDiff {
+public:
+    // compares world after with world before, both world directories
+    WorldDiff(const char *before, const char *after);
+
+    // workers of the shared pool, 0 for all
+    void setThreads(int n) { m_threads = n > 0 ? n : 0; }
+
+    // lists the regions of either world. Returns 0 if neither region
+    // directory can be read.
+    int listRegions(std::vector<RegionCoord> *regions) const;
+
+    // appends the chunks of a region which changed to chunks, in order of
+    // z and then x, and their changed blocks to blocks if it is not NULL.
+    // Returns the number of chunks appended.
+    int diffRegion(const RegionCoord &region, std::vector<ChunkDiff> *chunks,
+                   std::vector<BlockChange> *blocks);
+    // the same for the grid of chunks with chunk (cx,cz) at its NW corner
+    int diffGrid(int cx, int cz, int chunksX, int chunksZ, std::vector<ChunkDiff> *chunks,
+                 std::vector<BlockChange> *blocks);
+
+    // counts over every comparison so far
+    const WorldDiffStats &getStats() const { return m_stats; }
+
+private:
+    // a chunk to compare and its timestamps in both worlds, 0 if missing
+    struct ChunkPair {
+        int x, z;
+        unsigned int before, after;
+    };
+
+    int diffChunks(const std::vector<ChunkPair> &pairs, std::vector<ChunkDiff> *chunks,
+                   std::vector<BlockChange> *blocks);
+
+    const char *m_before;
+    const char *m_after;
+    int m_threads;
+    WorldDiffStats m_stats;
+};
+
+// highlights changed blocks in the RGBA volume of the grid with chunk
+// (cx,cz) at its NW corner: blocks placed in air green, blocks dug out
+// red and blocks replaced by others yellow, with everything else faded.
+// fade, if not NULL, flags the chunks of the grid to fade, [i * 8 + j] for
+// grid position (i,j), the others being faded already.
+void HighlightChanges(unsigned char *volume, int cx, int cz, const std::vector<BlockChange> &blocks,
+                      const bool *fade = NULL);
+
+#endif
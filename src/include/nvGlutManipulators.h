@@ -241,6 +241,13 @@ public:
     //////////////////////////////////////////////////////////////////
     GlutExamine() : GlutManipulator(_examine) {}
 
+    //
+    //  isSpinning
+    //
+    //    True while the trackball keeps turning the view on idle.
+    //////////////////////////////////////////////////////////////////
+    bool isSpinning() const { return _examine.isSpinning(); }
+
     //
     //  setTrackballActivate
     //
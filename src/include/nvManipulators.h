@@ -576,6 +576,10 @@ public:
 	// get the rotation increment
 	quaternionf &getIncrement() { return _incr; }
 
+	// true while idle() still turns the view, after the trackball was
+	// released mid-drag
+	bool isSpinning() const { return _incr.x != 0.0f || _incr.y != 0.0f || _incr.z != 0.0f; }
+
 protected:
 
     int _x, _y;
@@ -17,7 +17,8 @@
 
 #include "nbt.h"
 
-int indent;
+/* indentation of nbt_print, balanced by the printing functions */
+int indent = 0;
 
 /* Initialization subroutine(s) */
 int nbt_init(nbt_file **nbt)
@@ -25,10 +26,8 @@ int nbt_init(nbt_file **nbt)
     if ((*nbt = (nbt_file*)malloc(sizeof(nbt_file))) == NULL)
         return NBT_EMEM;
 
-    indent = 0;
-
-	(*nbt)->buffer = NULL;
-	(*nbt)->buffSize = 0;
+    (*nbt)->buffer = NULL;
+    (*nbt)->buffSize = 0;
 
     (*nbt)->root = NULL;
 